@@ -0,0 +1,8 @@
+@echo off
+del *.comp
+for %%I in (*.in) do (%1 -oV %%I > nul 2> %%~nI.comp)
+for %%I in (*.comp) do fc %%~nI.out %%I > log.txt || if errorlevel 0 (
+   echo %%I FAIL
+) else echo %%I OK
+del *.asm
+del log.txt
\ No newline at end of file
@@ -0,0 +1,98 @@
+# perl encoder_test.pl ./pc -g gen_all gen_statements ...
+# the objects are ELF, so this needs the gnu as and objdump: the object written by the
+# encoder (-ge, -oe) is compared with the text assembly put through as, instruction by
+# instruction with the relocations and byte by byte in the data
+$arg = shift @ARGV;
+$keys = shift @ARGV;
+my $ok = 0;
+my $count = 0;
+
+sub name {
+   my ($s) = @_;
+   $s =~ s/\@/Z_/g;
+   return $s;
+}
+
+sub bytes {
+   my ($list) = @_;
+   my @parts = map { /^"(.*)"$/ ? do { (my $t = $1) =~ s/\\/\\\\/g; ".ascii \"$t\"" } : ".byte $_" } ($list =~ /"[^"]*"|\d+/g);
+   return join("\n", @parts);
+}
+
+# the masm listing in gas intel syntax with the sections laid out as the encoder does
+sub translate {
+   my ($f) = @_;
+   my (@code, @data, @ro, @bss, @globals);
+   my $section = '';
+   open(my $fh, '<', $f) or die "$f: $!";
+   for my $l (<$fh>) {
+      $l =~ s/\r?\n$//;
+      if ($l =~ /^\.(data|code|const)$/) {
+         $section = $1;
+      } elsif ($section eq 'const' && $l =~ /^\t(\S+) real4 (\S+)$/) {
+         push @ro, name($1) . ": .float $2";
+      } elsif ($section eq 'const' && $l =~ /^\t(\S+) db (.*, 0)$/) {
+         push @ro, name($1) . ": " . bytes($2);
+      } elsif ($section eq 'data' && $l =~ /^\t(\S+) db (\d+) dup\(0\)$/) {
+         push @bss, ".balign 4\n" . name($1) . ": .zero $2";
+      } elsif ($section eq 'data' && $l =~ /^\t(\S+) real4 (\S+)$/) {
+         push @data, ".balign 4\n" . name($1) . ": .float $2";
+      } elsif ($section eq 'data' && $l =~ /^\t(\S+) db (.*, 0)$/) {
+         push @data, ".balign 4\n" . name($1) . ": " . bytes($2);
+      } elsif ($section eq 'data' && $l =~ /^\t(\S+) dd (.*)$/) {
+         push @data, ".balign 4\n" . name($1) . ": .long " . name($2);
+      } elsif ($section eq 'data' && $l =~ /^\s+dd (.*)$/) {
+         push @data, ".long " . name($1);
+      } elsif ($section eq 'code' && $l =~ /^end (\S+)$/) {
+         push @globals, ".globl $1";
+      } elsif ($section eq 'code' && ($l =~ /^(\S+) proc$/ || $l =~ /^(\S+?)::?$/)) {
+         push @code, name($1) . ":";
+      } elsif ($section eq 'code' && $l =~ /^\t(\S+)\t?(.*)$/) {
+         my ($op, $args) = ($1, $2);
+         $args =~ s/\@(\w+)/Z_$1/g;
+         $args =~ s/crt_//g;
+         $args =~ s/\boffset\b/OFFSET/g;
+         $args =~ s/(dword|byte|qword) ptr/\U$1\E PTR/g;
+         $args =~ s/BYTE PTR // if $op eq 'ret';
+         $args = "DWORD PTR $args" if $op eq 'push' && $args =~ /^(fv|const_real)\d+$/;
+         $args = "DWORD PTR $args" if $op =~ /^(push|pop|inc|dec|idiv|imul|neg|not)$/ && $args =~ /^\[/;
+         $args = 'st(1), st' if $op =~ /^f(add|sub|mul|div|divr)p$/;
+         push @code, "\t$op $args";
+      }
+   }
+   close($fh);
+   return join("\n", '.intel_syntax noprefix', '.text', @code, '.data', @data,
+      '.section .rodata', '.balign 4', @ro, '.bss', @bss, @globals) . "\n";
+}
+
+sub disassemble {
+   my ($f) = @_;
+   my @lines = grep { /^\s+[0-9a-f]+:/ } split(/\n/, `objdump -d -r -M intel $f`);
+   s/<[^>]*>//g for @lines;
+   push @lines, grep { /^(Contents| [0-9a-f]+ )/ } split(/\n/, `objdump -s -j .data -j .rodata $f`);
+   return join("\n", @lines);
+}
+
+for my $folder (@ARGV) {
+   my @files = glob("$folder/*.in");
+   for my $f (@files) {
+      $count++;
+      (my $base = $f) =~ s/.in$//;
+      `$arg $keys $f`;
+      open(my $s, '>', "$base.s");
+      print $s translate("$base.asm");
+      close($s);
+      `as --32 -o $base.gas.o $base.s`;
+      `$arg ${keys}e $f`;
+      my $isSame = -e "$base.o" && -e "$base.gas.o" && disassemble("$base.o") eq disassemble("$base.gas.o");
+      unlink("$base.asm", "$base.s", "$base.o", "$base.gas.o");
+      if ($isSame) {
+         $ok++;
+         print "TEST: $f : OK\n";
+      } else {
+         print "TEST: $f : FAIL\n";
+      }
+   }
+}
+print "=========================================\n";
+print "$ok / $count";
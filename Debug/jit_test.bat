@@ -0,0 +1,3 @@
+@echo off
+rem runs every test program in process as native code from both generators
+for %%K in (-gx -ox) do perl run_test.pl %1 %%K gen_all gen_int_structs gen_real_test gen_statements gen_subroutine runtime_test
@@ -0,0 +1,27 @@
+# perl run_test.pl pc.exe -v gen_all gen_statements ...
+# runs every test program in process, in the bytecode vm (-v) or as native code (-gx, -ox),
+# and compares what it prints with the .out file
+$arg = shift @ARGV;
+$keys = shift @ARGV;
+my $ok = 0;
+my $count = 0;
+for my $folder (@ARGV) {
+   my @files = glob("$folder/*.in");
+   for my $f (@files) {
+      $count++;
+      my $out = `$arg $keys $f`;
+      ($f_etalon = $f) =~ s/.in$/.out/;
+      open(my $fh, '<', $f_etalon) or die "$f_etalon: $!";
+      my $etalon = do { local $/; <$fh> };
+      close($fh);
+      s/\r//g for ($out, $etalon);
+      if ($out eq $etalon) {
+         $ok++;
+         print "TEST: $f : OK\n";
+      } else {
+         print "TEST: $f : FAIL\n$out";
+      }
+   }
+}
+print "=========================================\n";
+print "$ok / $count";
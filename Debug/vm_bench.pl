@@ -0,0 +1,41 @@
+use Time::HiRes qw(time);
+# perl vm_bench.pl pc.exe runs gen_all gen_statements ...
+# runs every test program in the bytecode vm (-v) and as native code (-ox), both
+# times include the compilation, and checks that both print the same
+$arg = shift @ARGV;
+$runs = shift @ARGV;
+my $total_vm = 0;
+my $total_native = 0;
+my $same = 0;
+my $count = 0;
+my $native_count = 0;
+sub measure {
+   my ($keys, $f) = @_;
+   my $out;
+   my $start = time;
+   for (1..$runs) {
+      $out = `$arg $keys $f 2>&1`;
+   }
+   return ((time - $start) / $runs * 1000, $out);
+}
+for my $folder (@ARGV) {
+   my @files = glob("$folder/*.in");
+   for my $f (@files) {
+      $count++;
+      my ($vm, $vm_out) = measure("-v", $f);
+      $total_vm += $vm;
+      my ($native, $native_out) = measure("-ox", $f);
+      if ($native_out =~ /Error: Cannot run the program/) {
+         printf("%-28s vm %8.2f ms   native n/a\n", $f, $vm);
+         next;
+      }
+      $native_count++;
+      $total_native += $native;
+      $same++ if $vm_out eq $native_out;
+      printf("%-28s vm %8.2f ms   native %8.2f ms   x%.2f   %s\n", $f, $vm, $native,
+         $native > 0 ? $vm / $native : 0, $vm_out eq $native_out ? "SAME" : "DIFFERENT");
+   }
+}
+print "=========================================\n";
+printf("%d programs: vm %.2f ms\n", $count, $total_vm);
+printf("%d run natively: native %.2f ms   same output %d / %d\n", $native_count, $total_native, $same, $native_count);
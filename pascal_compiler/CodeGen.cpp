@@ -1,4 +1,5 @@
 #include "CodeGen.h"
+#include "asm_encoder.h"
 
 #include <sstream>
 
@@ -23,8 +24,11 @@ string GetReg(Register reg)
       case EDX:   return "edx";
       case ESP:   return "esp";
       case EBP:   return "ebp";
+      case ESI:   return "esi";
+      case EDI:   return "edi";
       case AX:    return "ax";
       case AL:    return "al";
+      case CL:    return "cl";
       case ST1:   return "st(1)";
       case ST:    return "st";
       default:    return "";
@@ -57,6 +61,11 @@ string GetCmd(OpCode opCode)
       case JE:          return "je";
       case JG:          return "jg";
       case JL:          return "jl";
+      case JLE:         return "jle";
+      case JA:          return "ja";
+      case JAE:         return "jae";
+      case JB:          return "jb";
+      case JBE:         return "jbe";
       case FLD:         return "fld";
       case FILD:        return "fild";
       case FCHS:        return "fchs";
@@ -71,6 +80,9 @@ string GetCmd(OpCode opCode)
       case FNSTSW:      return "fnstsw";
       case SAR:         return "sar";
       case SAL:         return "sal";
+      case SHL:         return "shl";
+      case SHR:         return "shr";
+      case CDQ:         return "cdq";
       case LEA:         return "lea";
       case RCL:         return "rcl";
       case RCR:         return "rcr";
@@ -136,6 +148,11 @@ OpCode Asm::GetOpCode() const
 void Asm::Print() const
 {}
 
+void Asm::Encode(AsmEncoder& encoder) const
+{
+   encoder.Encode(opCode, arg1, arg2);
+}
+
 AsmCmd0::AsmCmd0(OpCode AOpCode):
    Asm(AOpCode)
 {}
@@ -169,17 +186,20 @@ void AsmCmd2::Print() const
 
 AsmLabel::AsmLabel(AsmStrImmediate* ALabel):
    Asm(LABEL, ALabel),
-   refAmount(0)
+   refAmount(0),
+   isGlobal(false)
 {}
 
 AsmLabel::AsmLabel(AsmStrImmediate ALabel):
    Asm(LABEL, new AsmStrImmediate(ALabel)),
-   refAmount(0)
+   refAmount(0),
+   isGlobal(false)
  {}
 
 AsmLabel::AsmLabel(string ALabel):
    Asm(LABEL, new AsmStrImmediate(ALabel)),
-   refAmount(0)
+   refAmount(0),
+   isGlobal(false)
  {}
 
 void AsmLabel::IncRefAmount()
@@ -198,10 +218,21 @@ unsigned AsmLabel::GetRefAmount() const
 }
 
 
+//a label referenced from the data section has to be visible outside of its procedure
+void AsmLabel::SetGlobal()
+{
+   isGlobal = true;
+}
+
 void AsmLabel::Print() const
 {
    arg1->PrintBase();
-   cout << ':';
+   cout << (isGlobal ? "::" : ":");
+}
+
+void AsmLabel::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddLabel(CastOperand<AsmStrImmediate>(arg1)->GetStrValue());
 }
 
 AsmSubroutineBase::AsmSubroutineBase(AsmStrImmediate* ALabel):
@@ -219,6 +250,11 @@ void AsmSubroutineBegin::Print() const
    cout << " proc";
 }
 
+void AsmSubroutineBegin::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddLabel(_label->GetStrValue());
+}
+
 AsmSubroutineEnd::AsmSubroutineEnd(AsmStrImmediate* ALabel):
    AsmSubroutineBase(ALabel)
 {}
@@ -229,6 +265,9 @@ void AsmSubroutineEnd::Print() const
    cout << " endp";
 }
 
+void AsmSubroutineEnd::Encode(AsmEncoder&) const
+{}
+
 AsmRawCmd::AsmRawCmd(string cmd):
    Asm(RAW_STR),
    _str(cmd)
@@ -239,6 +278,11 @@ void AsmRawCmd::Print() const
    cout << _str;
 }
 
+void AsmRawCmd::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddRaw(_str);
+}
+
 AsmDataBase::AsmDataBase(string AName):
    _name(AName)
 {}
@@ -246,6 +290,9 @@ AsmDataBase::AsmDataBase(string AName):
 void AsmDataBase::Print() const
 {}
 
+void AsmDataBase::Encode(AsmEncoder&) const
+{}
+
 AsmData::AsmData(string AName, size_t ASize):
    AsmDataBase(AName),
    _size(ASize)
@@ -256,6 +303,11 @@ void AsmData::Print() const
    cout << "\t" << _name << " db " << _size << " dup(0)";
 }
 
+void AsmData::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddData(_name, _size);
+}
+
 AsmDataReal::AsmDataReal(string AName, double AValue):
    AsmDataBase(AName),
    _value(AValue)
@@ -266,14 +318,65 @@ void AsmDataReal::Print() const
    cout << "\t" << _name << " real4 " << fixed << _value;
 }
 
+void AsmDataReal::Encode(AsmEncoder& encoder) const
+{
+   float value = float(_value);
+   encoder.AddData(_name, string((const char*)&value, sizeof(value)));
+}
+
 AsmDataStr::AsmDataStr(string AName, string AValue):
    AsmDataBase(AName),
    _value(AValue)
 {}
 
+//control characters are written as their codes, the others in quotes
 void AsmDataStr::Print() const
 {
-   cout << "\t" << _name << " db \"" << _value << "\", 0";
+   cout << "\t" << _name << " db ";
+   if (_value.empty()) {
+      cout << "\"\", ";
+   }
+   for (size_t i = 0, next; i < _value.size(); i = next) {
+      if ((unsigned char)_value[i] < ' ') {
+         next = i + 1;
+         cout << int(_value[i]) << ", ";
+      } else {
+         for (next = i; next < _value.size() && (unsigned char)_value[next] >= ' '; next++);
+         cout << '"' << _value.substr(i, next - i) << "\", ";
+      }
+   }
+   cout << 0;
+}
+
+void AsmDataStr::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddData(_name, _value + '\0');
+}
+
+AsmDataTable::AsmDataTable(string AName, const vector<AsmLabel*>& ALabels):
+   AsmDataBase(AName),
+   _labels(ALabels)
+{}
+
+void AsmDataTable::Print() const
+{
+   for (size_t i = 0; i < _labels.size(); i++) {
+      if (i % 8 == 0) {
+         cout << (i ? "\n\t" : "\t" + _name + " ") << "dd ";
+      } else {
+         cout << ", ";
+      }
+      _labels[i]->arg1->PrintBase();
+   }
+}
+
+void AsmDataTable::Encode(AsmEncoder& encoder) const
+{
+   vector<string> labels;
+   for (auto &label : _labels) {
+      labels.push_back(CastOperand<AsmStrImmediate>(label->arg1)->GetStrValue());
+   }
+   encoder.AddData(_name, labels);
 }
 
 AsmDataNewLine::AsmDataNewLine(string AName):
@@ -285,6 +388,11 @@ void AsmDataNewLine::Print() const
    cout << '\t' << _name << " db 10, 0";
 }
 
+void AsmDataNewLine::Encode(AsmEncoder& encoder) const
+{
+   encoder.AddData(_name, string("\n") + '\0');
+}
+
 void AsmOperand::Print() const
 {}
 
@@ -305,6 +413,11 @@ AsmRegister::AsmRegister(Register AReg):
    _register(AReg)
 {}
 
+Register AsmRegister::GetRegister() const
+{
+   return _register;
+}
+
 bool AsmRegister::operator==(AsmOperand* oper)
 {
    bool result = false;
@@ -444,18 +557,32 @@ bool AsmStrImmediate::operator==(AsmOperand* oper)
 
 AsmMemory::AsmMemory(AsmOperand* AOper, int AOffset, SizeType AType):
    arg(AOper),
+   index(nullptr),
+   scale(1),
+   _offset(AOffset),
+   _size(AType)
+{}
+
+AsmMemory::AsmMemory(AsmOperand* AOper, Register AIndex, int AScale, int AOffset, SizeType AType):
+   arg(AOper),
+   index(new AsmRegister(AIndex)),
+   scale(AScale),
    _offset(AOffset),
    _size(AType)
 {}
 
 AsmMemory::AsmMemory(Register AReg, int AOffset, SizeType AType):
    arg(new AsmRegister(AReg)),
+   index(nullptr),
+   scale(1),
    _offset(AOffset),
    _size(AType)
 {}
 
 AsmMemory::AsmMemory(AsmRegister AReg, int AOffset, SizeType AType):
    arg(new AsmRegister(AReg)),
+   index(nullptr),
+   scale(1),
    _offset(AOffset),
    _size(AType)
 {}
@@ -467,7 +594,9 @@ bool AsmMemory::operator==(AsmOperand* oper)
       result =
             _offset == CastOperand<AsmMemory>(oper)->_offset
          //&& _size == CastOperand<AsmMemory>(oper)->_size
-         && CmpOperands(arg, CastOperand<AsmMemory>(oper)->arg);
+         && CmpOperands(arg, CastOperand<AsmMemory>(oper)->arg)
+         && (index == nullptr) == (CastOperand<AsmMemory>(oper)->index == nullptr)
+         && (index == nullptr || (CmpOperands(index, CastOperand<AsmMemory>(oper)->index) && scale == CastOperand<AsmMemory>(oper)->scale));
    }
    return result;
 }
@@ -497,6 +626,11 @@ void AsmMemory::Print() const
    cout << GetSizeTypeText(_size);
    cout << '[';
    arg->PrintBase();
+   if (index != nullptr) {
+      cout << " + ";
+      index->PrintBase();
+      cout << '*' << scale;
+   }
    if (_offset) {
       cout << (_offset > 0 ? " + " : " - ") << abs(_offset);
    }
@@ -685,9 +819,13 @@ Commands AsmCodeBase::GetCommands() const
 AsmCode::AsmCode():
    labelCounter(0),
    functWrite(AsmStrImmediate("crt_printf")),
-   formatStrInt(nullptr),
    formatStrReal(nullptr),
-   formatStrNewLine(nullptr)
+   formatStrBuffer(nullptr),
+   writeBuffer(nullptr),
+   writeLength(nullptr),
+   constUses(0),
+   constSize(0),
+   rangeErrorLabel(nullptr)
 {}
 
 AsmStrImmediate* AsmCode::AddData(string name)
@@ -697,13 +835,6 @@ AsmStrImmediate* AsmCode::AddData(string name)
    return new AsmStrImmediate(name);
 }
 
-AsmStrImmediate* AsmCode::AddData(string name, double value)
-{
-   name = GenStrLabel("f" + name);
-   data.push_back(new AsmDataReal(name, value));
-   return new AsmStrImmediate(name);
-}
-
 AsmStrImmediate* AsmCode::AddData(string name, size_t size)
 {
    name = "v_" + name;
@@ -718,6 +849,55 @@ AsmStrImmediate* AsmCode::AddData(string name, string value)
    return new AsmStrImmediate(name);
 }
 
+AsmStrImmediate* AsmCode::AddData(const vector<AsmLabel*>& labels)
+{
+   string name = GenStrLabel("table");
+   for (auto &label : labels) {
+      label->SetGlobal();
+   }
+   data.push_back(new AsmDataTable(name, labels));
+   return new AsmStrImmediate(name);
+}
+
+//literals and constants go to a read-only pool that holds each value once; reals are
+//the same when they are as floats
+AsmStrImmediate* AsmCode::AddConst(double value)
+{
+   float real = float(value);
+   string key = 'r' + string((const char*)&real, sizeof(real));
+   constUses++;
+   auto it = constLabels.find(key);
+   if (it != constLabels.end()) {
+      return it->second;
+   }
+   string name = GenStrLabel("const_real");
+   constReals.push_back(new AsmDataReal(name, value));
+   constSize += sizeof(real);
+   return constLabels[key] = new AsmStrImmediate(name);
+}
+
+AsmStrImmediate* AsmCode::AddConst(const string& value)
+{
+   string key = 's' + value;
+   constUses++;
+   auto it = constLabels.find(key);
+   if (it != constLabels.end()) {
+      return it->second;
+   }
+   string name = GenStrLabel("const_str");
+   constStrings.push_back(new AsmDataStr(name, value));
+   constSize += value.size() + 1;
+   return constLabels[key] = new AsmStrImmediate(name);
+}
+
+vector<string> AsmCode::GetConstReport() const
+{
+   if (constUses == 0) return vector<string>();
+   return vector<string>(1, "constant pool: " + to_string(constReals.size()) + " reals, "
+      + to_string(constStrings.size()) + " strings, " + to_string(constSize) + " bytes for "
+      + to_string(constUses) + " uses");
+}
+
 void AsmCode::AddLabel(AsmLabel* label)
 {
    commands.push_back(label);
@@ -758,6 +938,17 @@ void AsmCode::Print() const
       dd->Print();
       cout << endl;
    }
+   if (!constLabels.empty()) {
+      cout << ".const\n";
+   }
+   for (auto &dd : constReals) {
+      dd->Print();
+      cout << endl;
+   }
+   for (auto &dd : constStrings) {
+      dd->Print();
+      cout << endl;
+   }
    cout << ".code\n";
    for (auto &command : commands) {
       command->Print();
@@ -765,6 +956,24 @@ void AsmCode::Print() const
    }
 }
 
+void AsmCode::Encode(AsmEncoder& encoder) const
+{
+   for (auto &dd : data) {
+      dd->Encode(encoder);
+   }
+   encoder.SetDataSection(asRodata);
+   for (auto &dd : constReals) {
+      dd->Encode(encoder);
+   }
+   for (auto &dd : constStrings) {
+      dd->Encode(encoder);
+   }
+   encoder.SetDataSection(asData);
+   for (auto &command : commands) {
+      command->Encode(encoder);
+   }
+}
+
 void AsmCode::PushMemory(unsigned size)
 {
    AddCmd(POP, EAX);
@@ -789,37 +998,462 @@ void AsmCode::PushMemory(unsigned size)
    }
 }
 
+static bool IsRegisterUsed(AsmOperand* operand, Register reg)
+{
+   if (TryToCastOperand<AsmRegister>(operand)) {
+      return CastOperand<AsmRegister>(operand)->GetRegister() == reg;
+   }
+   if (TryToCastOperand<AsmMemory>(operand)) {
+      AsmMemory* memory = CastOperand<AsmMemory>(operand);
+      return IsRegisterUsed(memory->arg, reg) || (memory->index != nullptr && memory->index->GetRegister() == reg);
+   }
+   return false;
+}
+
+//the value pushed last goes to the register without the stack: push x; pop r gives mov r, x
+//and push x; mov q, y; pop r gives mov r, x; mov q, y as long as y reads neither r nor esp
+void AsmCode::PopRegister(Register reg)
+{
+   size_t count = commands.size();
+   Command last = count > 0 ? commands[count - 1] : nullptr;
+   Command prev = count > 1 ? commands[count - 2] : nullptr;
+   if (last != nullptr && *last == PUSH) {
+      commands.pop_back();
+      if (!TryToCastOperand<AsmRegister>(last->arg1) || CastOperand<AsmRegister>(last->arg1)->GetRegister() != reg) {
+         AddCmd(MOV, new AsmRegister(reg), last->arg1);
+      }
+   } else if (prev != nullptr && *prev == PUSH && *last == MOV
+         && TryToCastOperand<AsmRegister>(last->arg1) && CastOperand<AsmRegister>(last->arg1)->GetRegister() != reg
+         && !IsRegisterUsed(last->arg2, reg) && !IsRegisterUsed(last->arg2, ESP)) {
+      commands[count - 2] = new AsmCmd2(MOV, new AsmRegister(reg), prev->arg1);
+   } else {
+      AddCmd(POP, reg);
+   }
+}
+
+static bool IsRegister(AsmOperand* operand, Register reg)
+{
+   return TryToCastOperand<AsmRegister>(operand) && CastOperand<AsmRegister>(operand)->GetRegister() == reg;
+}
+
+//a subroutine from begin to the end of the code addresses its frame off esp when the depth of the
+//stack is known at every command: push ebp; mov ebp, esp go away, [ebp + k] becomes
+//[esp + depth - 4 + k], mov r, ebp becomes lea r, [esp + depth - 4] and mov esp, ebp; pop ebp
+//becomes add esp, depth; the four bytes of the saved ebp stay reserved when the frame is below it
+//and an add of a constant to the frame address goes into the lea
+bool AsmCode::OmitFramePointer(size_t begin)
+{
+   size_t end = commands.size();
+   if (end < begin + 5
+      || *commands[begin] != PUSH || !IsRegister(commands[begin]->arg1, EBP)
+      || *commands[begin + 1] != MOV || !IsRegister(commands[begin + 1]->arg1, EBP)
+      || *commands[end - 3] != MOV || !IsRegister(commands[end - 3]->arg1, ESP)
+      || *commands[end - 2] != POP || !IsRegister(commands[end - 2]->arg1, EBP)
+      || *commands[end - 1] != RET) {
+      return false;
+   }
+   vector<int> depths(end, -1);
+   unordered_map<string, int> labelDepths;
+   bool isSlotUsed = false;
+   int depth = 4;
+   for (size_t i = begin + 2; i < end - 3; i++) {
+      Command cmd = commands[i];
+      OpCode op = cmd->GetOpCode();
+      if (op == LABEL || (op >= JMP && op <= JBE)) {
+         if (!TryToCastOperand<AsmStrImmediate>(cmd->arg1)) return false;
+         auto it = labelDepths.find(CastOperand<AsmStrImmediate>(cmd->arg1)->GetStrValue());
+         if (it != labelDepths.end()) {
+            if (depth >= 0 && depth != it->second) return false;
+            depth = it->second;
+         }
+         if (depth < 0) return false;
+         labelDepths[CastOperand<AsmStrImmediate>(cmd->arg1)->GetStrValue()] = depth;
+         depths[i] = depth;
+         depth = op == JMP ? -1 : depth;
+         continue;
+      }
+      if (depth < 0) return false;
+      depths[i] = depth;
+      if (op == PUSH) {
+         depth += 4;
+      } else if (op == POP) {
+         depth -= 4;
+      } else if (op == RET || op == RAW_STR || op == SUBROUTINE) {
+         return false;
+      } else if (IsRegister(cmd->arg1, ESP)) {
+         if ((op != ADD && op != SUB) || !TryToCastOperand<AsmIntImmediate>(cmd->arg2)) return false;
+         int value = CastOperand<AsmIntImmediate>(cmd->arg2)->GetIntValue();
+         depth += op == SUB ? value : -value;
+      }
+      for (AsmOperand* arg : {cmd->arg1, cmd->arg2}) {
+         if (TryToCastOperand<AsmMemory>(arg)) {
+            AsmMemory* memory = CastOperand<AsmMemory>(arg);
+            if (memory->index != nullptr && memory->index->GetRegister() == EBP) return false;
+            isSlotUsed = isSlotUsed || (IsRegister(memory->arg, EBP) && memory->GetOffset() < 0);
+         } else if (IsRegister(arg, EBP) && (op != MOV || arg != cmd->arg2 || !TryToCastOperand<AsmRegister>(cmd->arg1))) {
+            return false;
+         }
+      }
+      isSlotUsed = isSlotUsed || (op == MOV && IsRegister(cmd->arg2, EBP));
+   }
+   if (depth < 0) return false;
+   int shift = isSlotUsed ? 0 : 4;
+   vector<size_t> folded;
+   for (size_t i = begin + 2; i < end - 3; i++) {
+      Command cmd = commands[i];
+      if (*cmd == LABEL) continue;
+      int before = depths[i] - shift;
+      int after = before + (*cmd == PUSH ? 4 : 0) - (*cmd == POP ? 4 : 0);
+      for (AsmOperand** arg : {&cmd->arg1, &cmd->arg2}) {
+         if (TryToCastOperand<AsmMemory>(*arg) && IsRegister(CastOperand<AsmMemory>(*arg)->arg, EBP)) {
+            AsmMemory* memory = new AsmMemory(*CastOperand<AsmMemory>(*arg));
+            memory->arg = new AsmRegister(ESP);
+            memory->SetOffset(memory->GetOffset() + (*cmd == POP ? after : before) - 4);
+            *arg = memory;
+         }
+      }
+      if (*cmd == MOV && IsRegister(cmd->arg2, EBP)) {
+         int offset = before - 4;
+         Command add = commands[i + 1];
+         if (*add == ADD && IsRegister(add->arg1, CastOperand<AsmRegister>(cmd->arg1)->GetRegister())
+               && TryToCastOperand<AsmIntImmediate>(add->arg2)) {
+            offset += CastOperand<AsmIntImmediate>(add->arg2)->GetIntValue();
+            folded.push_back(i + 1);
+         }
+         commands[i] = new AsmCmd2(LEA, cmd->arg1, new AsmMemory(ESP, offset));
+      }
+   }
+   depth -= shift;
+   commands.erase(commands.begin() + end - 2);
+   if (depth > 0) {
+      commands[end - 3] = new AsmCmd2(ADD, new AsmRegister(ESP), new AsmIntImmediate(depth, szNONE));
+   } else {
+      commands.erase(commands.begin() + end - 3);
+   }
+   for (auto it = folded.rbegin(); it != folded.rend(); ++it) {
+      commands.erase(commands.begin() + *it);
+   }
+   Command next = commands[begin + 2];
+   if (isSlotUsed && *next == SUB && IsRegister(next->arg1, ESP)) {
+      commands[begin + 2] = new AsmCmd2(SUB, new AsmRegister(ESP), new AsmIntImmediate(CastOperand<AsmIntImmediate>(next->arg2)->GetIntValue() + 4, szNONE));
+      commands.erase(commands.begin() + begin, commands.begin() + begin + 2);
+   } else if (isSlotUsed) {
+      commands[begin] = new AsmCmd2(SUB, new AsmRegister(ESP), new AsmIntImmediate(4, szNONE));
+      commands.erase(commands.begin() + begin + 1);
+   } else {
+      commands.erase(commands.begin() + begin, commands.begin() + begin + 2);
+   }
+   return true;
+}
+
+//write goes through a runtime emitted into the program: the items are formatted into one buffer,
+//which the C library gets when it is full and at the end of the program; the runtime routines
+//only change eax, ecx and edx, as the C library functions do
+static const int writeBufferSize = 65536;
+//the codes of the kinds in the string that goes to rt_write_list, 0 ends it, and their routines
+static const string writeKinds = "sirn";
+static const string writeRoutines[] = { "rt_write_str", "rt_write_int", "rt_write_real", "rt_write_ln" };
+
+void AsmCode::CallRuntime(string name)
+{
+   if (writeBuffer == nullptr) {
+      writeBuffer = new AsmStrImmediate("rt_buffer");
+      writeLength = new AsmStrImmediate("rt_length");
+      data.push_back(new AsmData(writeBuffer->GetStrValue(), writeBufferSize));
+      data.push_back(new AsmData(writeLength->GetStrValue(), 4));
+   }
+   runtimeCalls.insert(name);
+   AddCmd(CALL, AsmStrImmediate(name));
+}
+
 void AsmCode::GenCallWriteForInt()
 {
-   formatStrInt = formatStrInt == nullptr ? AddData("int", "%d") : formatStrInt;
-   AddCmd(PUSH, AsmVarAddr(formatStrInt));
-   AddCmd(CALL, functWrite);
-   AddCmd(ADD, ESP, 8);
+   CallRuntime("rt_write_int");
+   AddCmd(ADD, ESP, 4);
 }
 
 void AsmCode::GenCallWriteForReal()
 {
-   formatStrReal = formatStrReal == nullptr ? AddData("float", "% 0.14E") : formatStrReal;
-   AddCmd(FLD, AsmMemory(ESP, 0, szDWORD));
+   GenCallWriteForReal(new AsmMemory(ESP, 0, szDWORD));
+}
+
+void AsmCode::GenCallWriteForReal(AsmOperand* value)
+{
+   AddCmd(FLD, value);
    AddCmd(SUB, ESP, 8);
    AddCmd(FSTP, AsmMemory(ESP, 0, szQWORD));
-   AddCmd(PUSH, AsmVarAddr(formatStrReal));
-   AddCmd(CALL, functWrite);
-   AddCmd(ADD, ESP, 12);
+   CallRuntime("rt_write_real");
+   AddCmd(ADD, ESP, 8);
 }
 
 void AsmCode::GenCallWriteForStr()
 {
-   AddCmd(CALL, functWrite);
+   CallRuntime("rt_write_str");
    AddCmd(ADD, ESP, 4);
 }
 
 void AsmCode::GenWriteNewLine()
 {
-   formatStrNewLine = formatStrNewLine == nullptr ? AddData("new_line") : formatStrNewLine;
-   AddCmd(PUSH, AsmVarAddr(formatStrNewLine));
+   CallRuntime("rt_write_ln");
+}
+
+//the values are pushed from the last one, the string of the codes of their kinds goes on top;
+//the kinds are i, r, s and n for the end of the line
+void AsmCode::GenCallWriteList(const string& kinds)
+{
+   string codes;
+   int size = 4;
+   for (auto &kind : kinds) {
+      size_t code = writeKinds.find(kind);
+      runtimeCalls.insert(writeRoutines[code]);
+      codes += char(code + 1);
+      size += kind != 'n' ? 4 : 0;
+   }
+   AddCmd(PUSH, AsmVarAddr(AddConst(codes)));
+   CallRuntime("rt_write_list");
+   AddCmd(ADD, ESP, size);
+}
+
+void AsmCode::GenFlushWrites()
+{
+   if (!runtimeCalls.empty()) {
+      AddCmd(CALL, AsmStrImmediate("rt_flush"));
+   }
+}
+
+//makes room for size bytes in the buffer and leaves its length in ecx
+void AsmCode::GenReserveWrite(int size)
+{
+   AsmLabel* labelRoom = GenLabel("room");
+   AddCmd(MOV, ECX, AsmMemory(writeLength, 0, szDWORD));
+   AddCmd(CMP, ECX, writeBufferSize - size);
+   AddCmd(JBE, labelRoom);
+   AddCmd(CALL, AsmStrImmediate("rt_flush"));
+   AddCmd(XOR, ECX, ECX);
+   AddLabel(labelRoom);
+}
+
+//the digits come off the number from the last one, dividing by 10 is multiplying by 2^35 / 10
+void AsmCode::GenWriteInt()
+{
+   AsmLabel* labelPositive = GenLabel("positive");
+   AsmLabel* labelDigit = GenLabel("digit");
+   AsmLabel* labelStore = GenLabel("store");
+   AsmLabel* labelEnd = GenLabel("end");
+   AsmStrImmediate* name = new AsmStrImmediate("rt_write_int");
+   AddSubroutineBegin(name);
+   GenReserveWrite(11);
+   AddCmd(MOV, EAX, AsmMemory(ESP, 4, szDWORD));
+   AddCmd(TEST, EAX, EAX);
+   AddCmd(JGE, labelPositive);
+   AddCmd(MOV, AsmMemory(writeBuffer, ECX, 1, 0, szBYTE), AsmIntImmediate('-', szNONE));
+   AddCmd(INC, ECX);
+   AddCmd(NEG, EAX);
+   AddLabel(labelPositive);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), ECX);
+   AddCmd(PUSH, 10);
+   AddLabel(labelDigit);
+   AddCmd(MOV, ECX, EAX);
+   AddCmd(MOV, EDX, int(0xCCCCCCCD));
+   AddCmd(MUL, EDX);
+   AddCmd(SHR, EDX, 3);
+   AddCmd(MOV, EAX, EDX);
+   AddCmd(IMUL, EDX, 10);
+   AddCmd(SUB, ECX, EDX);
+   AddCmd(PUSH, ECX);
+   AddCmd(TEST, EAX, EAX);
+   AddCmd(JNE, labelDigit);
+   AddCmd(MOV, ECX, AsmMemory(writeLength, 0, szDWORD));
+   AddLabel(labelStore);
+   AddCmd(POP, EAX);
+   AddCmd(CMP, EAX, 10);
+   AddCmd(JE, labelEnd);
+   AddCmd(ADD, EAX, '0');
+   AddCmd(MOV, AsmMemory(writeBuffer, ECX, 1, 0, szBYTE), AL);
+   AddCmd(INC, ECX);
+   AddCmd(JMP, labelStore);
+   AddLabel(labelEnd);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), ECX);
+   AddCmd(RET);
+   AddSubroutineEnd(name);
+}
+
+//reals keep the format of the C library, sprintf puts them straight into the buffer
+void AsmCode::GenWriteReal()
+{
+   formatStrReal = formatStrReal == nullptr ? AddData("float", "% 0.14E") : formatStrReal;
+   AsmStrImmediate* name = new AsmStrImmediate("rt_write_real");
+   AddSubroutineBegin(name);
+   GenReserveWrite(32);
+   AddCmd(PUSH, AsmMemory(ESP, 8, szDWORD));
+   AddCmd(PUSH, AsmMemory(ESP, 8, szDWORD));
+   AddCmd(PUSH, AsmVarAddr(formatStrReal));
+   AddCmd(LEA, EAX, AsmMemory(writeBuffer, ECX, 1));
+   AddCmd(PUSH, EAX);
+   AddCmd(CALL, AsmStrImmediate("crt_sprintf"));
+   AddCmd(ADD, ESP, 16);
+   AddCmd(ADD, AsmMemory(writeLength, 0, szDWORD), EAX);
+   AddCmd(RET);
+   AddSubroutineEnd(name);
+}
+
+void AsmCode::GenWriteStr()
+{
+   AsmLabel* labelLoop = GenLabel("loop");
+   AsmLabel* labelLoad = GenLabel("load");
+   AsmLabel* labelEnd = GenLabel("end");
+   AsmStrImmediate* name = new AsmStrImmediate("rt_write_str");
+   AddSubroutineBegin(name);
+   AddCmd(MOV, EDX, AsmMemory(ESP, 4, szDWORD));
+   AddCmd(MOV, ECX, AsmMemory(writeLength, 0, szDWORD));
+   AddLabel(labelLoop);
+   AddCmd(CMP, ECX, writeBufferSize);
+   AddCmd(JB, labelLoad);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), ECX);
+   AddCmd(PUSH, EDX);
+   AddCmd(CALL, AsmStrImmediate("rt_flush"));
+   AddCmd(POP, EDX);
+   AddCmd(XOR, ECX, ECX);
+   AddLabel(labelLoad);
+   AddCmd(MOV, AL, AsmMemory(EDX, 0, szBYTE));
+   AddCmd(TEST, AL, AL);
+   AddCmd(JE, labelEnd);
+   AddCmd(MOV, AsmMemory(writeBuffer, ECX, 1, 0, szBYTE), AL);
+   AddCmd(INC, ECX);
+   AddCmd(INC, EDX);
+   AddCmd(JMP, labelLoop);
+   AddLabel(labelEnd);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), ECX);
+   AddCmd(RET);
+   AddSubroutineEnd(name);
+}
+
+void AsmCode::GenWriteLn()
+{
+   AsmStrImmediate* name = new AsmStrImmediate("rt_write_ln");
+   AddSubroutineBegin(name);
+   GenReserveWrite(1);
+   AddCmd(MOV, AsmMemory(writeBuffer, ECX, 1, 0, szBYTE), AsmIntImmediate('\n', szNONE));
+   AddCmd(INC, ECX);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), ECX);
+   AddCmd(RET);
+   AddSubroutineEnd(name);
+}
+
+//esi walks the kinds and edi the values, the first one was pushed last and lies lowest;
+//every routine ends jumping through the table to the routine of the next kind
+void AsmCode::GenWriteList()
+{
+   vector<AsmLabel*> labels(1, GenLabel("kind"));
+   for (auto &routine : writeRoutines) {
+      labels.push_back(runtimeCalls.count(routine) ? GenLabel("kind") : labels[0]);
+   }
+   AsmStrImmediate* table = AddData(labels);
+   auto dispatch = [&]() {
+      AddCmd(MOVZX, EAX, AsmMemory(ESI, 0, szBYTE));
+      AddCmd(INC, ESI);
+      AddCmd(JMP, new AsmMemory(table, EAX, 4, 0, szDWORD));
+   };
+   AsmStrImmediate* name = new AsmStrImmediate("rt_write_list");
+   AddSubroutineBegin(name);
+   AddCmd(PUSH, ESI);
+   AddCmd(PUSH, EDI);
+   AddCmd(MOV, ESI, AsmMemory(ESP, 12, szDWORD));
+   AddCmd(LEA, EDI, AsmMemory(ESP, 16));
+   dispatch();
+   AddLabel(labels[0]);
+   AddCmd(POP, EDI);
+   AddCmd(POP, ESI);
+   AddCmd(RET);
+   for (size_t i = 0; i < writeKinds.size(); i++) {
+      if (labels[i + 1] == labels[0]) continue;
+      AddLabel(labels[i + 1]);
+      switch (writeKinds[i]) {
+         case 'r':
+            AddCmd(FLD, AsmMemory(EDI, 0, szDWORD));
+            AddCmd(ADD, EDI, 4);
+            AddCmd(SUB, ESP, 8);
+            AddCmd(FSTP, AsmMemory(ESP, 0, szQWORD));
+            AddCmd(CALL, AsmStrImmediate(writeRoutines[i]));
+            AddCmd(ADD, ESP, 8);
+            break;
+         case 'n':
+            AddCmd(CALL, AsmStrImmediate(writeRoutines[i]));
+            break;
+         default:
+            AddCmd(PUSH, AsmMemory(EDI, 0, szDWORD));
+            AddCmd(ADD, EDI, 4);
+            AddCmd(CALL, AsmStrImmediate(writeRoutines[i]));
+            AddCmd(ADD, ESP, 4);
+            break;
+      }
+      dispatch();
+   }
+   AddSubroutineEnd(name);
+}
+
+void AsmCode::GenFlush()
+{
+   formatStrBuffer = AddData("buffer", "%.*s");
+   AsmLabel* labelEnd = GenLabel("end");
+   AsmStrImmediate* name = new AsmStrImmediate("rt_flush");
+   AddSubroutineBegin(name);
+   AddCmd(MOV, EAX, AsmMemory(writeLength, 0, szDWORD));
+   AddCmd(TEST, EAX, EAX);
+   AddCmd(JE, labelEnd);
+   AddCmd(PUSH, AsmVarAddr(writeBuffer));
+   AddCmd(PUSH, EAX);
+   AddCmd(PUSH, AsmVarAddr(formatStrBuffer));
    AddCmd(CALL, functWrite);
-   AddCmd(ADD, ESP, 4);
+   AddCmd(ADD, ESP, 12);
+   AddCmd(MOV, AsmMemory(writeLength, 0, szDWORD), AsmIntImmediate(0, szNONE));
+   AddLabel(labelEnd);
+   AddCmd(RET);
+   AddSubroutineEnd(name);
+}
+
+//only the routines the program calls
+void AsmCode::GenWriteRuntime()
+{
+   if (runtimeCalls.empty()) return;
+   if (runtimeCalls.count("rt_write_int")) {
+      GenWriteInt();
+   }
+   if (runtimeCalls.count("rt_write_real")) {
+      GenWriteReal();
+   }
+   if (runtimeCalls.count("rt_write_str")) {
+      GenWriteStr();
+   }
+   if (runtimeCalls.count("rt_write_ln")) {
+      GenWriteLn();
+   }
+   if (runtimeCalls.count("rt_write_list")) {
+      GenWriteList();
+   }
+   GenFlush();
+}
+
+//failed range checks of all subroutines jump to one handler placed after the main program
+AsmLabel* AsmCode::GetRangeErrorLabel()
+{
+   if (rangeErrorLabel == nullptr) {
+      rangeErrorLabel = GenLabel("range_error");
+      rangeErrorLabel->SetGlobal();
+   }
+   return rangeErrorLabel;
+}
+
+void AsmCode::GenRangeErrorHandler()
+{
+   if (rangeErrorLabel == nullptr) return;
+   AddLabel(rangeErrorLabel);
+   AddCmd(PUSH, AsmVarAddr(AddData("range_error", "Runtime error 201")));
+   GenCallWriteForStr();
+   GenWriteNewLine();
+   GenFlushWrites();
+   AddCmd(PUSH, 201);
+   AddCmd(CALL, AsmStrImmediate("crt_exit"));
 }
 
 void AsmCode::ReplaceCommands(Commands newCommands, size_t idx, size_t amount)
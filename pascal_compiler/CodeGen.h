@@ -4,10 +4,14 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <unordered_map>
 
 using namespace std;
 
+//fewer writes in a row are cheaper as calls of their own than as one rt_write_list
+#define WRITE_LIST_MIN 3
+
 enum SizeType {
    szNONE,
    szBYTE,
@@ -22,8 +26,11 @@ enum Register {
    EDX,
    ESP,
    EBP,
+   ESI,
+   EDI,
    AX,
    AL,
+   CL,
    ST1,
    ST
 };
@@ -38,6 +45,11 @@ enum OpCode {
    JE,
    JG,
    JL,
+   JLE,
+   JA,
+   JAE,
+   JB,
+   JBE,
    TEST,
 	CALL,
 	PUSH,
@@ -49,6 +61,9 @@ enum OpCode {
    NEG,
    SAR,
    SAL,
+   SHL,
+   SHR,
+   CDQ,
    SAHF,
    SETA,
    SETAE,
@@ -92,6 +107,7 @@ enum OpCode {
 
 struct AsmOperand;
 class AsmStrImmediate;
+class AsmEncoder;
 
 class Asm {
 protected:
@@ -103,6 +119,7 @@ public:
    bool operator!=(OpCode);
    OpCode GetOpCode() const;
    virtual void Print() const;
+   virtual void Encode(AsmEncoder&) const;
 };
 
 struct AsmCmd0: public Asm {
@@ -122,6 +139,7 @@ struct AsmCmd2: public Asm {
 
 class AsmLabel: public Asm {
    unsigned refAmount;
+   bool isGlobal;
 public:
    AsmLabel(AsmStrImmediate*);
    AsmLabel(AsmStrImmediate);
@@ -129,7 +147,9 @@ public:
    void IncRefAmount();
    void DecRefAmount();
    unsigned GetRefAmount() const;
+   void SetGlobal();
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 class AsmSubroutineBase: public Asm {
@@ -142,11 +162,13 @@ public:
 struct AsmSubroutineBegin: public AsmSubroutineBase {
    AsmSubroutineBegin(AsmStrImmediate*);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 struct AsmSubroutineEnd: public AsmSubroutineBase {
    AsmSubroutineEnd(AsmStrImmediate*);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 class AsmRawCmd: public Asm {
@@ -154,6 +176,7 @@ class AsmRawCmd: public Asm {
 public:
    AsmRawCmd(string);
    virtual void Print() const;
+   void Encode(AsmEncoder&) const override;
 };
 
 class AsmDataBase {
@@ -162,6 +185,7 @@ protected:
 public:
    AsmDataBase(string);
    virtual void Print() const;
+   virtual void Encode(AsmEncoder&) const;
 };
 
 class AsmData: public AsmDataBase {
@@ -169,6 +193,7 @@ class AsmData: public AsmDataBase {
 public:
    AsmData(string, size_t);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 class AsmDataReal: public AsmDataBase {
@@ -176,6 +201,7 @@ class AsmDataReal: public AsmDataBase {
 public:
    AsmDataReal(string, double);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 class AsmDataStr: public AsmDataBase {
@@ -183,12 +209,23 @@ class AsmDataStr: public AsmDataBase {
 public:
    AsmDataStr(string, string);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
+};
+
+//addresses of code labels, for jumps through a table
+class AsmDataTable: public AsmDataBase {
+   vector<AsmLabel*> _labels;
+public:
+   AsmDataTable(string, const vector<AsmLabel*>&);
+   void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 struct AsmDataNewLine: public AsmDataBase {
 public:
    AsmDataNewLine(string);
    void Print() const override;
+   void Encode(AsmEncoder&) const override;
 };
 
 struct AsmOperand {
@@ -202,6 +239,7 @@ class AsmRegister: public AsmOperand {
    Register _register;
 public:
    AsmRegister(Register);
+   Register GetRegister() const;
    bool operator==(AsmOperand*) override;
    bool operator!=(AsmOperand*);
    bool operator==(AsmRegister);
@@ -258,7 +296,10 @@ class AsmMemory: public AsmOperand {
    SizeType _size;
 public:
    AsmOperand* arg;
+   AsmRegister* index;
+   int scale;
    AsmMemory(AsmOperand*, int = 0, SizeType = szNONE);
+   AsmMemory(AsmOperand*, Register, int, int = 0, SizeType = szNONE);
    AsmMemory(Register, int = 0, SizeType = szNONE);
    AsmMemory(AsmRegister, int = 0, SizeType = szNONE);
    bool operator==(AsmOperand*) override;
@@ -318,31 +359,60 @@ typedef unordered_map<string, size_t> LabelInfo;
 class AsmCode: public AsmCodeBase {
    size_t labelCounter;
    AsmStrImmediate* formatStrReal;
-   AsmStrImmediate* formatStrInt;
-   AsmStrImmediate* formatStrNewLine;
+   AsmStrImmediate* formatStrBuffer;
+   AsmStrImmediate* writeBuffer;
+   AsmStrImmediate* writeLength;
+   AsmLabel* rangeErrorLabel;
+   set<string> runtimeCalls;
 
    AsmStrImmediate functWrite;
 
+   void CallRuntime(string);
+   void GenReserveWrite(int);
+   void GenWriteInt();
+   void GenWriteReal();
+   void GenWriteStr();
+   void GenWriteLn();
+   void GenWriteList();
+   void GenFlush();
+
    Data data;
+   Data constReals;
+   Data constStrings;
+   unordered_map<string, AsmStrImmediate*> constLabels;
+   size_t constUses;
+   size_t constSize;
    unordered_map<size_t, AsmLabel*> labels;
    LabelInfo labelsInfo;
 public:
    AsmCode();
    AsmStrImmediate* AddData(string);
-   AsmStrImmediate* AddData(string, double);
    AsmStrImmediate* AddData(string, size_t);
    AsmStrImmediate* AddData(string, string);
+   AsmStrImmediate* AddData(const vector<AsmLabel*>&);
+   AsmStrImmediate* AddConst(double);
+   AsmStrImmediate* AddConst(const string&);
+   vector<string> GetConstReport() const;
    void AddLabel(AsmLabel*);
    void AddSubroutineBegin(AsmStrImmediate*);
    void AddSubroutineEnd(AsmStrImmediate*);
    AsmLabel* GenLabel(string);
    string GenStrLabel(string);
    void Print() const;
+   void Encode(AsmEncoder&) const;
    void PushMemory(unsigned);
+   void PopRegister(Register);
+   bool OmitFramePointer(size_t);
    void GenCallWriteForInt();
    void GenCallWriteForReal();
+   void GenCallWriteForReal(AsmOperand*);
    void GenCallWriteForStr();
    void GenWriteNewLine();
+   void GenCallWriteList(const string&);
+   AsmLabel* GetRangeErrorLabel();
+   void GenRangeErrorHandler();
+   void GenFlushWrites();
+   void GenWriteRuntime();
    void ReplaceCommands(Commands, size_t, size_t = 1);
    bool TryToChangeLabelOfTheJump(Command);
    Command GetCommand(size_t) const;
@@ -375,4 +445,5 @@ T* CastOperand(AsmOperand* oper)
    return Cast<T>(oper);
 }
 
-extern bool CmpOperands(AsmOperand*, AsmOperand*);
\ No newline at end of file
+extern bool CmpOperands(AsmOperand*, AsmOperand*);
+extern string GetCmd(OpCode);
\ No newline at end of file
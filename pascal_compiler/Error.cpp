@@ -106,6 +106,9 @@ string SyntaxException::getMessage() const
 		case Tag::OF:
 			msg << "\"of\"";
 			break;
+		case Tag::RECORD:
+			msg << "\"record\"";
+			break;
 		case Tag::BEGIN:
 			msg << "\"begin\"";
 			break;
@@ -256,4 +259,26 @@ string IllegalTypeConversionException::getMessage() const
    stringstream msg;
    msg << fname << "(" << _line << ") Error: Illegal type conversion";
    return msg.str();
+}
+
+EncodeException::EncodeException(string& AFname, string AInstr):
+   fname(AFname), instr(AInstr)
+{}
+
+string EncodeException::getMessage() const
+{
+   stringstream msg;
+   msg << fname << " Error: Cannot encode \"" << instr << "\"";
+   return msg.str();
+}
+
+JitException::JitException(string& AFname, string AReason):
+   fname(AFname), reason(AReason)
+{}
+
+string JitException::getMessage() const
+{
+   stringstream msg;
+   msg << fname << " Error: Cannot run the program: " << reason;
+   return msg.str();
 }
\ No newline at end of file
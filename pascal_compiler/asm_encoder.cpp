@@ -0,0 +1,830 @@
+#include <algorithm>
+#include <cstring>
+#include "asm_encoder.h"
+
+static int GetRegCode(Register reg)
+{
+   switch (reg) {
+      case EAX:   return 0;
+      case ECX:   return 1;
+      case EDX:   return 2;
+      case EBX:   return 3;
+      case ESP:   return 4;
+      case EBP:   return 5;
+      case ESI:   return 6;
+      case EDI:   return 7;
+      case AX:    return 0;
+      case AL:    return 0;
+      case CL:    return 1;
+      case ST:    return 0;
+      case ST1:   return 1;
+      default:    return 0;
+   }
+}
+
+static int GetConditionCode(OpCode opCode)
+{
+   switch (opCode) {
+      case JB:    case SETB:  return 0x2;
+      case JAE:   case SETAE: return 0x3;
+      case JE:    case SETE:  return 0x4;
+      case JNE:   case SETNE: return 0x5;
+      case JBE:   case SETBE: return 0x6;
+      case JA:    case SETA:  return 0x7;
+      case JL:    case SETL:  return 0xC;
+      case JGE:   case SETGE: return 0xD;
+      case JLE:   case SETLE: return 0xE;
+      case JG:    case SETG:  return 0xF;
+      default:                return -1;
+   }
+}
+
+//the digit of add, or, and, sub, xor and cmp in their opcodes and modrm bytes
+static int GetAluCode(OpCode opCode)
+{
+   switch (opCode) {
+      case ADD:   return 0;
+      case OR:    return 1;
+      case AND:   return 4;
+      case SUB:   return 5;
+      case XOR:   return 6;
+      case CMP:   return 7;
+      default:    return -1;
+   }
+}
+
+static int GetShiftCode(OpCode opCode)
+{
+   switch (opCode) {
+      case RCL:   return 2;
+      case RCR:   return 3;
+      case SAL:   return 4;
+      case SHL:   return 4;
+      case SHR:   return 5;
+      case SAR:   return 7;
+      default:    return -1;
+   }
+}
+
+static bool IsShort(int value)
+{
+   return value >= -128 && value <= 127;
+}
+
+static bool IsImmediate(AsmOperand* oper)
+{
+   return TryToCastOperand<AsmIntImmediate>(oper) || TryToCastOperand<AsmVarAddr>(oper);
+}
+
+static bool IsShortImmediate(AsmOperand* oper)
+{
+   return TryToCastOperand<AsmIntImmediate>(oper) && IsShort(CastOperand<AsmIntImmediate>(oper)->GetIntValue());
+}
+
+static bool IsRegister(AsmOperand* oper, Register reg)
+{
+   return TryToCastOperand<AsmRegister>(oper) && CastOperand<AsmRegister>(oper)->GetRegister() == reg;
+}
+
+static bool IsByte(AsmOperand* oper)
+{
+   return IsRegister(oper, AL) || IsRegister(oper, CL)
+      || (TryToCastOperand<AsmMemory>(oper) && CastOperand<AsmMemory>(oper)->GetSizeType() == szBYTE);
+}
+
+static bool IsQword(AsmOperand* oper)
+{
+   return TryToCastOperand<AsmMemory>(oper) && CastOperand<AsmMemory>(oper)->GetSizeType() == szQWORD;
+}
+
+//a variable named without brackets, or a memory operand at a fixed address
+static bool IsAbsolute(AsmOperand* oper)
+{
+   AsmMemory* memory = CastOperand<AsmMemory>(oper);
+   return TryToCastOperand<AsmStrImmediate>(oper)
+      || (memory != nullptr && memory->index == nullptr && TryToCastOperand<AsmStrImmediate>(memory->arg));
+}
+
+static int GetRegCode(AsmOperand* oper)
+{
+   return GetRegCode(CastOperand<AsmRegister>(oper)->GetRegister());
+}
+
+//masm32 imports the msvcrt functions as crt_name
+static string GetExternalName(const string& name)
+{
+   return name.compare(0, 4, "crt_") == 0 ? name.substr(4) : name;
+}
+
+static void Put(vector<unsigned char>& bytes, unsigned value, size_t size)
+{
+   for (size_t i = 0; i < size; i++) {
+      bytes.push_back(value >> i * 8 & 0xFF);
+   }
+}
+
+static void Patch(vector<unsigned char>& bytes, size_t offset, int value)
+{
+   int old;
+   memcpy(&old, &bytes[offset], 4);
+   value += old;
+   memcpy(&bytes[offset], &value, 4);
+}
+
+static size_t Align(size_t value, size_t alignment)
+{
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+AsmEncoder::AsmEncoder(string AFname):
+   fname(AFname),
+   dataSection(asData),
+   bssSize(0),
+   isFinished(false)
+{}
+
+AsmFragment& AsmEncoder::NewFragment()
+{
+   AsmFragment fragment = { vector<unsigned char>(), vector<AsmRelocation>(), JMP, "", false, 0 };
+   fragments.push_back(fragment);
+   return fragments.back();
+}
+
+void AsmEncoder::AddSymbol(string name, AsmSection section, size_t offset)
+{
+   AsmSymbol symbol = { section, offset, false };
+   symbols[name] = symbol;
+   symbolNames.push_back(name);
+}
+
+void AsmEncoder::EmitByte(int value)
+{
+   fragments.back().bytes.push_back(value & 0xFF);
+}
+
+void AsmEncoder::EmitWord(int value)
+{
+   Put(fragments.back().bytes, value, 2);
+}
+
+void AsmEncoder::EmitInt(int value)
+{
+   Put(fragments.back().bytes, value, 4);
+}
+
+void AsmEncoder::EmitAddress(const string& symbol, int addend, bool isRelative)
+{
+   AsmRelocation relocation = { fragments.back().bytes.size(), symbol, isRelative };
+   fragments.back().relocations.push_back(relocation);
+   EmitInt(addend);
+}
+
+void AsmEncoder::EmitImmediate(AsmOperand* oper, bool isByte)
+{
+   AsmVarAddr* addr = CastOperand<AsmVarAddr>(oper);
+   if (addr != nullptr) {
+      EmitAddress(CastOperand<AsmImmediate>(addr->arg)->GetStrValue(), addr->GetOffset());
+   } else if (isByte) {
+      EmitByte(CastOperand<AsmIntImmediate>(oper)->GetIntValue());
+   } else {
+      EmitInt(CastOperand<AsmIntImmediate>(oper)->GetIntValue());
+   }
+}
+
+//the modrm byte with its sib byte and displacement; a variable is addressed by name, then
+//the displacement holds its offset and the relocation adds its address
+void AsmEncoder::EmitModRm(int reg, AsmOperand* oper)
+{
+   if (TryToCastOperand<AsmRegister>(oper)) {
+      EmitByte(0xC0 | reg << 3 | GetRegCode(oper));
+      return;
+   }
+   AsmMemory* memory = CastOperand<AsmMemory>(oper);
+   AsmOperand* base = memory != nullptr ? memory->arg : oper;
+   AsmRegister* index = memory != nullptr ? memory->index : nullptr;
+   int offset = memory != nullptr ? memory->GetOffset() : 0;
+   int scale = 0;
+   while (memory != nullptr && (1 << scale) < memory->scale) scale++;
+   if (!TryToCastOperand<AsmRegister>(base)) {
+      if (!TryToCastOperand<AsmStrImmediate>(base)) throw EncodeException(fname, "memory operand");
+      if (index != nullptr) {
+         EmitByte(0x04 | reg << 3);
+         EmitByte(scale << 6 | GetRegCode(index) << 3 | 5);
+      } else {
+         EmitByte(0x05 | reg << 3);
+      }
+      EmitAddress(CastOperand<AsmStrImmediate>(base)->GetStrValue(), offset);
+      return;
+   }
+   int baseCode = GetRegCode(base);
+   int mod = offset == 0 && baseCode != 5 ? 0 : IsShort(offset) ? 1 : 2;
+   if (index != nullptr || baseCode == 4) {
+      EmitByte(mod << 6 | reg << 3 | 4);
+      EmitByte(scale << 6 | (index != nullptr ? GetRegCode(index) : 4) << 3 | baseCode);
+   } else {
+      EmitByte(mod << 6 | reg << 3 | baseCode);
+   }
+   if (mod == 1) {
+      EmitByte(offset);
+   } else if (mod == 2) {
+      EmitInt(offset);
+   }
+}
+
+//jumps to labels get their bytes once the code is laid out, calls go to a procedure or to the C library
+void AsmEncoder::EncodeJump(OpCode opCode, AsmOperand* target)
+{
+   AsmStrImmediate* label = CastOperand<AsmStrImmediate>(target);
+   if (label == nullptr) {
+      if (opCode != JMP && opCode != CALL) throw EncodeException(fname, GetCmd(opCode));
+      EmitByte(0xFF);
+      EmitModRm(opCode == CALL ? 2 : 4, target);
+   } else if (opCode == CALL) {
+      EmitByte(0xE8);
+      EmitAddress(label->GetStrValue(), -4, true);
+   } else {
+      fragments.back().jump = opCode;
+      fragments.back().target = label->GetStrValue();
+   }
+}
+
+void AsmEncoder::EncodeUnary(OpCode opCode, AsmOperand* oper)
+{
+   bool isRegister = TryToCastOperand<AsmRegister>(oper) && !IsByte(oper);
+   switch (opCode) {
+      case PUSH:
+         if (isRegister) {
+            EmitByte(0x50 + GetRegCode(oper));
+         } else if (IsShortImmediate(oper)) {
+            EmitByte(0x6A);
+            EmitImmediate(oper, true);
+         } else if (IsImmediate(oper)) {
+            EmitByte(0x68);
+            EmitImmediate(oper, false);
+         } else {
+            EmitByte(0xFF);
+            EmitModRm(6, oper);
+         }
+         break;
+      case POP:
+         if (isRegister) {
+            EmitByte(0x58 + GetRegCode(oper));
+         } else {
+            EmitByte(0x8F);
+            EmitModRm(0, oper);
+         }
+         break;
+      case INC:
+      case DEC:
+         if (isRegister) {
+            EmitByte((opCode == INC ? 0x40 : 0x48) + GetRegCode(oper));
+         } else {
+            EmitByte(IsByte(oper) ? 0xFE : 0xFF);
+            EmitModRm(opCode == INC ? 0 : 1, oper);
+         }
+         break;
+      case NOT:
+      case NEG:
+      case MUL:
+      case IMUL:
+      case DIV:
+      case IDIV:
+         EmitByte(IsByte(oper) ? 0xF6 : 0xF7);
+         EmitModRm(opCode == NOT ? 2 : opCode == NEG ? 3 : opCode == MUL ? 4 : opCode == IMUL ? 5 : opCode == DIV ? 6 : 7, oper);
+         break;
+      default:
+         if (GetConditionCode(opCode) < 0) throw EncodeException(fname, GetCmd(opCode));
+         EmitByte(0x0F);
+         EmitByte(0x90 + GetConditionCode(opCode));
+         EmitModRm(0, oper);
+         break;
+   }
+}
+
+void AsmEncoder::EncodeBinary(OpCode opCode, AsmOperand* dest, AsmOperand* src)
+{
+   bool isByte = IsByte(dest) || (IsByte(src) && opCode != MOVZX && GetShiftCode(opCode) < 0);
+   bool isAccumulator = IsRegister(dest, EAX) || IsRegister(dest, AL);
+   switch (opCode) {
+      case LEA:
+         EmitByte(0x8D);
+         EmitModRm(GetRegCode(dest), src);
+         break;
+      case MOVZX:
+         EmitByte(0x0F);
+         EmitByte(IsByte(src) ? 0xB6 : 0xB7);
+         EmitModRm(GetRegCode(dest), src);
+         break;
+      case IMUL:
+         if (IsImmediate(src)) {
+            EmitByte(IsShortImmediate(src) ? 0x6B : 0x69);
+            EmitModRm(GetRegCode(dest), dest);
+            EmitImmediate(src, IsShortImmediate(src));
+         } else {
+            EmitByte(0x0F);
+            EmitByte(0xAF);
+            EmitModRm(GetRegCode(dest), src);
+         }
+         break;
+      case MOV:
+         if (IsImmediate(src) && TryToCastOperand<AsmRegister>(dest)) {
+            EmitByte((isByte ? 0xB0 : 0xB8) + GetRegCode(dest));
+            EmitImmediate(src, isByte);
+         } else if (IsImmediate(src)) {
+            EmitByte(isByte ? 0xC6 : 0xC7);
+            EmitModRm(0, dest);
+            EmitImmediate(src, isByte);
+         } else if ((isAccumulator && IsAbsolute(src)) || (IsAbsolute(dest) && (IsRegister(src, EAX) || IsRegister(src, AL)))) {
+            AsmOperand* memory = isAccumulator ? src : dest;
+            AsmOperand* base = TryToCastOperand<AsmMemory>(memory) ? CastOperand<AsmMemory>(memory)->arg : memory;
+            EmitByte((isAccumulator ? 0xA0 : 0xA2) + !isByte);
+            EmitAddress(CastOperand<AsmStrImmediate>(base)->GetStrValue(), TryToCastOperand<AsmMemory>(memory) ? CastOperand<AsmMemory>(memory)->GetOffset() : 0);
+         } else if (TryToCastOperand<AsmRegister>(src)) {
+            EmitByte(isByte ? 0x88 : 0x89);
+            EmitModRm(GetRegCode(src), dest);
+         } else {
+            EmitByte(isByte ? 0x8A : 0x8B);
+            EmitModRm(GetRegCode(dest), src);
+         }
+         break;
+      case TEST:
+         if (IsImmediate(src) && isAccumulator) {
+            EmitByte(isByte ? 0xA8 : 0xA9);
+            EmitImmediate(src, isByte);
+         } else if (IsImmediate(src)) {
+            EmitByte(isByte ? 0xF6 : 0xF7);
+            EmitModRm(0, dest);
+            EmitImmediate(src, isByte);
+         } else if (TryToCastOperand<AsmRegister>(src)) {
+            EmitByte(isByte ? 0x84 : 0x85);
+            EmitModRm(GetRegCode(src), dest);
+         } else {
+            EmitByte(isByte ? 0x84 : 0x85);
+            EmitModRm(GetRegCode(dest), src);
+         }
+         break;
+      default:
+         if (GetShiftCode(opCode) >= 0) {
+            bool isOne = IsImmediate(src) && CastOperand<AsmIntImmediate>(src)->GetIntValue() == 1;
+            EmitByte((TryToCastOperand<AsmRegister>(src) ? 0xD2 : isOne ? 0xD0 : 0xC0) + !isByte);
+            EmitModRm(GetShiftCode(opCode), dest);
+            if (IsImmediate(src) && !isOne) {
+               EmitImmediate(src, true);
+            }
+            break;
+         }
+         int code = GetAluCode(opCode);
+         if (code < 0) throw EncodeException(fname, GetCmd(opCode));
+         if (IsImmediate(src) && !isByte && IsShortImmediate(src)) {
+            EmitByte(0x83);
+            EmitModRm(code, dest);
+            EmitImmediate(src, true);
+         } else if (IsImmediate(src) && isAccumulator) {
+            EmitByte(code << 3 | (isByte ? 4 : 5));
+            EmitImmediate(src, isByte);
+         } else if (IsImmediate(src)) {
+            EmitByte(isByte ? 0x80 : 0x81);
+            EmitModRm(code, dest);
+            EmitImmediate(src, isByte);
+         } else if (TryToCastOperand<AsmRegister>(src)) {
+            EmitByte(code << 3 | (isByte ? 0 : 1));
+            EmitModRm(GetRegCode(src), dest);
+         } else {
+            EmitByte(code << 3 | (isByte ? 2 : 3));
+            EmitModRm(GetRegCode(dest), src);
+         }
+         break;
+   }
+}
+
+//the operand of the popping arithmetic and of fxch is st(i), the other register being st
+void AsmEncoder::EncodeFloat(OpCode opCode, AsmOperand* oper)
+{
+   int st = oper != nullptr && TryToCastOperand<AsmRegister>(oper) ? GetRegCode(oper) : 1;
+   switch (opCode) {
+      case FCHS:     EmitByte(0xD9); EmitByte(0xE0); break;
+      case FCOMPP:   EmitByte(0xDE); EmitByte(0xD9); break;
+      case FNSTSW:   EmitByte(0xDF); EmitByte(0xE0); break;
+      case FADDP:    EmitByte(0xDE); EmitByte(0xC0 + st); break;
+      case FMULP:    EmitByte(0xDE); EmitByte(0xC8 + st); break;
+      case FSUBP:    EmitByte(0xDE); EmitByte(0xE8 + st); break;
+      case FDIVRP:   EmitByte(0xDE); EmitByte(0xF0 + st); break;
+      case FDIVP:    EmitByte(0xDE); EmitByte(0xF8 + st); break;
+      case FXCH:     EmitByte(0xD9); EmitByte(0xC8 + st); break;
+      case FLD:
+         if (TryToCastOperand<AsmRegister>(oper)) {
+            EmitByte(0xD9);
+            EmitByte(0xC0 + st);
+         } else {
+            EmitByte(IsQword(oper) ? 0xDD : 0xD9);
+            EmitModRm(0, oper);
+         }
+         break;
+      case FILD:
+         EmitByte(IsQword(oper) ? 0xDF : 0xDB);
+         EmitModRm(IsQword(oper) ? 5 : 0, oper);
+         break;
+      case FSTP:
+         if (TryToCastOperand<AsmRegister>(oper)) {
+            EmitByte(0xDD);
+            EmitByte(0xD8 + st);
+         } else {
+            EmitByte(IsQword(oper) ? 0xDD : 0xD9);
+            EmitModRm(3, oper);
+         }
+         break;
+      default:
+         throw EncodeException(fname, GetCmd(opCode));
+   }
+}
+
+void AsmEncoder::Encode(OpCode opCode, AsmOperand* arg1, AsmOperand* arg2)
+{
+   NewFragment();
+   switch (opCode) {
+      case CDQ:
+         EmitByte(0x99);
+         break;
+      case SAHF:
+         EmitByte(0x9E);
+         break;
+      case RET:
+         if (arg1 != nullptr) {
+            EmitByte(0xC2);
+            EmitWord(CastOperand<AsmIntImmediate>(arg1)->GetIntValue());
+         } else {
+            EmitByte(0xC3);
+         }
+         break;
+      case CALL:
+      case JMP:
+      case JNE:
+      case JGE:
+      case JE:
+      case JG:
+      case JL:
+      case JLE:
+      case JA:
+      case JAE:
+      case JB:
+      case JBE:
+         EncodeJump(opCode, arg1);
+         break;
+      case FLD:
+      case FILD:
+      case FCHS:
+      case FADDP:
+      case FSUBP:
+      case FMULP:
+      case FDIVP:
+      case FDIVRP:
+      case FSTP:
+      case FXCH:
+      case FCOMPP:
+      case FNSTSW:
+         EncodeFloat(opCode, arg1);
+         break;
+      default:
+         if (arg1 == nullptr) throw EncodeException(fname, GetCmd(opCode));
+         if (arg2 != nullptr) {
+            EncodeBinary(opCode, arg1, arg2);
+         } else {
+            EncodeUnary(opCode, arg1);
+         }
+         break;
+   }
+}
+
+void AsmEncoder::AddLabel(string name)
+{
+   AddSymbol(name, asText, fragments.size());
+}
+
+//the program entry is written as a label and an end directive
+void AsmEncoder::AddRaw(string cmd)
+{
+   if (cmd.compare(0, 4, "end ") == 0) {
+      symbols[cmd.substr(4)].isGlobal = true;
+   } else if (!cmd.empty() && cmd.back() == ':') {
+      AddLabel(cmd.substr(0, cmd.find(':')));
+   } else {
+      throw EncodeException(fname, cmd);
+   }
+}
+
+void AsmEncoder::AlignData(vector<unsigned char>& bytes) const
+{
+   bytes.resize(Align(bytes.size(), 4));
+}
+
+//the constants are not aligned one by one, the reals come first
+void AsmEncoder::SetDataSection(AsmSection section)
+{
+   dataSection = section;
+}
+
+void AsmEncoder::AddData(string name, const string& bytes)
+{
+   if (dataSection == asRodata) {
+      AddSymbol(name, asRodata, rodata.size());
+      rodata.insert(rodata.end(), bytes.begin(), bytes.end());
+      return;
+   }
+   AlignData(data);
+   AddSymbol(name, asData, data.size());
+   data.insert(data.end(), bytes.begin(), bytes.end());
+}
+
+void AsmEncoder::AddData(string name, size_t size)
+{
+   bssSize = Align(bssSize, 4);
+   AddSymbol(name, asBss, bssSize);
+   bssSize += size;
+}
+
+void AsmEncoder::AddData(string name, const vector<string>& labels)
+{
+   AlignData(data);
+   AddSymbol(name, asData, data.size());
+   for (auto &label : labels) {
+      AsmRelocation relocation = { data.size(), label, false };
+      dataRelocations.push_back(relocation);
+      Put(data, 0, 4);
+   }
+}
+
+size_t AsmEncoder::GetSize(const AsmFragment& fragment) const
+{
+   if (fragment.target.empty()) {
+      return fragment.bytes.size();
+   }
+   return !fragment.isLong ? 2 : fragment.jump == JMP ? 5 : 6;
+}
+
+size_t AsmEncoder::GetTextOffset(const string& name)
+{
+   auto it = symbols.find(name);
+   if (it == symbols.end() || it->second.section != asText) throw EncodeException(fname, "jmp " + name);
+   if (it->second.offset < fragments.size()) {
+      return fragments[it->second.offset].offset;
+   }
+   return fragments.empty() ? 0 : fragments.back().offset + GetSize(fragments.back());
+}
+
+//jumps start short and grow while their labels are out of reach; growing only moves labels
+//further away, so the sizes settle
+void AsmEncoder::Layout()
+{
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      size_t offset = 0;
+      for (auto &fragment : fragments) {
+         fragment.offset = offset;
+         offset += GetSize(fragment);
+      }
+      for (auto &fragment : fragments) {
+         if (fragment.target.empty() || fragment.isLong) continue;
+         int distance = int(GetTextOffset(fragment.target) - (fragment.offset + GetSize(fragment)));
+         if (!IsShort(distance)) {
+            fragment.isLong = true;
+            isChanged = true;
+         }
+      }
+   }
+}
+
+//the code bytes; calls of the own procedures are resolved here, the rest is left to the linker
+void AsmEncoder::Assemble()
+{
+   for (auto &fragment : fragments) {
+      if (!fragment.target.empty()) {
+         int distance = int(GetTextOffset(fragment.target) - (fragment.offset + GetSize(fragment)));
+         int code = GetConditionCode(fragment.jump);
+         if (!fragment.isLong) {
+            text.push_back(fragment.jump == JMP ? 0xEB : 0x70 + code);
+            text.push_back(distance & 0xFF);
+            continue;
+         }
+         if (fragment.jump == JMP) {
+            text.push_back(0xE9);
+         } else {
+            text.push_back(0x0F);
+            text.push_back(0x80 + code);
+         }
+         Put(text, distance, 4);
+         continue;
+      }
+      text.insert(text.end(), fragment.bytes.begin(), fragment.bytes.end());
+      for (auto relocation : fragment.relocations) {
+         relocation.offset += fragment.offset;
+         auto it = symbols.find(relocation.symbol);
+         if (relocation.isRelative && it != symbols.end() && it->second.section == asText) {
+            Patch(text, relocation.offset, int(GetTextOffset(relocation.symbol) - relocation.offset));
+         } else {
+            textRelocations.push_back(relocation);
+         }
+      }
+   }
+}
+
+//after this the text symbols hold their offsets
+void AsmEncoder::Finish()
+{
+   if (isFinished) return;
+   Layout();
+   Assemble();
+   for (auto &symbol : symbols) {
+      if (symbol.second.section == asText) {
+         symbol.second.offset = GetTextOffset(symbol.first);
+      }
+   }
+   isFinished = true;
+}
+
+//sections: text, data, read-only data, bss, their relocations, the symbols with their names, the section names
+//and the note telling the linker the stack need not be executable
+void AsmEncoder::Write(ostream& out)
+{
+   enum { shNull, shText, shData, shRodata, shBss, shRelText, shRelData, shSymtab, shStrtab, shNote, shShstrtab, shAmount };
+   Finish();
+   vector<unsigned char> text = this->text, data = this->data;
+   vector<unsigned char> symtab, strtab(1, 0);
+   unordered_map<string, size_t> indices;
+   auto addSymbol = [&](const string& name, size_t value, int info, int section) {
+      Put(symtab, name.empty() ? 0 : strtab.size(), 4);
+      Put(symtab, value, 4);
+      Put(symtab, 0, 4);
+      Put(symtab, info, 1);
+      Put(symtab, 0, 1);
+      Put(symtab, section, 2);
+      if (!name.empty()) {
+         strtab.insert(strtab.end(), name.begin(), name.end());
+         strtab.push_back(0);
+      }
+      return symtab.size() / 16 - 1;
+   };
+   auto getSection = [](AsmSection section) {
+      return section == asText ? shText : section == asData ? shData : section == asRodata ? shRodata : shBss;
+   };
+   addSymbol("", 0, 0, 0);
+   size_t sectionSymbols[] = { 0, addSymbol("", 0, 3, shText), addSymbol("", 0, 3, shData),
+      addSymbol("", 0, 3, shRodata), addSymbol("", 0, 3, shBss) };
+   size_t firstGlobal;
+   for (int isGlobal = 0; isGlobal < 2; isGlobal++) {
+      firstGlobal = symtab.size() / 16;
+      for (auto &name : symbolNames) {
+         AsmSymbol& symbol = symbols[name];
+         if (symbol.isGlobal == (isGlobal != 0) && indices.count(name) == 0) {
+            indices[name] = addSymbol(name, symbol.offset, isGlobal << 4 | (symbol.section == asText ? 0 : 1), getSection(symbol.section));
+         }
+      }
+   }
+   auto relocate = [&](const vector<AsmRelocation>& relocations, vector<unsigned char>& bytes) {
+      vector<unsigned char> result;
+      for (auto &relocation : relocations) {
+         auto it = symbols.find(relocation.symbol);
+         size_t index;
+         if (it != symbols.end() && it->second.section != asNone) {
+            Patch(bytes, relocation.offset, int(it->second.offset));
+            index = sectionSymbols[getSection(it->second.section)];
+         } else {
+            string name = GetExternalName(relocation.symbol);
+            if (indices.count(name) == 0) {
+               indices[name] = addSymbol(name, 0, 1 << 4, 0);
+            }
+            index = indices[name];
+         }
+         Put(result, relocation.offset, 4);
+         Put(result, index << 8 | (relocation.isRelative ? 2 : 1), 4);
+      }
+      return result;
+   };
+   vector<unsigned char> relText = relocate(textRelocations, text);
+   vector<unsigned char> relData = relocate(dataRelocations, data);
+   const char* names[] = { "", ".text", ".data", ".rodata", ".bss", ".rel.text", ".rel.data", ".symtab", ".strtab", ".note.GNU-stack", ".shstrtab" };
+   vector<unsigned char> shstrtab;
+   vector<size_t> nameOffsets;
+   for (auto &name : names) {
+      nameOffsets.push_back(shstrtab.size());
+      shstrtab.insert(shstrtab.end(), name, name + strlen(name) + 1);
+   }
+   vector<unsigned char>* contents[] = { nullptr, &text, &data, &rodata, nullptr, &relText, &relData, &symtab, &strtab, nullptr, &shstrtab };
+   //type, flags, link, info, alignment, entry size
+   unsigned headers[][6] = {
+      { 0, 0, 0, 0, 0, 0 },
+      { 1, 6, 0, 0, 16, 0 },
+      { 1, 3, 0, 0, 4, 0 },
+      { 1, 2, 0, 0, 4, 0 },
+      { 8, 3, 0, 0, 4, 0 },
+      { 9, 0, shSymtab, shText, 4, 8 },
+      { 9, 0, shSymtab, shData, 4, 8 },
+      { 2, 0, shStrtab, unsigned(firstGlobal), 4, 16 },
+      { 3, 0, 0, 0, 1, 0 },
+      { 1, 0, 0, 0, 1, 0 },
+      { 3, 0, 0, 0, 1, 0 },
+   };
+   vector<unsigned char> file(52);
+   size_t offsets[shAmount] = {}, sizes[shAmount] = {};
+   for (int i = 1; i < shAmount; i++) {
+      file.resize(Align(file.size(), max(headers[i][4], 1u)));
+      offsets[i] = file.size();
+      if (contents[i] != nullptr) {
+         file.insert(file.end(), contents[i]->begin(), contents[i]->end());
+         sizes[i] = contents[i]->size();
+      }
+   }
+   sizes[shBss] = bssSize;
+   file.resize(Align(file.size(), 4));
+   size_t sectionHeaders = file.size();
+   for (int i = 0; i < shAmount; i++) {
+      Put(file, i ? nameOffsets[i] : 0, 4);
+      Put(file, headers[i][0], 4);
+      Put(file, headers[i][1], 4);
+      Put(file, 0, 4);
+      Put(file, i ? offsets[i] : 0, 4);
+      Put(file, sizes[i], 4);
+      Put(file, headers[i][2], 4);
+      Put(file, headers[i][3], 4);
+      Put(file, headers[i][4], 4);
+      Put(file, headers[i][5], 4);
+   }
+   vector<unsigned char> header = { 0x7F, 'E', 'L', 'F', 1, 1, 1 };
+   header.resize(16);
+   Put(header, 1, 2);
+   Put(header, 3, 2);
+   Put(header, 1, 4);
+   Put(header, 0, 4);
+   Put(header, 0, 4);
+   Put(header, sectionHeaders, 4);
+   Put(header, 0, 4);
+   Put(header, 52, 2);
+   Put(header, 0, 2);
+   Put(header, 0, 2);
+   Put(header, 40, 2);
+   Put(header, shAmount, 2);
+   Put(header, shShstrtab, 2);
+   copy(header.begin(), header.end(), file.begin());
+   out.write((const char*)file.data(), file.size());
+}
+
+size_t AsmEncoder::GetTextSize()
+{
+   Finish();
+   return text.size();
+}
+
+//the constants follow the data and the bss follows them
+size_t AsmEncoder::GetDataSize() const
+{
+   return Align(data.size(), 4) + Align(rodata.size(), 4) + bssSize;
+}
+
+size_t AsmEncoder::GetOffset(const string& name)
+{
+   Finish();
+   return symbols[name].offset;
+}
+
+//the address of a variable or a constant when the data is placed at dataBase, the constants and the bss after it
+size_t AsmEncoder::GetDataAddress(const string& name, size_t dataBase)
+{
+   Finish();
+   const AsmSymbol& symbol = symbols[name];
+   size_t base = dataBase;
+   if (symbol.section == asRodata || symbol.section == asBss) {
+      base += Align(data.size(), 4);
+   }
+   if (symbol.section == asBss) {
+      base += Align(rodata.size(), 4);
+   }
+   return base + symbol.offset;
+}
+
+//the code and the data as they are to run at the given addresses, with the functions
+//called from outside at the addresses of the table
+void AsmEncoder::Link(size_t textBase, size_t dataBase, const unordered_map<string, size_t>& externals,
+   vector<unsigned char>& textImage, vector<unsigned char>& dataImage)
+{
+   Finish();
+   textImage = text;
+   dataImage = data;
+   dataImage.resize(Align(data.size(), 4));
+   dataImage.insert(dataImage.end(), rodata.begin(), rodata.end());
+   dataImage.resize(GetDataSize());
+   auto getAddress = [&](const string& name) {
+      auto it = symbols.find(name);
+      if (it != symbols.end() && it->second.section != asNone) {
+         return it->second.section == asText ? textBase + it->second.offset : GetDataAddress(name, dataBase);
+      }
+      auto external = externals.find(name);
+      if (external == externals.end()) throw EncodeException(fname, "call " + name);
+      return external->second;
+   };
+   for (auto &relocation : textRelocations) {
+      Patch(textImage, relocation.offset, int(getAddress(relocation.symbol) - (relocation.isRelative ? textBase + relocation.offset : 0)));
+   }
+   for (auto &relocation : dataRelocations) {
+      Patch(dataImage, relocation.offset, int(getAddress(relocation.symbol) - (relocation.isRelative ? dataBase + relocation.offset : 0)));
+   }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "CodeGen.h"
+#include "error.h"
+
+using namespace std;
+
+enum AsmSection {
+   asNone,
+   asText,
+   asData,
+   asRodata,
+   asBss
+};
+
+//the text symbols hold the number of the fragment they stand before until the code is laid out
+struct AsmSymbol {
+   AsmSection section;
+   size_t offset;
+   bool isGlobal;
+};
+
+//four bytes holding the address of a symbol plus the value already there, minus their own address if relative
+struct AsmRelocation {
+   size_t offset;
+   string symbol;
+   bool isRelative;
+};
+
+//one instruction; a jump to a label of the code is short until the label gets out of its reach
+struct AsmFragment {
+   vector<unsigned char> bytes;
+   vector<AsmRelocation> relocations;
+   OpCode jump;
+   string target;
+   bool isLong;
+   size_t offset;
+};
+
+//turns the commands into i386 machine code and writes a relocatable ELF object; the msvcrt
+//functions the code calls as crt_name become the C library ones, so the C runtime links it
+class AsmEncoder {
+   string fname;
+   vector<AsmFragment> fragments;
+   vector<unsigned char> text;
+   vector<AsmRelocation> textRelocations;
+   vector<unsigned char> data;
+   vector<AsmRelocation> dataRelocations;
+   vector<unsigned char> rodata;
+   AsmSection dataSection;
+   size_t bssSize;
+   bool isFinished;
+   unordered_map<string, AsmSymbol> symbols;
+   vector<string> symbolNames;
+
+   AsmFragment& NewFragment();
+   void AddSymbol(string, AsmSection, size_t);
+   void EmitByte(int);
+   void EmitWord(int);
+   void EmitInt(int);
+   void EmitAddress(const string&, int, bool = false);
+   void EmitImmediate(AsmOperand*, bool);
+   void EmitModRm(int, AsmOperand*);
+   void EncodeJump(OpCode, AsmOperand*);
+   void EncodeUnary(OpCode, AsmOperand*);
+   void EncodeBinary(OpCode, AsmOperand*, AsmOperand*);
+   void EncodeFloat(OpCode, AsmOperand*);
+   size_t GetSize(const AsmFragment&) const;
+   size_t GetTextOffset(const string&);
+   void Layout();
+   void Assemble();
+   void Finish();
+   void AlignData(vector<unsigned char>&) const;
+public:
+   AsmEncoder(string);
+   void AddLabel(string);
+   void AddRaw(string);
+   void SetDataSection(AsmSection);
+   void AddData(string, const string&);
+   void AddData(string, size_t);
+   void AddData(string, const vector<string>&);
+   void Encode(OpCode, AsmOperand*, AsmOperand*);
+   void Write(ostream&);
+   size_t GetTextSize();
+   size_t GetDataSize() const;
+   size_t GetOffset(const string&);
+   size_t GetDataAddress(const string&, size_t);
+   void Link(size_t, size_t, const unordered_map<string, size_t>&, vector<unsigned char>&, vector<unsigned char>&);
+};
@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <cstdarg>
+#include <csetjmp>
+#include <algorithm>
+#include "asm_jit.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static jmp_buf exitPoint;
+static int exitCode;
+
+static int JitWrite(const char* format, ...)
+{
+   va_list args;
+   va_start(args, format);
+   int result = vprintf(format, args);
+   va_end(args);
+   return result;
+}
+
+static int JitFormat(char* buffer, const char* format, ...)
+{
+   va_list args;
+   va_start(args, format);
+   int result = vsprintf(buffer, format, args);
+   va_end(args);
+   return result;
+}
+
+//a runtime error ends the program, not the compiler
+static void JitExit(int code)
+{
+   exitCode = code;
+   longjmp(exitPoint, 1);
+}
+
+static unsigned char* Allocate(size_t size)
+{
+#ifdef _WIN32
+   return (unsigned char*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+   void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   return memory != MAP_FAILED ? (unsigned char*)memory : nullptr;
+#endif
+}
+
+static bool MakeExecutable(unsigned char* memory, size_t size)
+{
+#ifdef _WIN32
+   DWORD protection;
+   return VirtualProtect(memory, size, PAGE_EXECUTE_READ, &protection) != 0;
+#else
+   return mprotect(memory, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+static void Free(unsigned char* memory, size_t size)
+{
+#ifdef _WIN32
+   VirtualFree(memory, 0, MEM_RELEASE);
+#else
+   munmap(memory, size);
+#endif
+}
+
+//the pages are given back however Run ends, an exception thrown while linking included
+class JitMemory {
+   unsigned char* memory;
+   size_t size;
+public:
+   JitMemory(size_t ASize):
+      memory(Allocate(ASize)),
+      size(ASize)
+   {}
+   JitMemory(const JitMemory&) = delete;
+   JitMemory& operator=(const JitMemory&) = delete;
+   ~JitMemory()
+   {
+      if (memory != nullptr) {
+         Free(memory, size);
+      }
+   }
+   unsigned char* Get() const
+   {
+      return memory;
+   }
+};
+
+AsmJit::AsmJit(string AFname):
+   fname(AFname)
+{}
+
+//the program's main clobbers the registers the caller keeps, so it is called through
+//an entry that saves them; the code is never writable and executable at once
+int AsmJit::Run(const AsmCode& asmCode)
+{
+   if (sizeof(void*) != 4) throw JitException(fname, "the code is i386 and this build of the compiler is not");
+   AsmEncoder encoder(fname);
+   AsmCodeBase entry;
+   entry.AddCmd(new AsmLabel("jit_entry"));
+   entry.AddCmd(PUSH, EBP);
+   entry.AddCmd(PUSH, EBX);
+   entry.AddCmd(PUSH, ESI);
+   entry.AddCmd(PUSH, EDI);
+   entry.AddCmd(CALL, AsmStrImmediate("main"));
+   entry.AddCmd(POP, EDI);
+   entry.AddCmd(POP, ESI);
+   entry.AddCmd(POP, EBX);
+   entry.AddCmd(POP, EBP);
+   entry.AddCmd(RET);
+   for (auto &command : entry.commands) {
+      command->Encode(encoder);
+   }
+   asmCode.Encode(encoder);
+   unordered_map<string, size_t> externals;
+   externals["crt_printf"] = size_t(&JitWrite);
+   externals["crt_exit"] = size_t(&JitExit);
+   externals["crt_sprintf"] = size_t(&JitFormat);
+   size_t textSize = encoder.GetTextSize(), dataSize = max(encoder.GetDataSize(), size_t(1));
+   JitMemory codePages(textSize), dataPages(dataSize);
+   unsigned char* code = codePages.Get();
+   unsigned char* memory = dataPages.Get();
+   if (code == nullptr || memory == nullptr) throw JitException(fname, "out of memory");
+   vector<unsigned char> textImage, dataImage;
+   encoder.Link(size_t(code), size_t(memory), externals, textImage, dataImage);
+   copy(textImage.begin(), textImage.end(), code);
+   copy(dataImage.begin(), dataImage.end(), memory);
+   if (!MakeExecutable(code, textSize)) throw JitException(fname, "memory cannot be made executable");
+   void (*run)() = (void (*)())(code + encoder.GetOffset("jit_entry"));
+   exitCode = 0;
+   if (setjmp(exitPoint) == 0) {
+      run();
+   }
+   fflush(stdout);
+   return exitCode;
+}
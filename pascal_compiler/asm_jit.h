@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include "CodeGen.h"
+#include "asm_encoder.h"
+
+using namespace std;
+
+//runs the program inside the compiler: the code goes to executable memory and its calls of
+//the C library go to the runtime here; the code is i386, so this takes a 32-bit build
+class AsmJit {
+   string fname;
+public:
+   AsmJit(string);
+   int Run(const AsmCode&);
+};
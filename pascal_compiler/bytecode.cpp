@@ -0,0 +1,683 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "bytecode.h"
+
+#if defined(__GNUC__)
+#define BC_THREADED
+#endif
+
+static const size_t memorySize = 8 << 20;
+static const size_t stackReserve = 64;
+
+static bool IsConst(const IrOperand& oper)
+{
+   return oper.kind == ioImm || oper.kind == ioAddr;
+}
+
+static BcOpCode GetBinaryOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irAdd:   return bcAdd;
+      case irSub:   return bcSub;
+      case irMul:   return bcMul;
+      case irDiv:   return bcDiv;
+      case irMod:   return bcMod;
+      case irAnd:   return bcAnd;
+      case irOr:    return bcOr;
+      case irXor:   return bcXor;
+      case irShl:   return bcShl;
+      case irShr:   return bcShr;
+      case irSetEq: return bcSetEq;
+      case irSetNe: return bcSetNe;
+      case irSetLt: return bcSetLt;
+      case irSetLe: return bcSetLe;
+      case irSetGt: return bcSetGt;
+      default:      return bcSetGe;
+   }
+}
+
+static BcOpCode GetRealOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irFAdd:   return bcFAdd;
+      case irFSub:   return bcFSub;
+      case irFMul:   return bcFMul;
+      case irFDiv:   return bcFDiv;
+      case irFNeg:   return bcFNeg;
+      case irFSetEq: return bcFSetEq;
+      case irFSetNe: return bcFSetNe;
+      case irFSetLt: return bcFSetLt;
+      case irFSetLe: return bcFSetLe;
+      case irFSetGt: return bcFSetGt;
+      default:       return bcFSetGe;
+   }
+}
+
+static BcOpCode GetJumpOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irSetEq: return bcJEq;
+      case irSetNe: return bcJNe;
+      case irSetLt: return bcJLt;
+      case irSetLe: return bcJLe;
+      case irSetGt: return bcJGt;
+      default:      return bcJGe;
+   }
+}
+
+static BcOpCode InvertJump(BcOpCode op)
+{
+   switch (op) {
+      case bcJEq: return bcJNe;
+      case bcJNe: return bcJEq;
+      case bcJLt: return bcJGe;
+      case bcJLe: return bcJGt;
+      case bcJGt: return bcJLe;
+      default:    return bcJLt;
+   }
+}
+
+static BcOpCode SwapJump(BcOpCode op)
+{
+   switch (op) {
+      case bcJLt: return bcJGt;
+      case bcJLe: return bcJGe;
+      case bcJGt: return bcJLt;
+      case bcJGe: return bcJLe;
+      default:    return op;
+   }
+}
+
+static int& GetField(BcInstr& instr, int field)
+{
+   return field == 0 ? instr.a : field == 1 ? instr.b : instr.c;
+}
+
+BytecodeCompiler::BytecodeCompiler(BcProgram& AProgram, AsmEncoder& AEncoder):
+   program(AProgram),
+   encoder(AEncoder),
+   function(nullptr),
+   nextBlock(nullptr)
+{}
+
+void BytecodeCompiler::Emit(BcOpCode op, int a, int b, int c)
+{
+   BcInstr instr;
+   instr.op = op;
+   instr.a = a;
+   instr.b = b;
+   instr.c = c;
+   program.code.push_back(instr);
+}
+
+//the target goes into the field as the block id until the function is laid out
+void BytecodeCompiler::EmitJump(BcOpCode op, int a, int b, IrBlock* target)
+{
+   int field = op == bcJump ? 0 : 2;
+   Emit(op, a, b);
+   GetField(program.code.back(), field) = target->id;
+   fixups.push_back(make_pair(program.code.size() - 1, field));
+}
+
+int BytecodeCompiler::GetConst(const IrOperand& oper)
+{
+   return oper.kind == ioAddr ? int(encoder.GetDataAddress(oper.label->GetStrValue(), 0)) + oper.value : oper.value;
+}
+
+//the operand in a register, the temporary one given if it is not in a register yet
+int BytecodeCompiler::Reg(const IrOperand& oper, int temp)
+{
+   if (oper.IsReg()) {
+      return oper.value;
+   }
+   if (oper.kind == ioFrame) {
+      Emit(bcLea, temps[temp], oper.value);
+   } else {
+      Emit(bcMovI, temps[temp], GetConst(oper));
+   }
+   return temps[temp];
+}
+
+//the immediate form of an operation follows the one taking registers
+void BytecodeCompiler::CompileBinary(BcOpCode op, const IrInstr& instr)
+{
+   if (IsConst(instr.b)) {
+      Emit(BcOpCode(op + 1), instr.dst.value, Reg(instr.a, 0), GetConst(instr.b));
+   } else {
+      Emit(op, instr.dst.value, Reg(instr.a, 0), Reg(instr.b, 1));
+   }
+}
+
+void BytecodeCompiler::CompileLoad(const IrInstr& instr)
+{
+   switch (instr.a.kind) {
+      case ioFrame:
+         Emit(bcLoadF, instr.dst.value, instr.a.value + instr.offset);
+         break;
+      case ioReg:
+         Emit(bcLoadR, instr.dst.value, instr.a.value, instr.offset);
+         break;
+      default:
+         Emit(bcLoadA, instr.dst.value, GetConst(instr.a) + instr.offset);
+   }
+}
+
+void BytecodeCompiler::CompileStore(const IrInstr& instr)
+{
+   bool isConst = IsConst(instr.b);
+   int value = isConst ? GetConst(instr.b) : Reg(instr.b, 1);
+   switch (instr.a.kind) {
+      case ioFrame:
+         Emit(isConst ? bcStoreFI : bcStoreF, instr.a.value + instr.offset, value);
+         break;
+      case ioReg:
+         Emit(isConst ? bcStoreRI : bcStoreR, instr.a.value, value, instr.offset);
+         break;
+      default:
+         Emit(isConst ? bcStoreAI : bcStoreA, GetConst(instr.a) + instr.offset, value);
+   }
+}
+
+//a comparison only used by the branch after it jumps on its own
+void BytecodeCompiler::CompileCompareBranch(const IrInstr& cmp, const IrInstr& instr)
+{
+   BcOpCode op = GetJumpOpCode(cmp.op);
+   IrOperand left = cmp.a, right = cmp.b;
+   if (IsConst(left) && !IsConst(right)) {
+      swap(left, right);
+      op = SwapJump(op);
+   }
+   IrBlock* target = instr.target;
+   IrBlock* alt = instr.alt;
+   if (target == nextBlock) {
+      swap(target, alt);
+      op = InvertJump(op);
+   }
+   int a = Reg(left, 0);
+   if (IsConst(right)) {
+      EmitJump(BcOpCode(op + 1), a, GetConst(right), target);
+   } else {
+      EmitJump(op, a, Reg(right, 1), target);
+   }
+   if (alt != nextBlock) {
+      EmitJump(bcJump, 0, 0, alt);
+   }
+}
+
+void BytecodeCompiler::CompileBranch(const IrInstr& instr)
+{
+   if (instr.a.IsImm()) {
+      IrBlock* target = instr.a.value ? instr.target : instr.alt;
+      if (target != nextBlock) {
+         EmitJump(bcJump, 0, 0, target);
+      }
+   } else if (instr.target == nextBlock) {
+      EmitJump(bcJEqI, Reg(instr.a, 0), 0, instr.alt);
+   } else {
+      EmitJump(bcJNeI, Reg(instr.a, 0), 0, instr.target);
+      if (instr.alt != nextBlock) {
+         EmitJump(bcJump, 0, 0, instr.alt);
+      }
+   }
+}
+
+void BytecodeCompiler::Compile(const IrInstr& instr)
+{
+   switch (instr.op) {
+      case irMov:
+         if (instr.a.kind == ioFrame) {
+            Emit(bcLea, instr.dst.value, instr.a.value);
+         } else if (IsConst(instr.a)) {
+            Emit(bcMovI, instr.dst.value, GetConst(instr.a));
+         } else {
+            Emit(bcMov, instr.dst.value, instr.a.value);
+         }
+         break;
+      case irAdd:
+      case irSub:
+      case irMul:
+      case irDiv:
+      case irMod:
+      case irAnd:
+      case irOr:
+      case irXor:
+      case irShl:
+      case irShr:
+      case irSetEq:
+      case irSetNe:
+      case irSetLt:
+      case irSetLe:
+      case irSetGt:
+      case irSetGe:
+         CompileBinary(GetBinaryOpCode(instr.op), instr);
+         break;
+      case irNeg:
+         Emit(bcNeg, instr.dst.value, Reg(instr.a, 0));
+         break;
+      case irFAdd:
+      case irFSub:
+      case irFMul:
+      case irFDiv:
+      case irFSetEq:
+      case irFSetNe:
+      case irFSetLt:
+      case irFSetLe:
+      case irFSetGt:
+      case irFSetGe:
+         Emit(GetRealOpCode(instr.op), instr.dst.value, Reg(instr.a, 0), Reg(instr.b, 1));
+         break;
+      case irFNeg:
+         Emit(bcFNeg, instr.dst.value, Reg(instr.a, 0));
+         break;
+      case irIntToReal:
+         Emit(bcIntToReal, instr.dst.value, Reg(instr.a, 0));
+         break;
+      case irLoad:
+         CompileLoad(instr);
+         break;
+      case irStore:
+         CompileStore(instr);
+         break;
+      case irCopy:
+         Emit(bcCopy, Reg(instr.a, 0), Reg(instr.b, 1), instr.size);
+         break;
+      case irAlloc:
+         Emit(bcAlloc, instr.size);
+         break;
+      case irPush:
+         if (IsConst(instr.a)) {
+            Emit(bcPushI, GetConst(instr.a));
+         } else {
+            Emit(bcPush, Reg(instr.a, 0));
+         }
+         break;
+      case irPushBlock:
+         Emit(bcPushBlock, Reg(instr.a, 0), instr.size);
+         break;
+      case irCall:
+         Emit(bcCall, functionIndices[instr.callee->GetStrValue()], instr.size, Reg(instr.a, 0));
+         break;
+      case irPop:
+         Emit(bcPop, instr.dst.value);
+         break;
+      case irPopBlock:
+         Emit(bcPopBlock, Reg(instr.a, 0), instr.size);
+         break;
+      case irWriteInt:
+         Emit(bcWriteInt, Reg(instr.a, 0));
+         break;
+      case irWriteReal:
+         Emit(bcWriteReal, Reg(instr.a, 0));
+         break;
+      case irWriteStr:
+         Emit(bcWriteStr, Reg(instr.a, 0));
+         break;
+      case irWriteLn:
+         Emit(bcWriteLn);
+         break;
+      case irCheck:
+         Emit(bcCheck, Reg(instr.a, 0), instr.offset, instr.size);
+         break;
+      case irJump:
+         if (instr.target != nextBlock) {
+            EmitJump(bcJump, 0, 0, instr.target);
+         }
+         break;
+      case irBranch:
+         CompileBranch(instr);
+         break;
+      case irSwitch:
+         {
+            vector<int> table(1, instr.alt->id);
+            for (auto &block : instr.cases) {
+               table.push_back(block->id);
+            }
+            Emit(bcSwitch, Reg(instr.a, 0), instr.offset, program.tables.size());
+            program.tables.push_back(table);
+         }
+         break;
+   }
+}
+
+void BytecodeCompiler::Compile(IrFunction* AFunction)
+{
+   function = AFunction;
+   size_t firstTable = program.tables.size();
+   vector<size_t> entries(function->blockCount, 0);
+   vector<int> useCounts(function->regTypes.size(), 0);
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         for (auto &reg : instr.GetUses()) {
+            useCounts[reg]++;
+         }
+      }
+   }
+   BcFunction result;
+   result.name = function->GetName();
+   result.entry = program.code.size();
+   result.frameSize = function->frameSize;
+   result.regCount = function->regTypes.size() + 2;
+   temps[0] = result.regCount - 2;
+   temps[1] = result.regCount - 1;
+   fixups.clear();
+   for (size_t i = 0; i < function->blocks.size(); i++) {
+      IrBlock* block = function->blocks[i];
+      nextBlock = i + 1 < function->blocks.size() ? function->blocks[i + 1] : nullptr;
+      entries[block->id] = program.code.size();
+      IrInstrs& instrs = block->instrs;
+      for (size_t j = 0; j < instrs.size(); j++) {
+         const IrInstr& instr = instrs[j];
+         if (j + 1 < instrs.size() && instr.op >= irSetEq && instr.op <= irSetGe && instrs[j + 1].op == irBranch
+            && instrs[j + 1].a == instr.dst && useCounts[instr.dst.value] == 1) {
+            CompileCompareBranch(instr, instrs[++j]);
+         } else {
+            Compile(instr);
+         }
+      }
+   }
+   Emit(bcRet);
+   for (auto &fixup : fixups) {
+      int& field = GetField(program.code[fixup.first], fixup.second);
+      field = entries[field];
+   }
+   for (size_t i = firstTable; i < program.tables.size(); i++) {
+      for (auto &target : program.tables[i]) {
+         target = entries[target];
+      }
+   }
+   program.functions.push_back(result);
+}
+
+void BytecodeCompiler::Compile(IrProgram& irProgram)
+{
+   vector<unsigned char> text;
+   encoder.Link(0, 0, unordered_map<string, size_t>(), text, program.data);
+   for (size_t i = 0; i < irProgram.functions.size(); i++) {
+      functionIndices[irProgram.functions[i]->GetName()] = i;
+   }
+   for (auto &irFunction : irProgram.functions) {
+      Compile(irFunction);
+   }
+   program.main = functionIndices["main"];
+}
+
+static inline int32_t Read(const unsigned char* memory, uint32_t addr)
+{
+   int32_t value;
+   memcpy(&value, memory + addr, 4);
+   return value;
+}
+
+static inline void Write(unsigned char* memory, uint32_t addr, int32_t value)
+{
+   memcpy(memory + addr, &value, 4);
+}
+
+static inline float ToReal(int32_t value)
+{
+   float result;
+   memcpy(&result, &value, 4);
+   return result;
+}
+
+static inline int32_t FromReal(float value)
+{
+   int32_t result;
+   memcpy(&result, &value, 4);
+   return result;
+}
+
+//the arithmetic wraps around as the machine's does
+static inline int32_t Wrap(uint32_t value)
+{
+   return int32_t(value);
+}
+
+BytecodeVm::BytecodeVm(string AFname):
+   fname(AFname)
+{}
+
+//the frames are laid out as the native code lays them out, so the frame offsets of the ir hold;
+//a runtime error prints its number as the native runtime does and becomes the exit code
+int BytecodeVm::Run(const BcProgram& program)
+{
+   struct Frame {
+      const BcInstr* ret;
+      size_t regBase;
+      size_t regCount;
+      int argsSize;
+   };
+   vector<BcInstr> code = program.code;
+   vector<unsigned char> memoryImage(memorySize, 0);
+   copy(program.data.begin(), program.data.end(), memoryImage.begin());
+   unsigned char* memory = memoryImage.data();
+   uint32_t stackLimit = program.data.size() + stackReserve;
+   uint32_t memoryLimit = memorySize - 4;
+   vector<int32_t> regFile(1024);
+   vector<Frame> frames;
+   const BcFunction& main = program.functions[program.main];
+   size_t regBase = 0, regCount = main.regCount;
+   regFile.resize(max(regFile.size(), regCount));
+   int32_t* r = regFile.data();
+   uint32_t sp = memorySize - 4, fp = sp;
+   sp -= main.frameSize;
+   int exitCode = 0;
+   const BcInstr* pc = code.data() + main.entry;
+
+#ifdef BC_THREADED
+   static const void* handlers[] = {
+#define BC_HANDLER(name) &&op_##name,
+      BC_OPCODES(BC_HANDLER)
+#undef BC_HANDLER
+   };
+   for (auto &instr : code) {
+      instr.handler = handlers[instr.op];
+   }
+#define OP(name) op_##name:
+#define DISPATCH() goto *pc->handler
+   DISPATCH();
+   {
+#else
+#define OP(name) case bc##name:
+#define DISPATCH() goto dispatch
+dispatch:
+   switch (pc->op) {
+#endif
+#define NEXT() pc++; DISPATCH()
+#define BINARY(name, expr) \
+   OP(name) { int32_t x = r[pc->b], y = r[pc->c]; r[pc->a] = (expr); } NEXT(); \
+   OP(name##I) { int32_t x = r[pc->b], y = pc->c; r[pc->a] = (expr); } NEXT();
+//idiv faults on a zero divisor and on the quotient of INT32_MIN by -1 which does not fit
+#define DIVISION(name, expr) \
+   OP(name) { \
+      int32_t x = r[pc->b], y = r[pc->c]; \
+      if (y == 0) goto division_error; \
+      if (y == -1 && x == INT32_MIN) goto overflow_error; \
+      r[pc->a] = (expr); \
+   } NEXT(); \
+   OP(name##I) { \
+      int32_t x = r[pc->b], y = pc->c; \
+      if (y == 0) goto division_error; \
+      if (y == -1 && x == INT32_MIN) goto overflow_error; \
+      r[pc->a] = (expr); \
+   } NEXT();
+#define REAL(name, expr) \
+   OP(name) { float x = ToReal(r[pc->b]), y = ToReal(r[pc->c]); r[pc->a] = (expr); } NEXT();
+#define JUMP(name, cond) \
+   OP(name) { int32_t x = r[pc->a], y = r[pc->b]; if (cond) { pc = code.data() + pc->c; DISPATCH(); } } NEXT(); \
+   OP(name##I) { int32_t x = r[pc->a], y = pc->b; if (cond) { pc = code.data() + pc->c; DISPATCH(); } } NEXT();
+
+      OP(Mov) r[pc->a] = r[pc->b]; NEXT();
+      OP(MovI) r[pc->a] = pc->b; NEXT();
+      OP(Lea) r[pc->a] = fp + pc->b; NEXT();
+      BINARY(Add, Wrap(uint32_t(x) + uint32_t(y)))
+      BINARY(Sub, Wrap(uint32_t(x) - uint32_t(y)))
+      BINARY(Mul, Wrap(uint32_t(x) * uint32_t(y)))
+      DIVISION(Div, y == -1 ? Wrap(0 - uint32_t(x)) : x / y)
+      DIVISION(Mod, y == -1 ? 0 : x % y)
+      BINARY(And, x & y)
+      BINARY(Or, x | y)
+      BINARY(Xor, x ^ y)
+      BINARY(Shl, Wrap(uint32_t(x) << (y & 31)))
+      BINARY(Shr, Wrap(uint32_t(x) >> (y & 31)))
+      OP(Neg) r[pc->a] = Wrap(0 - uint32_t(r[pc->b])); NEXT();
+      BINARY(SetEq, x == y)
+      BINARY(SetNe, x != y)
+      BINARY(SetLt, x < y)
+      BINARY(SetLe, x <= y)
+      BINARY(SetGt, x > y)
+      BINARY(SetGe, x >= y)
+      REAL(FAdd, FromReal(x + y))
+      REAL(FSub, FromReal(x - y))
+      REAL(FMul, FromReal(x * y))
+      REAL(FDiv, FromReal(x / y))
+      OP(FNeg) r[pc->a] = FromReal(-ToReal(r[pc->b])); NEXT();
+      REAL(FSetEq, x == y)
+      REAL(FSetNe, x != y)
+      REAL(FSetLt, x < y)
+      REAL(FSetLe, x <= y)
+      REAL(FSetGt, x > y)
+      REAL(FSetGe, x >= y)
+      OP(IntToReal) r[pc->a] = FromReal(float(r[pc->b])); NEXT();
+      OP(LoadR)
+         {
+            uint32_t addr = r[pc->b] + pc->c;
+            if (addr > memoryLimit) goto memory_error;
+            r[pc->a] = Read(memory, addr);
+         }
+         NEXT();
+      OP(LoadA) r[pc->a] = Read(memory, pc->b); NEXT();
+      OP(LoadF) r[pc->a] = Read(memory, fp + pc->b); NEXT();
+      OP(StoreR)
+         {
+            uint32_t addr = r[pc->a] + pc->c;
+            if (addr > memoryLimit) goto memory_error;
+            Write(memory, addr, r[pc->b]);
+         }
+         NEXT();
+      OP(StoreRI)
+         {
+            uint32_t addr = r[pc->a] + pc->c;
+            if (addr > memoryLimit) goto memory_error;
+            Write(memory, addr, pc->b);
+         }
+         NEXT();
+      OP(StoreA) Write(memory, pc->a, r[pc->b]); NEXT();
+      OP(StoreAI) Write(memory, pc->a, pc->b); NEXT();
+      OP(StoreF) Write(memory, fp + pc->a, r[pc->b]); NEXT();
+      OP(StoreFI) Write(memory, fp + pc->a, pc->b); NEXT();
+      OP(Copy)
+         {
+            uint32_t dst = r[pc->a], src = r[pc->b], size = (pc->c + 3) / 4 * 4;
+            if (dst > memorySize - size || src > memorySize - size) goto memory_error;
+            memmove(memory + dst, memory + src, size);
+         }
+         NEXT();
+      OP(Alloc) sp -= pc->a; NEXT();
+      OP(Push) sp -= 4; Write(memory, sp, r[pc->a]); NEXT();
+      OP(PushI) sp -= 4; Write(memory, sp, pc->a); NEXT();
+      OP(PushBlock)
+         {
+            uint32_t src = r[pc->a], size = (pc->b + 3) / 4 * 4;
+            if (src > memorySize - size) goto memory_error;
+            sp -= size;
+            memmove(memory + sp, memory + src, size);
+         }
+         NEXT();
+      OP(Call)
+         {
+            const BcFunction& callee = program.functions[pc->a];
+            if (sp < stackLimit + 12 + callee.frameSize) goto stack_error;
+            Frame frame = { pc + 1, regBase, regCount, pc->b };
+            frames.push_back(frame);
+            Write(memory, sp - 4, r[pc->c]);
+            Write(memory, sp - 8, 0);
+            Write(memory, sp - 12, fp);
+            sp -= 12;
+            fp = sp;
+            sp -= callee.frameSize;
+            regBase += regCount;
+            regCount = callee.regCount;
+            if (regFile.size() < regBase + regCount) {
+               regFile.resize(2 * (regBase + regCount));
+            }
+            r = regFile.data() + regBase;
+            pc = code.data() + callee.entry;
+         }
+         DISPATCH();
+      OP(Pop) r[pc->a] = Read(memory, sp); sp += 4; NEXT();
+      OP(PopBlock)
+         {
+            uint32_t dst = r[pc->a], size = (pc->b + 3) / 4 * 4;
+            if (dst > memorySize - size) goto memory_error;
+            memmove(memory + dst, memory + sp, size);
+            sp += size;
+         }
+         NEXT();
+      OP(Ret)
+         {
+            if (frames.empty()) goto halt;
+            Frame frame = frames.back();
+            frames.pop_back();
+            sp = fp;
+            fp = Read(memory, sp);
+            sp += 12 + frame.argsSize;
+            regBase = frame.regBase;
+            regCount = frame.regCount;
+            r = regFile.data() + regBase;
+            pc = frame.ret;
+         }
+         DISPATCH();
+      OP(WriteInt) printf("%d", r[pc->a]); NEXT();
+      OP(WriteReal) printf("% 0.14E", double(ToReal(r[pc->a]))); NEXT();
+      OP(WriteStr) fputs((const char*)memory + uint32_t(r[pc->a]), stdout); NEXT();
+      OP(WriteLn) putchar('\n'); NEXT();
+      OP(Check) if (uint32_t(r[pc->a] - pc->b) > uint32_t(pc->c)) goto range_error; NEXT();
+      OP(Jump) pc = code.data() + pc->a; DISPATCH();
+      OP(Switch)
+         {
+            const vector<int>& table = program.tables[pc->c];
+            uint32_t index = uint32_t(r[pc->a] - pc->b) + 1;
+            pc = code.data() + table[index < table.size() ? index : 0];
+         }
+         DISPATCH();
+      JUMP(JEq, x == y)
+      JUMP(JNe, x != y)
+      JUMP(JLt, x < y)
+      JUMP(JLe, x <= y)
+      JUMP(JGt, x > y)
+      JUMP(JGe, x >= y)
+#ifndef BC_THREADED
+      default:
+         goto halt;
+#endif
+   }
+#undef OP
+#undef DISPATCH
+#undef NEXT
+#undef BINARY
+#undef DIVISION
+#undef REAL
+#undef JUMP
+
+division_error:
+   exitCode = 200;
+   goto runtime_error;
+range_error:
+   exitCode = 201;
+   goto runtime_error;
+overflow_error:
+   exitCode = 215;
+   goto runtime_error;
+stack_error:
+   exitCode = 202;
+   goto runtime_error;
+memory_error:
+   exitCode = 216;
+runtime_error:
+   printf("Runtime error %d\n", exitCode);
+halt:
+   fflush(stdout);
+   return exitCode;
+}
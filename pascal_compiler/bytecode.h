@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "ir.h"
+#include "asm_encoder.h"
+
+using namespace std;
+
+//the suffix tells the kind of the operands: R a register, I an immediate, A an absolute
+//address, F an offset from the frame; a compare and jump falls through when it does not hold
+#define BC_OPCODES(X) \
+   X(Mov) X(MovI) X(Lea) \
+   X(Add) X(AddI) X(Sub) X(SubI) X(Mul) X(MulI) X(Div) X(DivI) X(Mod) X(ModI) \
+   X(And) X(AndI) X(Or) X(OrI) X(Xor) X(XorI) X(Shl) X(ShlI) X(Shr) X(ShrI) X(Neg) \
+   X(SetEq) X(SetEqI) X(SetNe) X(SetNeI) X(SetLt) X(SetLtI) \
+   X(SetLe) X(SetLeI) X(SetGt) X(SetGtI) X(SetGe) X(SetGeI) \
+   X(FAdd) X(FSub) X(FMul) X(FDiv) X(FNeg) \
+   X(FSetEq) X(FSetNe) X(FSetLt) X(FSetLe) X(FSetGt) X(FSetGe) X(IntToReal) \
+   X(LoadR) X(LoadA) X(LoadF) \
+   X(StoreR) X(StoreRI) X(StoreA) X(StoreAI) X(StoreF) X(StoreFI) \
+   X(Copy) X(Alloc) X(Push) X(PushI) X(PushBlock) X(Call) X(Pop) X(PopBlock) X(Ret) \
+   X(WriteInt) X(WriteReal) X(WriteStr) X(WriteLn) X(Check) \
+   X(Jump) X(Switch) \
+   X(JEq) X(JEqI) X(JNe) X(JNeI) X(JLt) X(JLtI) X(JLe) X(JLeI) X(JGt) X(JGtI) X(JGe) X(JGeI)
+
+enum BcOpCode {
+#define BC_ENUM(name) bc##name,
+   BC_OPCODES(BC_ENUM)
+#undef BC_ENUM
+   bcCount
+};
+
+//the interpreter turns the opcodes into the addresses of their handlers before it starts
+struct BcInstr {
+   union {
+      int op;
+      const void* handler;
+   };
+   int a, b, c;
+};
+
+struct BcFunction {
+   string name;
+   size_t entry;
+   size_t frameSize;
+   size_t regCount;
+};
+
+//the data lies at address 0 as the encoder lays it out, the stack grows down from the end of memory
+struct BcProgram {
+   vector<BcInstr> code;
+   vector<BcFunction> functions;
+   vector<vector<int>> tables;
+   vector<unsigned char> data;
+   size_t main;
+};
+
+//register based bytecode for the optimized ir: the registers of a function are its ir
+//registers and two more for the operands the instructions can only take in a register
+class BytecodeCompiler {
+   BcProgram& program;
+   AsmEncoder& encoder;
+   unordered_map<string, size_t> functionIndices;
+   vector<pair<size_t, int>> fixups;
+   IrFunction* function;
+   IrBlock* nextBlock;
+   int temps[2];
+
+   void Emit(BcOpCode, int = 0, int = 0, int = 0);
+   void EmitJump(BcOpCode, int, int, IrBlock*);
+   int GetConst(const IrOperand&);
+   int Reg(const IrOperand&, int);
+   void CompileBinary(BcOpCode, const IrInstr&);
+   void CompileLoad(const IrInstr&);
+   void CompileStore(const IrInstr&);
+   void CompileCompareBranch(const IrInstr&, const IrInstr&);
+   void CompileBranch(const IrInstr&);
+   void Compile(const IrInstr&);
+   void Compile(IrFunction*);
+public:
+   BytecodeCompiler(BcProgram&, AsmEncoder&);
+   void Compile(IrProgram&);
+};
+
+class BytecodeVm {
+   string fname;
+public:
+   BytecodeVm(string);
+   int Run(const BcProgram&);
+};
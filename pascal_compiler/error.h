@@ -139,4 +139,20 @@ public:
    string fname;
    IllegalTypeConversionException(string&, int);
    string getMessage() const;
+};
+
+class EncodeException {
+   string instr;
+public:
+   string fname;
+   EncodeException(string&, string);
+   string getMessage() const;
+};
+
+class JitException {
+   string reason;
+public:
+   string fname;
+   JitException(string&, string);
+   string getMessage() const;
 };
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include "instruction_scheduling.h"
+
+InstructionScheduler::InstructionScheduler(AsmCode& AAsmCode):
+   asmCode(AAsmCode)
+{
+   fill(versions, versions + SCHED_FLAGS, 0);
+}
+
+//cycles until the result of the command can be used, a load from memory adds to it
+int InstructionScheduler::GetLatency(OpCode op)
+{
+   switch (op) {
+      case IMUL:
+      case MUL:
+      case FADDP:
+      case FSUBP:
+         return 3;
+      case FMULP:
+         return 5;
+      case IDIV:
+      case DIV:
+      case FDIVP:
+      case FDIVRP:
+         return 20;
+      default:
+         return 1;
+   }
+}
+
+static unsigned GetRegisterMask(Register reg)
+{
+   switch (reg) {
+      case AX:
+      case AL:
+         return 1 << EAX;
+      case CL:
+         return 1 << ECX;
+      case ST:
+      case ST1:
+         return 1 << SCHED_FPU;
+      default:
+         return 1 << reg;
+   }
+}
+
+static unsigned GetAddressMask(AsmMemory* memory)
+{
+   unsigned mask = 0;
+   if (TryToCastOperand<AsmRegister>(memory->arg)) {
+      mask |= GetRegisterMask(CastOperand<AsmRegister>(memory->arg)->GetRegister());
+   }
+   if (memory->index != nullptr) {
+      mask |= GetRegisterMask(memory->index->GetRegister());
+   }
+   return mask;
+}
+
+SchedMemory InstructionScheduler::GetMemory(AsmMemory* memory) const
+{
+   SchedMemory result = {"", -1, 0, memory->index != nullptr, memory->GetOffset(),
+      memory->GetSizeType() == szQWORD ? 8 : 4};
+   if (TryToCastOperand<AsmRegister>(memory->arg)) {
+      Register reg = CastOperand<AsmRegister>(memory->arg)->GetRegister();
+      result.base = reg;
+      result.version = versions[reg];
+   } else if (TryToCastOperand<AsmStrImmediate>(memory->arg)) {
+      result.label = CastOperand<AsmStrImmediate>(memory->arg)->GetStrValue();
+   } else {
+      result.base = -2;
+   }
+   return result;
+}
+
+SchedMemory InstructionScheduler::GetStackSlot(int offset) const
+{
+   return {"", ESP, versions[ESP], false, offset, 4};
+}
+
+//globals are told apart by their labels and from the frame, addresses off the same value of a
+//register by their displacements; anything else may be the same place
+bool InstructionScheduler::MayAlias(const SchedMemory& a, const SchedMemory& b)
+{
+   bool isGlobalA = a.base == -1 && !a.label.empty();
+   bool isGlobalB = b.base == -1 && !b.label.empty();
+   if (isGlobalA && isGlobalB && a.label != b.label) {
+      return false;
+   }
+   if ((isGlobalA && (b.base == EBP || b.base == ESP)) || (isGlobalB && (a.base == EBP || a.base == ESP))) {
+      return false;
+   }
+   bool isSameBase = a.base == b.base && a.label == b.label && ((a.base >= 0 && a.version == b.version) || isGlobalA);
+   if (!isSameBase || a.hasIndex || b.hasIndex) {
+      return true;
+   }
+   return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+void InstructionScheduler::AddOperand(SchedNode& node, AsmOperand* operand, bool isRead, bool isWritten)
+{
+   if (operand == nullptr) {
+      return;
+   }
+   if (TryToCastOperand<AsmRegister>(operand)) {
+      Register reg = CastOperand<AsmRegister>(operand)->GetRegister();
+      //a write to a part of a register keeps the rest of it
+      if (isRead || reg == AX || reg == AL || reg == CL) {
+         node.reads |= GetRegisterMask(reg);
+      }
+      if (isWritten) {
+         node.writes |= GetRegisterMask(reg);
+      }
+   } else if (TryToCastOperand<AsmMemory>(operand)) {
+      AsmMemory* memory = CastOperand<AsmMemory>(operand);
+      node.reads |= GetAddressMask(memory);
+      if (*node.cmd == LEA) {
+         return;
+      }
+      if (isRead) {
+         node.loads.push_back(GetMemory(memory));
+         node.latency += SCHED_LOAD_LATENCY;
+      }
+      if (isWritten) {
+         node.stores.push_back(GetMemory(memory));
+      }
+   }
+}
+
+//the registers, the flags and the memory the command reads and writes, false for the commands
+//which end a run
+bool InstructionScheduler::Describe(Command cmd, SchedNode& node)
+{
+   OpCode op = cmd->GetOpCode();
+   node.cmd = cmd;
+   node.reads = node.writes = 0;
+   node.latency = GetLatency(op);
+   node.priority = node.earliest = 0;
+   node.predCount = 0;
+   bool isRead = true, isWritten = true;
+   const unsigned flags = 1 << SCHED_FLAGS, fpu = 1 << SCHED_FPU;
+   const unsigned eax = 1 << EAX, edx = 1 << EDX, esp = 1 << ESP;
+   switch (op) {
+      case MOV:
+      case MOVZX:
+      case MOVZB:
+      case LEA:
+         isRead = false;
+         break;
+      case ADD:
+      case SUB:
+      case AND:
+      case OR:
+      case XOR:
+      case NEG:
+      case SAR:
+      case SAL:
+      case SHL:
+      case SHR:
+         node.writes |= flags;
+         break;
+      case INC:
+      case DEC:
+      case RCL:
+      case RCR:
+         node.reads |= flags;
+         node.writes |= flags;
+         break;
+      case NOT:
+         break;
+      case CMP:
+      case TEST:
+         isWritten = false;
+         node.writes |= flags;
+         break;
+      case SETA:
+      case SETAE:
+      case SETB:
+      case SETBE:
+      case SETG:
+      case SETGE:
+      case SETL:
+      case SETLE:
+      case SETE:
+      case SETNE:
+         isRead = false;
+         node.reads |= flags;
+         break;
+      case IMUL:
+         if (cmd->arg2 == nullptr) {
+            isWritten = false;
+            node.reads |= eax;
+            node.writes |= eax | edx;
+         }
+         node.writes |= flags;
+         break;
+      case MUL:
+         isWritten = false;
+         node.reads |= eax;
+         node.writes |= eax | edx | flags;
+         break;
+      case IDIV:
+      case DIV:
+         isWritten = false;
+         node.reads |= eax | edx;
+         node.writes |= eax | edx | flags;
+         break;
+      case CDQ:
+         node.reads |= eax;
+         node.writes |= edx;
+         break;
+      case SAHF:
+         node.reads |= eax;
+         node.writes |= flags;
+         break;
+      case PUSH:
+         isWritten = false;
+         node.reads |= esp;
+         node.writes |= esp;
+         node.stores.push_back(GetStackSlot(-4));
+         break;
+      case POP:
+         isRead = false;
+         node.reads |= esp;
+         node.writes |= esp;
+         node.loads.push_back(GetStackSlot(0));
+         node.latency += SCHED_LOAD_LATENCY;
+         break;
+      case FLD:
+      case FILD:
+         isWritten = false;
+         node.reads |= fpu;
+         node.writes |= fpu;
+         break;
+      case FSTP:
+         isRead = false;
+         node.reads |= fpu;
+         node.writes |= fpu;
+         break;
+      case FCHS:
+      case FADDP:
+      case FSUBP:
+      case FMULP:
+      case FDIVP:
+      case FDIVRP:
+      case FXCH:
+      case FCOMPP:
+         node.reads |= fpu;
+         node.writes |= fpu;
+         break;
+      case FNSTSW:
+         isRead = false;
+         node.reads |= fpu;
+         break;
+      default:
+         return false;
+   }
+   AddOperand(node, cmd->arg1, isRead, isWritten);
+   AddOperand(node, cmd->arg2, true, false);
+   //the frame is not to be touched below esp, so the commands which allocate or free it stay
+   if ((node.writes & esp) != 0 && op != PUSH && op != POP) {
+      return false;
+   }
+   //pop addresses its operand off esp as it is after the command
+   for (auto& memory : node.stores) {
+      if (op == POP && memory.base == ESP) {
+         memory.base = -2;
+      }
+   }
+   for (int reg = 0; reg < SCHED_FLAGS; reg++) {
+      versions[reg] += (node.writes >> reg) & 1;
+   }
+   return true;
+}
+
+//the later command waits for the result of the earlier one or, when it only overwrites what the
+//earlier one uses, just goes after it
+void InstructionScheduler::AddDependency(vector<SchedNode>& nodes, size_t from, size_t to)
+{
+   SchedNode& a = nodes[from];
+   SchedNode& b = nodes[to];
+   int latency = -1;
+   if ((a.writes & b.reads) != 0) {
+      latency = a.latency;
+   } else if ((a.reads & b.writes) != 0 || (a.writes & b.writes) != 0) {
+      latency = 0;
+   }
+   for (auto& store : a.stores) {
+      for (auto& load : b.loads) {
+         if (MayAlias(store, load)) {
+            latency = max(latency, a.latency);
+         }
+      }
+      for (auto& other : b.stores) {
+         if (MayAlias(store, other)) {
+            latency = max(latency, 0);
+         }
+      }
+   }
+   for (auto& load : a.loads) {
+      for (auto& store : b.stores) {
+         if (MayAlias(load, store)) {
+            latency = max(latency, 0);
+         }
+      }
+   }
+   if (latency >= 0) {
+      a.succs.push_back(make_pair(to, latency));
+      b.predCount++;
+   }
+}
+
+void InstructionScheduler::ScheduleRun(vector<SchedNode>& nodes, size_t first)
+{
+   size_t count = nodes.size();
+   for (size_t to = 1; to < count; to++) {
+      for (size_t from = 0; from < to; from++) {
+         AddDependency(nodes, from, to);
+      }
+   }
+   for (size_t i = count; i-- > 0;) {
+      nodes[i].priority = nodes[i].latency;
+      for (auto& succ : nodes[i].succs) {
+         nodes[i].priority = max(nodes[i].priority, succ.second + nodes[succ.first].priority);
+      }
+   }
+   //one command a cycle: the one which can start first, of those the one with the longest path
+   //to the end of the run and then the one which was first
+   vector<bool> isDone(count, false);
+   int cycle = 0;
+   for (size_t k = 0; k < count; k++) {
+      size_t best = count;
+      for (size_t i = 0; i < count; i++) {
+         if (isDone[i] || nodes[i].predCount != 0) {
+            continue;
+         }
+         if (best == count) {
+            best = i;
+            continue;
+         }
+         int start = max(nodes[i].earliest, cycle);
+         int bestStart = max(nodes[best].earliest, cycle);
+         if (start < bestStart || (start == bestStart && nodes[i].priority > nodes[best].priority)) {
+            best = i;
+         }
+      }
+      int start = max(nodes[best].earliest, cycle);
+      cycle = start + 1;
+      isDone[best] = true;
+      for (auto& succ : nodes[best].succs) {
+         nodes[succ.first].earliest = max(nodes[succ.first].earliest, start + succ.second);
+         nodes[succ.first].predCount--;
+      }
+      asmCode.commands[first + k] = nodes[best].cmd;
+   }
+}
+
+void InstructionScheduler::Schedule()
+{
+   Commands& commands = asmCode.commands;
+   vector<SchedNode> run;
+   size_t first = 0;
+   for (size_t i = 0; i <= commands.size(); i++) {
+      SchedNode node;
+      if (i < commands.size() && Describe(commands[i], node)) {
+         run.push_back(node);
+         continue;
+      }
+      if (run.size() > 1) {
+         ScheduleRun(run, first);
+      }
+      run.clear();
+      fill(versions, versions + SCHED_FLAGS, 0);
+      first = i + 1;
+   }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "CodeGen.h"
+
+using namespace std;
+
+//the resources a command reads and writes beside memory: eax .. edi by their numbers, the flags and
+//the x87 stack as a whole
+#define SCHED_FLAGS 8
+#define SCHED_FPU 9
+#define SCHED_LOAD_LATENCY 3
+
+//label + base + disp of a memory operand; the base is kept with the number of writes to it before
+//the command so that two addresses off the same value of a register can be told apart
+struct SchedMemory {
+   string label;
+   int base, version;
+   bool hasIndex;
+   int offset, size;
+};
+
+struct SchedNode {
+   Command cmd;
+   unsigned reads, writes;
+   vector<SchedMemory> loads, stores;
+   int latency, priority, earliest;
+   size_t predCount;
+   vector<pair<size_t, int>> succs;
+};
+
+//list scheduling of the runs of commands between labels, jumps, calls and changes of the frame:
+//of the commands whose operands are ready the one on the longest path to the end of the run goes
+//first, so that loads, imul and idiv are followed by commands which do not wait for their results
+class InstructionScheduler {
+   AsmCode& asmCode;
+   int versions[SCHED_FLAGS];
+
+   static bool MayAlias(const SchedMemory&, const SchedMemory&);
+   static int GetLatency(OpCode);
+   SchedMemory GetMemory(AsmMemory*) const;
+   SchedMemory GetStackSlot(int) const;
+   void AddOperand(SchedNode&, AsmOperand*, bool, bool);
+   bool Describe(Command, SchedNode&);
+   static void AddDependency(vector<SchedNode>&, size_t, size_t);
+   void ScheduleRun(vector<SchedNode>&, size_t);
+public:
+   InstructionScheduler(AsmCode&);
+   void Schedule();
+};
@@ -0,0 +1,730 @@
+#include <algorithm>
+#include <climits>
+#include "instruction_selection.h"
+
+#define SEL_INFINITY (INT_MAX / 4)
+
+//eax, ecx and edx are left to the instructions which need them: division, shift and setcc
+static const Register pool[SEL_POOL_SIZE] = {EBX, ESI, EDI};
+
+//the cost counts instructions, imul as three and idiv as eight of them; a chain rule turns
+//the form of the same node given as left into the result one
+static const SelRule rules[] = {
+   {snImm,    soConst, snNone,   snNone,  scNone,        0},
+   {snMem,    soVar,   snNone,   snNone,  scDirect,      0},
+   {snMem,    soVar,   snNone,   snNone,  scNone,        2},
+   {snReg,    soOther, snNone,   snNone,  scNone,        2},
+   {snMem,    soIdx,   snImm,    snNone,  scInRange,     0},
+   {snMem,    soIdx,   snOffset, snNone,  scUnchecked,   0},
+   {snMem,    soIdx,   snReg,    snNone,  scChecked,     3},
+   {snReg,    soChain, snImm,    snNone,  scNone,        1},
+   {snReg,    soChain, snMem,    snNone,  scNone,        1},
+   {snReg,    soChain, snOffset, snNone,  scNone,        1},
+   {snReg,    soChain, snAddr,   snNone,  scNone,        1},
+   {snOffset, soChain, snReg,    snNone,  scNone,        0},
+   {snAddr,   soChain, snOffset, snNone,  scNone,        0},
+   {snImm,    soAdd,   snImm,    snImm,   scNone,        0},
+   {snOffset, soAdd,   snOffset, snImm,   scNone,        0},
+   {snAddr,   soAdd,   snAddr,   snImm,   scNone,        0},
+   {snAddr,   soAdd,   snReg,    snReg,   scNone,        0},
+   {snAddr,   soAdd,   snReg,    snIndex, scNone,        0},
+   {snReg,    soAdd,   snReg,    snImm,   scNone,        1},
+   {snReg,    soAdd,   snReg,    snMem,   scNone,        1},
+   {snReg,    soAdd,   snReg,    snReg,   scNone,        1},
+   {snImm,    soSub,   snImm,    snImm,   scNone,        0},
+   {snOffset, soSub,   snOffset, snImm,   scNone,        0},
+   {snAddr,   soSub,   snAddr,   snImm,   scNone,        0},
+   {snReg,    soSub,   snReg,    snImm,   scNone,        1},
+   {snReg,    soSub,   snReg,    snMem,   scNone,        1},
+   {snReg,    soSub,   snReg,    snReg,   scNone,        1},
+   {snImm,    soMul,   snImm,    snImm,   scNone,        0},
+   {snIndex,  soMul,   snReg,    snImm,   scScale,       0},
+   {snAddr,   soMul,   snReg,    snImm,   scLea,         0},
+   {snReg,    soMul,   snReg,    snImm,   scPow2,        1},
+   {snReg,    soMul,   snReg,    snImm,   scNone,        3},
+   {snReg,    soMul,   snReg,    snMem,   scNone,        3},
+   {snReg,    soMul,   snReg,    snReg,   scNone,        3},
+   {snReg,    soDiv,   snReg,    snImm,   scNone,       12},
+   {snReg,    soDiv,   snReg,    snMem,   scNone,       11},
+   {snReg,    soDiv,   snReg,    snReg,   scNone,       11},
+   {snReg,    soMod,   snReg,    snImm,   scNone,       12},
+   {snReg,    soMod,   snReg,    snMem,   scNone,       11},
+   {snReg,    soMod,   snReg,    snReg,   scNone,       11},
+   {snReg,    soAnd,   snReg,    snImm,   scNone,        1},
+   {snReg,    soAnd,   snReg,    snMem,   scNone,        1},
+   {snReg,    soAnd,   snReg,    snReg,   scNone,        1},
+   {snReg,    soOr,    snReg,    snImm,   scNone,        1},
+   {snReg,    soOr,    snReg,    snMem,   scNone,        1},
+   {snReg,    soOr,    snReg,    snReg,   scNone,        1},
+   {snReg,    soXor,   snReg,    snImm,   scNone,        1},
+   {snReg,    soXor,   snReg,    snMem,   scNone,        1},
+   {snReg,    soXor,   snReg,    snReg,   scNone,        1},
+   {snIndex,  soShl,   snReg,    snImm,   scScaleShift,  0},
+   {snReg,    soShl,   snReg,    snImm,   scShiftCount,  1},
+   {snReg,    soShl,   snReg,    snReg,   scNone,        2},
+   {snReg,    soShr,   snReg,    snImm,   scShiftCount,  1},
+   {snReg,    soShr,   snReg,    snReg,   scNone,        2},
+   {snImm,    soNeg,   snImm,    snNone,  scNone,        0},
+   {snReg,    soNeg,   snReg,    snNone,  scNone,        1},
+   {snReg,    soNot,   snReg,    snNone,  scNone,        3},
+   {snImm,    soPlus,  snImm,    snNone,  scNone,        0},
+   {snMem,    soPlus,  snMem,    snNone,  scNone,        0},
+   {snReg,    soPlus,  snReg,    snNone,  scNone,        0},
+   {snReg,    soRel,   snReg,    snImm,   scNone,        3},
+   {snReg,    soRel,   snReg,    snMem,   scNone,        3},
+   {snReg,    soRel,   snReg,    snReg,   scNone,        3}
+};
+
+static const int ruleCount = sizeof(rules) / sizeof(rules[0]);
+
+static bool IsInteger(NodeExpr* node)
+{
+   Symbol* type = node->GetType();
+   return type != nullptr && *type == stTypeInteger;
+}
+
+static bool IsCommutative(SelOp op)
+{
+   return op == soAdd || op == soMul || op == soAnd || op == soOr || op == soXor;
+}
+
+static SymTypeArry* GetArrayType(const NodeArrIdx* node)
+{
+   return dynamic_cast<SymTypeArry*>(node->arrName->GetSymbol()->GetType());
+}
+
+static SelValue GetRegValue(int reg)
+{
+   SelValue result = {nullptr, reg, -1, 1, 0};
+   return result;
+}
+
+static SelValue GetImmValue(int value)
+{
+   SelValue result = {nullptr, -1, -1, 1, value};
+   return result;
+}
+
+static SelValue GetMemoryValue(AsmMemory* memory)
+{
+   SelValue result = GetImmValue(memory->GetOffset());
+   if (TryToCastOperand<AsmRegister>(memory->arg)) {
+      result.base = CastOperand<AsmRegister>(memory->arg)->GetRegister();
+   } else {
+      result.label = CastOperand<AsmStrImmediate>(memory->arg);
+   }
+   return result;
+}
+
+static OpCode GetSetOpCode(int tag)
+{
+   switch (tag) {
+      case Tag::EQ: return SETE;
+      case Tag::NE: return SETNE;
+      case Tag::LT: return SETL;
+      case Tag::LE: return SETLE;
+      case Tag::GT: return SETG;
+      default:      return SETGE;
+   }
+}
+
+static int Wrap(long long value)
+{
+   return int(unsigned(value));
+}
+
+InstructionSelector::InstructionSelector(AsmCode& AAsmCode):
+   asmCode(AAsmCode)
+{
+   fill(isBusy, isBusy + SEL_POOL_SIZE, false);
+}
+
+SelOp InstructionSelector::GetOp(NodeExpr* node)
+{
+   if (*node == ntIntegerNumber) return soConst;
+   if (!IsInteger(node)) return soOther;
+   if (*node == ntVar) {
+      Symbol* symbol = static_cast<NodeVar*>(node)->symbol;
+      return *symbol == stConstInteger ? soConst : symbol->IsVar() ? soVar : soOther;
+   }
+   if (*node == ntArrIdx) {
+      return IsAddressCovered(static_cast<NodeArrIdx*>(node)) ? soIdx : soOther;
+   }
+   if (*node == ntUnaryOp) {
+      if (!IsInteger(static_cast<NodeUnaryOp*>(node)->arg)) return soOther;
+      switch (node->token->tag) {
+         case Tag::NEGATION:    return soNot;
+         case Tag::SUBTRACTION: return soNeg;
+         case Tag::ADDITION:    return soPlus;
+      }
+      return soOther;
+   }
+   if (*node != ntBinaryOp || !IsInteger(static_cast<NodeBinaryOp*>(node)->GetLeft())) return soOther;
+   switch (node->token->tag) {
+      case Tag::ADDITION:       return soAdd;
+      case Tag::SUBTRACTION:    return soSub;
+      case Tag::MULTIPLICATION: return soMul;
+      case Tag::DIV:            return soDiv;
+      case Tag::MOD:            return soMod;
+      case Tag::AND:            return soAnd;
+      case Tag::OR:             return soOr;
+      case Tag::XOR:            return soXor;
+      case Tag::SHL:            return soShl;
+      case Tag::SHR:            return soShr;
+      case Tag::EQ:
+      case Tag::NE:
+      case Tag::LT:
+      case Tag::LE:
+      case Tag::GT:
+      case Tag::GE:             return soRel;
+   }
+   return soOther;
+}
+
+Args InstructionSelector::GetChildren(NodeExpr* node)
+{
+   Args result;
+   switch (GetOp(node)) {
+      case soConst:
+      case soVar:
+      case soOther:
+         break;
+      case soIdx:
+         result.push_back(static_cast<NodeArrIdx*>(node)->args[0]);
+         break;
+      case soNeg:
+      case soNot:
+      case soPlus:
+         result.push_back(static_cast<NodeUnaryOp*>(node)->arg);
+         break;
+      default:
+         result.push_back(static_cast<NodeBinaryOp*>(node)->GetLeft());
+         result.push_back(static_cast<NodeBinaryOp*>(node)->GetRight());
+   }
+   return result;
+}
+
+bool InstructionSelector::IsCovered(NodeExpr* node)
+{
+   return GetOp(node) != soOther;
+}
+
+//a one dimensional array indexed by an integer, the element is loaded when it is an integer
+bool InstructionSelector::IsAddressCovered(const NodeArrIdx* node)
+{
+   return node->args.size() == 1 && *(node->arrName) == ntVar && GetArrayType(node) != nullptr && IsInteger(node->args[0]);
+}
+
+bool InstructionSelector::Fits(int check, const NodeExpr* node, const SelLabel* left, const SelLabel* right)
+{
+   int value = right != nullptr ? right->value : 0;
+   switch (check) {
+      case scDirect:
+         return static_cast<const NodeVar*>(node)->symbol->GenerateMemory(node->depth) != nullptr;
+      case scScale:
+         return value == 1 || value == 2 || value == 4 || value == 8;
+      case scLea:
+         return value == 3 || value == 5 || value == 9;
+      case scPow2:
+         return value > 0 && (value & (value - 1)) == 0;
+      case scScaleShift:
+         return value >= 0 && value <= 3;
+      case scShiftCount:
+         return value >= 0 && value < 32;
+   }
+   if (check == scNone) return true;
+   const NodeArrIdx* idx = static_cast<const NodeArrIdx*>(node);
+   SymTypeArray* bounds = dynamic_cast<SymTypeArray*>(GetArrayType(idx));
+   bool isChecked = idx->isRangeChecked && bounds != nullptr;
+   switch (check) {
+      case scInRange:
+         return !isChecked || (left->value >= bounds->GetLow() && left->value <= bounds->GetHigh());
+      case scUnchecked:
+         return !isChecked;
+      default:
+         return isChecked;
+   }
+}
+
+//the registers are counted in the order the operands are evaluated: base ones kept before both,
+//as the address of an array is
+void InstructionSelector::Derive(SelLabel& label, int index, bool isSwapped, const NodeExpr* node,
+   const SelLabel* first, const SelLabel* second, int extraCost, int baseRegs)
+{
+   const SelRule& rule = rules[index];
+   const SelLabel* left = isSwapped ? second : first;
+   const SelLabel* right = isSwapped ? first : second;
+   SelNonterm firstForm = isSwapped ? rule.right : rule.left;
+   SelNonterm secondForm = isSwapped ? rule.left : rule.right;
+   if (rule.left != snNone && left->cost[rule.left] >= SEL_INFINITY) return;
+   if (rule.right != snNone && right->cost[rule.right] >= SEL_INFINITY) return;
+   if (isSwapped && firstForm == snMem && second->hasSideEffects) return;
+   if (!Fits(rule.check, node, left, right)) return;
+   int cost = rule.cost + extraCost;
+   cost += rule.left != snNone ? left->cost[rule.left] : 0;
+   cost += rule.right != snNone ? right->cost[rule.right] : 0;
+   if (cost >= label.cost[rule.result]) return;
+   int firstNeed = first != nullptr ? first->need[firstForm] : 0;
+   int firstHeld = first != nullptr ? first->held[firstForm] : 0;
+   int secondNeed = second != nullptr ? second->need[secondForm] : 0;
+   int secondHeld = second != nullptr ? second->held[secondForm] : 0;
+   int held = rule.result == snReg ? 1 : rule.result == snImm ? 0 : baseRegs + firstHeld + secondHeld;
+   label.cost[rule.result] = cost;
+   label.rule[rule.result] = index * 2 + isSwapped;
+   label.held[rule.result] = held;
+   label.need[rule.result] = max(max(baseRegs + firstNeed, baseRegs + firstHeld + secondNeed), held);
+}
+
+void InstructionSelector::Label(NodeExpr* node)
+{
+   Args children = GetChildren(node);
+   for (auto &child : children) {
+      Label(child);
+   }
+   SelLabel label;
+   label.op = GetOp(node);
+   label.hasSideEffects = node->HasSideEffects();
+   const SelLabel* first = children.size() > 0 ? &labels[children[0]] : nullptr;
+   const SelLabel* second = children.size() > 1 ? &labels[children[1]] : nullptr;
+   if (label.op == soIdx) {
+      LabelIndex(static_cast<NodeArrIdx*>(node), label);
+   } else {
+      InitLabel(label);
+      for (int i = 0; i < ruleCount; i++) {
+         if (rules[i].op != label.op) continue;
+         Derive(label, i, false, node, first, second, 0, rules[i].op == soVar && rules[i].check != scDirect);
+         if (IsCommutative(label.op)) {
+            Derive(label, i, true, node, first, second, 0, 0);
+         }
+      }
+      CloseLabel(label);
+   }
+   switch (label.op) {
+      case soConst:
+         label.value = *node == ntIntegerNumber ? dynamic_cast<IntegerNumber*>(node->token.get())->value
+            : dynamic_cast<SymConstInteger*>(static_cast<NodeVar*>(node)->symbol)->getValue();
+         break;
+      case soAdd:   label.value = Wrap((long long)first->value + second->value); break;
+      case soSub:   label.value = Wrap((long long)first->value - second->value); break;
+      case soMul:   label.value = Wrap((long long)first->value * second->value); break;
+      case soNeg:   label.value = Wrap(-(long long)first->value); break;
+      case soPlus:  label.value = first->value; break;
+      default:      break;
+   }
+   labels[node] = label;
+}
+
+//the address of the array comes before the index; when it is not a variable of the running
+//subroutine or a global one, it is pushed by GenerateLValue and kept in a register
+void InstructionSelector::LabelIndex(const NodeArrIdx* node, SelLabel& label)
+{
+   const SelLabel* index = &labels[node->args[0]];
+   NodeVar* arrName = static_cast<NodeVar*>(node->arrName);
+   bool isDirect = arrName->symbol->GenerateMemory(arrName->depth) != nullptr;
+   size_t size = GetArrayType(node)->elemType->GetSize();
+   bool isScaled = size == 1 || size == 2 || size == 4 || size == 8;
+   InitLabel(label);
+   for (int i = 0; i < ruleCount; i++) {
+      if (rules[i].op != soIdx) continue;
+      int extraCost = (isDirect ? 0 : 2) + (isScaled || rules[i].left == snImm ? 0 : 3);
+      Derive(label, i, false, node, index, nullptr, extraCost, !isDirect);
+   }
+   CloseLabel(label);
+}
+
+void InstructionSelector::InitLabel(SelLabel& label)
+{
+   label.value = 0;
+   fill(label.cost, label.cost + snCount, SEL_INFINITY);
+   fill(label.rule, label.rule + snCount, -1);
+   fill(label.need, label.need + snCount, 0);
+   fill(label.held, label.held + snCount, 0);
+}
+
+void InstructionSelector::CloseLabel(SelLabel& label)
+{
+   for (bool isChanged = true; isChanged;) {
+      isChanged = false;
+      for (int i = 0; i < ruleCount; i++) {
+         const SelRule& rule = rules[i];
+         if (rule.op != soChain || label.cost[rule.left] + rule.cost >= label.cost[rule.result]) continue;
+         label.cost[rule.result] = label.cost[rule.left] + rule.cost;
+         label.rule[rule.result] = i * 2;
+         label.held[rule.result] = rule.result == snReg ? 1 : label.held[rule.left];
+         label.need[rule.result] = max(label.need[rule.left], label.held[rule.result]);
+         isChanged = true;
+      }
+   }
+}
+
+Register InstructionSelector::Alloc()
+{
+   int i = 0;
+   while (isBusy[i]) i++;
+   isBusy[i] = true;
+   return pool[i];
+}
+
+void InstructionSelector::Free(int reg)
+{
+   for (int i = 0; i < SEL_POOL_SIZE; i++) {
+      isBusy[i] = isBusy[i] && pool[i] != reg;
+   }
+}
+
+void InstructionSelector::Free(const SelValue& value)
+{
+   Free(value.base);
+   Free(value.index);
+}
+
+int InstructionSelector::GetFreeCount() const
+{
+   return int(count(isBusy, isBusy + SEL_POOL_SIZE, false));
+}
+
+//the code of a node left to the other Generate methods may change any register
+vector<Register> InstructionSelector::SaveLive()
+{
+   vector<Register> result;
+   for (int i = 0; i < SEL_POOL_SIZE; i++) {
+      if (!isBusy[i]) continue;
+      asmCode.AddCmd(PUSH, pool[i]);
+      result.push_back(pool[i]);
+   }
+   return result;
+}
+
+//the value goes to a register no saved one is, a push of it just before becomes a move
+Register InstructionSelector::PopSaved(const vector<Register>& saved)
+{
+   Register result = Alloc();
+   Command last = asmCode.commands.back();
+   if (saved.empty() && *last == PUSH) {
+      asmCode.commands.pop_back();
+      if (!TryToCastOperand<AsmRegister>(last->arg1) || CastOperand<AsmRegister>(last->arg1)->GetRegister() != result) {
+         asmCode.AddCmd(MOV, new AsmRegister(result), last->arg1);
+      }
+   } else {
+      asmCode.AddCmd(POP, result);
+   }
+   for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+      asmCode.AddCmd(POP, *it);
+   }
+   return result;
+}
+
+//the registers of the first operand go to the stack while the second one needs them all
+void InstructionSelector::Spill(const SelValue& value, vector<Register>& spilled)
+{
+   for (int reg : {value.base, value.index}) {
+      if (reg < 0 || find(pool, pool + SEL_POOL_SIZE, reg) == pool + SEL_POOL_SIZE) continue;
+      asmCode.AddCmd(PUSH, Register(reg));
+      spilled.push_back(Register(reg));
+      Free(reg);
+   }
+}
+
+void InstructionSelector::Unspill(SelValue& value, const vector<Register>& spilled)
+{
+   SelValue result = value;
+   for (size_t i = spilled.size(); i-- > 0;) {
+      Register reg = Alloc();
+      asmCode.AddCmd(POP, reg);
+      result.base = value.base == spilled[i] ? reg : result.base;
+      result.index = value.index == spilled[i] ? reg : result.index;
+   }
+   value = result;
+}
+
+AsmMemory* InstructionSelector::GetMemory(const SelValue& value, SizeType size) const
+{
+   AsmOperand* base = value.label != nullptr ? static_cast<AsmOperand*>(value.label) : new AsmRegister(Register(value.base));
+   if (value.index < 0) return new AsmMemory(base, value.disp, size);
+   return new AsmMemory(base, Register(value.index), value.scale, value.disp, size);
+}
+
+AsmOperand* InstructionSelector::GetOperand(const SelValue& value, SelNonterm form) const
+{
+   switch (form) {
+      case snReg: return new AsmRegister(Register(value.base));
+      case snImm: return new AsmIntImmediate(value.disp, szNONE);
+      default:    return GetMemory(value, szDWORD);
+   }
+}
+
+SelValue InstructionSelector::ReduceChain(SelNonterm result, SelNonterm form, SelValue value)
+{
+   if (result != snReg) return value;
+   bool isRegister = form != snImm && value.label == nullptr && value.index < 0 && value.disp == 0;
+   if (form == snOffset || form == snAddr) {
+      if (isRegister) return value;
+      AsmMemory* address = GetMemory(value, szNONE);
+      Free(value);
+      Register reg = Alloc();
+      asmCode.AddCmd(LEA, new AsmRegister(reg), address);
+      return GetRegValue(reg);
+   }
+   AsmOperand* source = GetOperand(value, form);
+   Free(value);
+   Register reg = Alloc();
+   asmCode.AddCmd(MOV, new AsmRegister(reg), source);
+   return GetRegValue(reg);
+}
+
+//the operands in the order of the tree, the rule may take them the other way round
+void InstructionSelector::ReduceOperands(NodeExpr* node, int rule, SelValue& left, SelValue& right)
+{
+   Args children = GetChildren(node);
+   bool isSwapped = rule % 2;
+   SelNonterm firstForm = isSwapped ? rules[rule / 2].right : rules[rule / 2].left;
+   SelNonterm secondForm = isSwapped ? rules[rule / 2].left : rules[rule / 2].right;
+   SelValue first = Reduce(children[0], firstForm);
+   SelValue second = GetImmValue(0);
+   if (children.size() > 1) {
+      vector<Register> spilled;
+      if (labels[children[1]].need[secondForm] > GetFreeCount()) {
+         Spill(first, spilled);
+      }
+      second = Reduce(children[1], secondForm);
+      Unspill(first, spilled);
+   }
+   left = isSwapped ? second : first;
+   right = isSwapped ? first : second;
+}
+
+SelValue InstructionSelector::Reduce(NodeExpr* node, SelNonterm form)
+{
+   const SelLabel& label = labels[node];
+   const SelRule& rule = rules[label.rule[form] / 2];
+   if (rule.op == soChain) {
+      return ReduceChain(rule.result, rule.left, Reduce(node, rule.left));
+   }
+   if (rule.result == snImm) {
+      return GetImmValue(label.value);
+   }
+   switch (rule.op) {
+      case soIdx:
+         return ReduceIndex(static_cast<NodeArrIdx*>(node), label, form);
+      case soVar:
+         if (rule.check == scDirect) {
+            return GetMemoryValue(static_cast<NodeVar*>(node)->symbol->GenerateMemory(node->depth));
+         } else {
+            vector<Register> saved = SaveLive();
+            node->GenerateLValue(asmCode);
+            return GetRegValue(PopSaved(saved));
+         }
+      case soOther:
+         {
+            vector<Register> saved = SaveLive();
+            node->Generate(asmCode);
+            return GetRegValue(PopSaved(saved));
+         }
+      default:
+         break;
+   }
+   SelValue left, right;
+   ReduceOperands(node, label.rule[form], left, right);
+   return Emit(node, rule, left, right);
+}
+
+SelValue InstructionSelector::Emit(NodeExpr* node, const SelRule& rule, SelValue left, SelValue right)
+{
+   if (rule.result == snOffset || rule.result == snAddr || rule.result == snIndex) {
+      switch (rule.op) {
+         case soAdd:
+            if (rule.right == snImm) {
+               left.disp = Wrap((long long)left.disp + right.disp);
+            } else {
+               left.index = rule.right == snIndex ? right.index : right.base;
+               left.scale = rule.right == snIndex ? right.scale : 1;
+            }
+            return left;
+         case soSub:
+            left.disp = Wrap((long long)left.disp - right.disp);
+            return left;
+         case soMul:
+            left.index = left.base;
+            left.scale = rule.result == snIndex ? right.disp : right.disp - 1;
+            left.base = rule.result == snIndex ? -1 : left.base;
+            return left;
+         default:
+            left.index = left.base;
+            left.scale = 1 << right.disp;
+            left.base = -1;
+            return left;
+      }
+   }
+   AsmRegister* dest = new AsmRegister(Register(left.base));
+   switch (rule.op) {
+      case soAdd: asmCode.AddCmd(ADD, dest, GetOperand(right, rule.right)); break;
+      case soSub: asmCode.AddCmd(SUB, dest, GetOperand(right, rule.right)); break;
+      case soAnd: asmCode.AddCmd(AND, dest, GetOperand(right, rule.right)); break;
+      case soOr:  asmCode.AddCmd(OR, dest, GetOperand(right, rule.right)); break;
+      case soXor: asmCode.AddCmd(XOR, dest, GetOperand(right, rule.right)); break;
+      case soNeg: asmCode.AddCmd(NEG, dest); break;
+      case soPlus: break;
+      case soMul:
+         if (rule.check == scPow2) {
+            int shift = 0;
+            while ((1 << shift) < right.disp) shift++;
+            asmCode.AddCmd(SHL, dest, new AsmIntImmediate(shift, szNONE));
+         } else {
+            asmCode.AddCmd(IMUL, dest, GetOperand(right, rule.right));
+         }
+         break;
+      case soDiv:
+      case soMod:
+         if (rule.right == snImm) {
+            asmCode.AddCmd(MOV, ECX, right.disp);
+         }
+         asmCode.AddCmd(MOV, EAX, Register(left.base));
+         asmCode.AddCmd(CDQ);
+         asmCode.AddCmd(IDIV, rule.right == snImm ? new AsmRegister(ECX) : GetOperand(right, rule.right));
+         asmCode.AddCmd(MOV, Register(left.base), rule.op == soDiv ? EAX : EDX);
+         break;
+      case soShl:
+      case soShr:
+         if (rule.right == snImm) {
+            asmCode.AddCmd(rule.op == soShl ? SHL : SHR, dest, new AsmIntImmediate(right.disp, szNONE));
+         } else {
+            asmCode.AddCmd(MOV, ECX, Register(right.base));
+            asmCode.AddCmd(rule.op == soShl ? SHL : SHR, Register(left.base), CL);
+         }
+         break;
+      case soNot:
+         asmCode.AddCmd(TEST, Register(left.base), Register(left.base));
+         asmCode.AddCmd(SETE, AL);
+         asmCode.AddCmd(MOVZX, Register(left.base), AL);
+         break;
+      case soRel:
+         asmCode.AddCmd(CMP, dest, GetOperand(right, rule.right));
+         asmCode.AddCmd(GetSetOpCode(node->token->tag), AL);
+         asmCode.AddCmd(MOVZX, Register(left.base), AL);
+         break;
+      default:
+         break;
+   }
+   Free(right);
+   return left;
+}
+
+//the index is checked against the bounds after the lower one is taken away from it, unchecked
+//it is not and the lower bound goes to the displacement
+SelValue InstructionSelector::ReduceIndex(const NodeArrIdx* node, const SelLabel& label, SelNonterm form)
+{
+   const SelRule& rule = rules[label.rule[form] / 2];
+   NodeVar* arrName = static_cast<NodeVar*>(node->arrName);
+   SymTypeArry* type = GetArrayType(node);
+   int size = int(type->elemType->GetSize());
+   AsmMemory* memory = arrName->symbol->GenerateMemory(arrName->depth);
+   SelValue result;
+   if (memory != nullptr) {
+      result = GetMemoryValue(memory);
+   } else {
+      vector<Register> saved = SaveLive();
+      arrName->GenerateLValue(asmCode);
+      result = GetRegValue(PopSaved(saved));
+   }
+   vector<Register> spilled;
+   if (labels[node->args[0]].need[rule.left] > GetFreeCount()) {
+      Spill(result, spilled);
+   }
+   SelValue index = Reduce(node->args[0], rule.left);
+   Unspill(result, spilled);
+   if (rule.left == snImm) {
+      result.disp = Wrap(result.disp + ((long long)index.disp - type->GetLow()) * size);
+      return result;
+   }
+   int low = type->GetLow();
+   if (rule.check == scChecked) {
+      SymTypeArray* bounds = dynamic_cast<SymTypeArray*>(type);
+      if (low != 0) {
+         asmCode.AddCmd(SUB, Register(index.base), low);
+      }
+      asmCode.AddCmd(CMP, Register(index.base), bounds->GetHigh() - low);
+      asmCode.AddCmd(JA, asmCode.GetRangeErrorLabel());
+      low = 0;
+   }
+   bool isScaled = size == 1 || size == 2 || size == 4 || size == 8;
+   if (!isScaled) {
+      asmCode.AddCmd(IMUL, Register(index.base), size);
+   }
+   result.disp = Wrap(result.disp + ((long long)index.disp - low) * size);
+   result.index = index.base;
+   result.scale = isScaled ? size : 1;
+   return result;
+}
+
+SelNonterm InstructionSelector::GetCheapest(NodeExpr* node, bool isMemory) const
+{
+   const SelLabel& label = labels.at(node);
+   SelNonterm result = label.cost[snImm] <= label.cost[snReg] ? snImm : snReg;
+   return isMemory && label.cost[snMem] < label.cost[result] ? snMem : result;
+}
+
+void InstructionSelector::Generate(NodeExpr* node)
+{
+   Label(node);
+   SelNonterm form = GetCheapest(node, true);
+   SelValue value = Reduce(node, form);
+   asmCode.AddCmd(PUSH, GetOperand(value, form));
+}
+
+void InstructionSelector::GenerateAddress(const NodeArrIdx* node)
+{
+   SelLabel label;
+   Label(node->args[0]);
+   LabelIndex(node, label);
+   SelValue value = ReduceIndex(node, label, snMem);
+   if (value.label != nullptr && value.index < 0) {
+      asmCode.AddCmd(PUSH, AsmVarAddr(value.label, value.disp));
+   } else if (value.index < 0 && value.disp == 0) {
+      asmCode.AddCmd(PUSH, Register(value.base));
+   } else {
+      asmCode.AddCmd(LEA, new AsmRegister(EAX), GetMemory(value, szNONE));
+      asmCode.AddCmd(PUSH, EAX);
+   }
+}
+
+//compares the operands of a relational operator, the caller jumps on the flags
+void InstructionSelector::GenerateCompare(NodeExpr* node)
+{
+   Label(node);
+   const SelLabel& label = labels[node];
+   SelValue left, right;
+   ReduceOperands(node, label.rule[snReg], left, right);
+   asmCode.AddCmd(CMP, new AsmRegister(Register(left.base)), GetOperand(right, rules[label.rule[snReg] / 2].right));
+}
+
+//sets the flags as test with itself does
+void InstructionSelector::GenerateTest(NodeExpr* node)
+{
+   Label(node);
+   if (GetCheapest(node, true) == snMem) {
+      asmCode.AddCmd(CMP, GetMemory(Reduce(node, snMem), szDWORD), new AsmIntImmediate(0, szNONE));
+   } else {
+      Register reg = Register(Reduce(node, snReg).base);
+      asmCode.AddCmd(TEST, reg, reg);
+   }
+}
+
+//an integer goes straight to its variable or element, the value is computed before the address
+bool InstructionSelector::GenerateStore(NodeExpr* left, NodeExpr* right)
+{
+   SelOp op = GetOp(left);
+   if (!IsInteger(right) || (op != soVar && op != soIdx)) return false;
+   Label(right);
+   Label(left);
+   if (labels[left].cost[snMem] >= SEL_INFINITY) return false;
+   SelNonterm form = GetCheapest(right, false);
+   SelValue value = Reduce(right, form);
+   vector<Register> spilled;
+   if (labels[left].need[snMem] > GetFreeCount()) {
+      Spill(value, spilled);
+   }
+   SelValue address = Reduce(left, snMem);
+   Unspill(value, spilled);
+   asmCode.AddCmd(MOV, GetMemory(address, szDWORD), GetOperand(value, form));
+   return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "syntax_nodes.h"
+
+using namespace std;
+
+#define SEL_POOL_SIZE 3
+
+//the forms a value can take as an operand: in a register, a constant, in memory, a register
+//plus a constant, an address base + index * scale + disp for lea and a register times a scale
+enum SelNonterm {
+   snReg,
+   snImm,
+   snMem,
+   snOffset,
+   snAddr,
+   snIndex,
+   snCount,
+   snNone = snCount
+};
+
+enum SelOp {
+   soConst,
+   soVar,
+   soIdx,
+   soAdd,
+   soSub,
+   soMul,
+   soDiv,
+   soMod,
+   soAnd,
+   soOr,
+   soXor,
+   soShl,
+   soShr,
+   soNeg,
+   soNot,
+   soPlus,
+   soRel,
+   soOther,
+   soChain
+};
+
+//what a rule asks of the node or of the constant it takes beyond the forms of the operands
+enum SelCheck {
+   scNone,
+   scDirect,
+   scScale,
+   scLea,
+   scPow2,
+   scScaleShift,
+   scShiftCount,
+   scInRange,
+   scUnchecked,
+   scChecked
+};
+
+struct SelRule {
+   SelNonterm result;
+   SelOp op;
+   SelNonterm left, right;
+   SelCheck check;
+   int cost;
+};
+
+//label + base + index * scale + disp, a register is the base alone and a constant the disp alone
+struct SelValue {
+   AsmStrImmediate* label;
+   int base, index;
+   int scale, disp;
+};
+
+//the cheapest rule for each form of the node with the registers it needs and keeps; a rule
+//is kept as its index times two, plus one when the operands of a commutative one are swapped
+struct SelLabel {
+   SelOp op;
+   bool hasSideEffects;
+   int value;
+   int cost[snCount];
+   int rule[snCount];
+   int need[snCount];
+   int held[snCount];
+};
+
+//bottom up rewriting of integer expressions: a labelling pass finds the cheapest cover of the
+//tree by the rules of a cost table, the reducing pass emits it; the value of the tree goes to the
+//stack as the other Generate methods expect, the nodes it cannot cover are generated by them
+class InstructionSelector {
+   AsmCode& asmCode;
+   unordered_map<const NodeExpr*, SelLabel> labels;
+   bool isBusy[SEL_POOL_SIZE];
+
+   static SelOp GetOp(NodeExpr*);
+   static Args GetChildren(NodeExpr*);
+   static bool Fits(int, const NodeExpr*, const SelLabel*, const SelLabel*);
+   static void InitLabel(SelLabel&);
+   static void CloseLabel(SelLabel&);
+   void Derive(SelLabel&, int, bool, const NodeExpr*, const SelLabel*, const SelLabel*, int, int);
+   void Label(NodeExpr*);
+   void LabelIndex(const NodeArrIdx*, SelLabel&);
+   Register Alloc();
+   void Free(int);
+   void Free(const SelValue&);
+   int GetFreeCount() const;
+   vector<Register> SaveLive();
+   Register PopSaved(const vector<Register>&);
+   void Spill(const SelValue&, vector<Register>&);
+   void Unspill(SelValue&, const vector<Register>&);
+   AsmMemory* GetMemory(const SelValue&, SizeType) const;
+   AsmOperand* GetOperand(const SelValue&, SelNonterm) const;
+   SelValue ReduceChain(SelNonterm, SelNonterm, SelValue);
+   void ReduceOperands(NodeExpr*, int, SelValue&, SelValue&);
+   SelValue Reduce(NodeExpr*, SelNonterm);
+   SelValue ReduceIndex(const NodeArrIdx*, const SelLabel&, SelNonterm);
+   SelValue Emit(NodeExpr*, const SelRule&, SelValue, SelValue);
+   SelNonterm GetCheapest(NodeExpr*, bool) const;
+public:
+   InstructionSelector(AsmCode&);
+   static bool IsCovered(NodeExpr*);
+   static bool IsAddressCovered(const NodeArrIdx*);
+   void Generate(NodeExpr*);
+   void GenerateAddress(const NodeArrIdx*);
+   void GenerateCompare(NodeExpr*);
+   void GenerateTest(NodeExpr*);
+   bool GenerateStore(NodeExpr*, NodeExpr*);
+};
@@ -0,0 +1,620 @@
+#include <algorithm>
+#include <climits>
+#include "ir.h"
+
+static string GetIrOpName(IrOpCode op)
+{
+   switch (op) {
+      case irMov:       return "mov";
+      case irAdd:       return "add";
+      case irSub:       return "sub";
+      case irMul:       return "mul";
+      case irDiv:       return "div";
+      case irMod:       return "mod";
+      case irAnd:       return "and";
+      case irOr:        return "or";
+      case irXor:       return "xor";
+      case irShl:       return "shl";
+      case irShr:       return "shr";
+      case irNeg:       return "neg";
+      case irSetEq:     return "seteq";
+      case irSetNe:     return "setne";
+      case irSetLt:     return "setlt";
+      case irSetLe:     return "setle";
+      case irSetGt:     return "setgt";
+      case irSetGe:     return "setge";
+      case irFAdd:      return "fadd";
+      case irFSub:      return "fsub";
+      case irFMul:      return "fmul";
+      case irFDiv:      return "fdiv";
+      case irFNeg:      return "fneg";
+      case irFSetEq:    return "fseteq";
+      case irFSetNe:    return "fsetne";
+      case irFSetLt:    return "fsetlt";
+      case irFSetLe:    return "fsetle";
+      case irFSetGt:    return "fsetgt";
+      case irFSetGe:    return "fsetge";
+      case irIntToReal: return "itor";
+      case irLoad:      return "load";
+      case irStore:     return "store";
+      case irCopy:      return "copy";
+      case irAlloc:     return "alloc";
+      case irPush:      return "push";
+      case irPushBlock: return "pushblock";
+      case irCall:      return "call";
+      case irPop:       return "pop";
+      case irPopBlock:  return "popblock";
+      case irWriteInt:  return "writeint";
+      case irWriteReal: return "writereal";
+      case irWriteStr:  return "writestr";
+      case irWriteLn:   return "writeln";
+      case irCheck:     return "check";
+      case irJump:      return "jump";
+      case irBranch:    return "branch";
+      case irSwitch:    return "switch";
+      default:          return "";
+   }
+}
+
+IrOperand::IrOperand(IrOperandKind AKind, int AValue, AsmStrImmediate* ALabel):
+   kind(AKind),
+   value(AValue),
+   label(ALabel)
+{}
+
+bool IrOperand::IsReg() const
+{
+   return kind == ioReg;
+}
+
+bool IrOperand::IsImm() const
+{
+   return kind == ioImm;
+}
+
+bool IrOperand::IsNone() const
+{
+   return kind == ioNone;
+}
+
+bool IrOperand::operator==(const IrOperand& oper) const
+{
+   return
+         kind == oper.kind
+      && value == oper.value
+      && (kind != ioAddr || label->GetStrValue() == oper.label->GetStrValue());
+}
+
+bool IrOperand::operator!=(const IrOperand& oper) const
+{
+   return !(*this == oper);
+}
+
+void IrOperand::Print() const
+{
+   string offset = value ? (value > 0 ? " + " : " - ") + to_string(abs(value)) : "";
+   switch (kind) {
+      case ioReg:
+         cout << '%' << value;
+         break;
+      case ioImm:
+         cout << value;
+         break;
+      case ioAddr:
+         cout << '&' << label->GetStrValue() << offset;
+         break;
+      case ioFrame:
+         cout << "frame" << offset;
+         break;
+      default:
+         break;
+   }
+}
+
+IrOperand IrImm(int value)
+{
+   return IrOperand(ioImm, value);
+}
+
+IrOperand IrAddr(AsmStrImmediate* label, int offset)
+{
+   return IrOperand(ioAddr, offset, label);
+}
+
+IrOperand IrFrame(int offset)
+{
+   return IrOperand(ioFrame, offset);
+}
+
+IrInstr::IrInstr(IrOpCode AOp, IrOperand ADst, IrOperand AA, IrOperand AB):
+   op(AOp),
+   dst(ADst),
+   a(AA),
+   b(AB),
+   offset(0),
+   size(0),
+   target(nullptr),
+   alt(nullptr),
+   callee(nullptr)
+{}
+
+bool IrInstr::IsTerminator() const
+{
+   return op == irJump || op == irBranch || op == irSwitch;
+}
+
+bool IrInstr::IsCall() const
+{
+   return op == irCall || op == irWriteInt || op == irWriteReal || op == irWriteStr || op == irWriteLn;
+}
+
+bool IrInstr::HasSideEffects() const
+{
+   return op >= irStore;
+}
+
+//how many bytes the instruction puts onto the stack, negative for the ones it takes off
+int IrInstr::GetStackEffect() const
+{
+   switch (op) {
+      case irAlloc:     return size;
+      case irPush:      return 4;
+      case irPushBlock: return (size + 3) / 4 * 4;
+      case irCall:      return -int(size);
+      case irPop:       return -4;
+      case irPopBlock:  return -int((size + 3) / 4 * 4);
+      default:          return 0;
+   }
+}
+
+vector<int> IrInstr::GetUses() const
+{
+   vector<int> result;
+   if (a.IsReg()) {
+      result.push_back(a.value);
+   }
+   if (b.IsReg()) {
+      result.push_back(b.value);
+   }
+   return result;
+}
+
+int IrInstr::GetDef() const
+{
+   return dst.IsReg() ? dst.value : -1;
+}
+
+void IrInstr::Print() const
+{
+   cout << '\t';
+   if (!dst.IsNone()) {
+      dst.Print();
+      cout << " = ";
+   }
+   cout << GetIrOpName(op);
+   switch (op) {
+      case irLoad:
+         cout << " [";
+         a.Print();
+         cout << (offset ? (offset > 0 ? " + " : " - ") + to_string(abs(offset)) : "") << ']';
+         break;
+      case irStore:
+         cout << " [";
+         a.Print();
+         cout << (offset ? (offset > 0 ? " + " : " - ") + to_string(abs(offset)) : "") << "], ";
+         b.Print();
+         break;
+      case irCall:
+         cout << ' ' << callee->GetStrValue() << ", " << size << ", ";
+         a.Print();
+         break;
+      case irCheck:
+         cout << ' ';
+         a.Print();
+         cout << ", " << offset << ".." << offset + int(size);
+         break;
+      case irJump:
+         cout << " bb" << target->id;
+         break;
+      case irBranch:
+         cout << ' ';
+         a.Print();
+         cout << ", bb" << target->id << ", bb" << alt->id;
+         break;
+      case irSwitch:
+         cout << ' ';
+         a.Print();
+         cout << (offset ? (offset > 0 ? " - " : " + ") + to_string(abs(offset)) : "") << ", bb" << alt->id << ", [";
+         for (size_t i = 0; i < cases.size(); i++) {
+            cout << (i ? ", bb" : "bb") << cases[i]->id;
+         }
+         cout << ']';
+         break;
+      default:
+         if (!a.IsNone()) {
+            cout << ' ';
+            a.Print();
+         }
+         if (!b.IsNone()) {
+            cout << ", ";
+            b.Print();
+         }
+         if (size) {
+            cout << (a.IsNone() ? " " : ", ") << size;
+         }
+   }
+}
+
+IrBlock::IrBlock(size_t AId):
+   id(AId)
+{}
+
+bool IrBlock::IsTerminated() const
+{
+   return !instrs.empty() && instrs.back().IsTerminator();
+}
+
+vector<IrBlock*> IrBlock::GetSuccessors() const
+{
+   vector<IrBlock*> result;
+   if (IsTerminated()) {
+      const IrInstr& last = instrs.back();
+      result.push_back(last.op == irSwitch ? last.alt : last.target);
+      if (last.op == irBranch && last.alt != last.target) {
+         result.push_back(last.alt);
+      }
+      for (auto &block : last.cases) {
+         if (find(result.begin(), result.end(), block) == result.end()) {
+            result.push_back(block);
+         }
+      }
+   }
+   return result;
+}
+
+//the arguments of a call are found going back from it: a push taking the stack lower than
+//everything after it belongs to this call, deeper ones to the calls nested in the arguments;
+//slots maps the pushes to their offsets in the frame of the callee, begin is the first one
+//or the alloc reserving the result of a function
+bool IrBlock::FindArguments(size_t call, size_t& begin, unordered_map<size_t, int>& slots) const
+{
+   int resultSize = 0;
+   if (call + 1 < instrs.size() && (instrs[call + 1].op == irPop || instrs[call + 1].op == irPopBlock)) {
+      resultSize = -instrs[call + 1].GetStackEffect();
+   }
+   int argsSize = instrs[call].size, depth = argsSize, low = argsSize;
+   begin = call;
+   while (low > -resultSize) {
+      if (begin == 0) return false;
+      const IrInstr& instr = instrs[--begin];
+      int before = depth - instr.GetStackEffect();
+      if (before < low) {
+         if (instr.op == irPush || instr.op == irPushBlock) {
+            slots[begin] = 12 + argsSize - depth;
+         } else if (instr.op != irAlloc) {
+            return false;
+         }
+         low = before;
+      }
+      depth = before;
+   }
+   return true;
+}
+
+void IrBlock::Print() const
+{
+   cout << "bb" << id << ':' << endl;
+   for (auto &instr : instrs) {
+      instr.Print();
+      cout << endl;
+   }
+}
+
+IrFunction::IrFunction(AsmStrImmediate* ALabel, size_t AFrameSize):
+   label(ALabel),
+   frameSize(AFrameSize),
+   blockCount(0),
+   regions({INT_MIN, 0}),
+   entry(nullptr),
+   exit(nullptr)
+{}
+
+IrBlock* IrFunction::NewBlock()
+{
+   return new IrBlock(blockCount++);
+}
+
+IrOperand IrFunction::NewReg(IrType type)
+{
+   regTypes.push_back(type);
+   return IrOperand(ioReg, regTypes.size() - 1);
+}
+
+IrType IrFunction::GetType(const IrOperand& oper) const
+{
+   return oper.IsReg() ? regTypes[oper.value] : itInt;
+}
+
+IrOperand IrFunction::AllocFrame(size_t size)
+{
+   frameSize = (frameSize + size + 3) / 4 * 4;
+   return IrFrame(-int(frameSize));
+}
+
+int IrFunction::GetRegion(int offset) const
+{
+   return *--regions.upper_bound(offset);
+}
+
+string IrFunction::GetName() const
+{
+   return label != nullptr ? label->GetStrValue() : "main";
+}
+
+void IrFunction::Print() const
+{
+   cout << "function " << GetName() << ", frame " << frameSize << endl;
+   for (auto &block : blocks) {
+      block->Print();
+   }
+   cout << endl;
+}
+
+IrProgram::IrProgram(AsmCode& AAsmCode):
+   asmCode(AAsmCode)
+{}
+
+void IrProgram::Print() const
+{
+   for (auto &function : functions) {
+      function->Print();
+   }
+}
+
+IrLiveness::IrLiveness(IrFunction* function)
+{
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto it = function->blocks.rbegin(); it != function->blocks.rend(); it++) {
+         IrBlock* block = *it;
+         IrRegSet live;
+         for (auto &succ : block->GetSuccessors()) {
+            live.insert(liveIn[succ].begin(), liveIn[succ].end());
+         }
+         liveOut[block] = live;
+         for (auto instr = block->instrs.rbegin(); instr != block->instrs.rend(); instr++) {
+            live.erase(instr->GetDef());
+            for (auto &reg : instr->GetUses()) {
+               live.insert(reg);
+            }
+         }
+         if (live != liveIn[block]) {
+            liveIn[block] = live;
+            isChanged = true;
+         }
+      }
+   }
+}
+
+IrBuilder::IrBuilder(IrProgram& AProgram, AsmStrImmediate* ALabel, size_t AFrameSize):
+   program(AProgram),
+   function(new IrFunction(ALabel, AFrameSize)),
+   block(nullptr)
+{
+   function->entry = NewBlock();
+   function->exit = NewBlock();
+   SetBlock(function->entry);
+}
+
+AsmCode& IrBuilder::GetAsmCode()
+{
+   return program.asmCode;
+}
+
+IrBlock* IrBuilder::NewBlock()
+{
+   return function->NewBlock();
+}
+
+void IrBuilder::SetBlock(IrBlock* ABlock)
+{
+   if (block != nullptr && !block->IsTerminated()) {
+      Jump(ABlock);
+   }
+   if (find(function->blocks.begin(), function->blocks.end(), ABlock) == function->blocks.end()) {
+      function->blocks.push_back(ABlock);
+   }
+   block = ABlock;
+}
+
+void IrBuilder::Finish()
+{
+   SetBlock(function->exit);
+   program.functions.push_back(function);
+}
+
+IrOperand IrBuilder::NewReg(IrType type)
+{
+   return function->NewReg(type);
+}
+
+IrType IrBuilder::GetType(const IrOperand& oper) const
+{
+   return function->GetType(oper);
+}
+
+IrOperand IrBuilder::AllocTemp(size_t size)
+{
+   return function->AllocFrame(size);
+}
+
+void IrBuilder::Emit(IrInstr instr)
+{
+   if (block == nullptr) {
+      SetBlock(NewBlock());
+   }
+   block->instrs.push_back(instr);
+}
+
+IrOperand IrBuilder::Unary(IrOpCode op, IrOperand arg)
+{
+   if (op == irNeg && arg.IsImm()) {
+      return IrImm(-arg.value);
+   }
+   IrOperand result = NewReg(op == irFNeg || op == irIntToReal ? itReal : itInt);
+   Emit(IrInstr(op, result, arg));
+   return result;
+}
+
+IrOperand IrBuilder::Binary(IrOpCode op, IrOperand left, IrOperand right)
+{
+   if (op == irAdd && right.IsImm()) {
+      return Offset(left, right.value);
+   }
+   if (op == irAdd && left.IsImm()) {
+      return Offset(right, left.value);
+   }
+   if (op == irSub && right.IsImm()) {
+      return Offset(left, -right.value);
+   }
+   if (op == irMul && left.IsImm() && right.IsImm()) {
+      return IrImm(left.value * right.value);
+   }
+   if (op == irMul && right.IsImm() && right.value == 1) {
+      return left;
+   }
+   IrOperand result = NewReg(op >= irFAdd && op <= irFDiv ? itReal : itInt);
+   Emit(IrInstr(op, result, left, right));
+   return result;
+}
+
+IrOperand IrBuilder::Offset(IrOperand addr, int offset)
+{
+   if (offset == 0) {
+      return addr;
+   }
+   if (addr.kind == ioFrame || addr.kind == ioAddr || addr.kind == ioImm) {
+      addr.value += offset;
+      return addr;
+   }
+   IrOperand result = NewReg(itInt);
+   Emit(IrInstr(irAdd, result, addr, IrImm(offset)));
+   return result;
+}
+
+IrOperand IrBuilder::Load(IrOperand addr, IrType type, int offset)
+{
+   IrOperand result = NewReg(type);
+   IrInstr instr(irLoad, result, addr);
+   instr.offset = offset;
+   Emit(instr);
+   return result;
+}
+
+void IrBuilder::Store(IrOperand addr, IrOperand value, int offset)
+{
+   IrInstr instr(irStore, IrOperand(), addr, value);
+   instr.offset = offset;
+   Emit(instr);
+}
+
+void IrBuilder::Copy(IrOperand dst, IrOperand src, size_t size)
+{
+   IrInstr instr(irCopy, IrOperand(), dst, src);
+   instr.size = size;
+   Emit(instr);
+}
+
+IrOperand IrBuilder::GetFrame(unsigned nesting)
+{
+   IrOperand result = IrFrame();
+   for (size_t i = 0; i < nesting; i++) {
+      result = Load(result, itInt, 8);
+   }
+   return result;
+}
+
+void IrBuilder::Alloc(size_t size)
+{
+   IrInstr instr(irAlloc);
+   instr.size = size;
+   Emit(instr);
+}
+
+void IrBuilder::Push(IrOperand value)
+{
+   Emit(IrInstr(irPush, IrOperand(), value));
+}
+
+void IrBuilder::PushBlock(IrOperand addr, size_t size)
+{
+   IrInstr instr(irPushBlock, IrOperand(), addr);
+   instr.size = size;
+   Emit(instr);
+}
+
+void IrBuilder::Call(AsmStrImmediate* callee, size_t argsSize, IrOperand link)
+{
+   IrInstr instr(irCall, IrOperand(), link);
+   instr.callee = callee;
+   instr.size = argsSize;
+   Emit(instr);
+}
+
+IrOperand IrBuilder::Pop(IrType type)
+{
+   IrOperand result = NewReg(type);
+   Emit(IrInstr(irPop, result));
+   return result;
+}
+
+void IrBuilder::PopBlock(IrOperand addr, size_t size)
+{
+   IrInstr instr(irPopBlock, IrOperand(), addr);
+   instr.size = size;
+   Emit(instr);
+}
+
+void IrBuilder::Write(IrOpCode op, IrOperand value)
+{
+   Emit(IrInstr(op, IrOperand(), value));
+}
+
+void IrBuilder::Check(IrOperand value, int low, int high)
+{
+   IrInstr instr(irCheck, IrOperand(), value);
+   instr.offset = low;
+   instr.size = high - low;
+   Emit(instr);
+}
+
+void IrBuilder::Jump(IrBlock* target)
+{
+   if (block == nullptr) {
+      return;
+   }
+   IrInstr instr(irJump);
+   instr.target = target;
+   Emit(instr);
+   block = nullptr;
+}
+
+void IrBuilder::Switch(IrOperand value, int low, IrBlock* alt, const vector<IrBlock*>& cases)
+{
+   IrInstr instr(irSwitch, IrOperand(), value);
+   instr.offset = low;
+   instr.alt = alt;
+   instr.cases = cases;
+   Emit(instr);
+   block = nullptr;
+}
+
+void IrBuilder::Branch(IrOperand cond, IrBlock* target, IrBlock* alt)
+{
+   IrInstr instr(irBranch, IrOperand(), cond);
+   instr.target = target;
+   instr.alt = alt;
+   Emit(instr);
+   block = nullptr;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <set>
+#include <unordered_map>
+#include "CodeGen.h"
+
+using namespace std;
+
+enum IrType {
+   itInt,
+   itReal
+};
+
+enum IrOperandKind {
+   ioNone,
+   ioReg,
+   ioImm,
+   ioAddr,
+   ioFrame
+};
+
+struct IrOperand {
+   IrOperandKind kind;
+   int value;
+   AsmStrImmediate* label;
+   IrOperand(IrOperandKind = ioNone, int = 0, AsmStrImmediate* = nullptr);
+   bool IsReg() const;
+   bool IsImm() const;
+   bool IsNone() const;
+   bool operator==(const IrOperand&) const;
+   bool operator!=(const IrOperand&) const;
+   void Print() const;
+};
+
+IrOperand IrImm(int);
+IrOperand IrAddr(AsmStrImmediate*, int = 0);
+IrOperand IrFrame(int = 0);
+
+enum IrOpCode {
+   irMov,
+   irAdd,
+   irSub,
+   irMul,
+   irDiv,
+   irMod,
+   irAnd,
+   irOr,
+   irXor,
+   irShl,
+   irShr,
+   irNeg,
+   irSetEq,
+   irSetNe,
+   irSetLt,
+   irSetLe,
+   irSetGt,
+   irSetGe,
+   irFAdd,
+   irFSub,
+   irFMul,
+   irFDiv,
+   irFNeg,
+   irFSetEq,
+   irFSetNe,
+   irFSetLt,
+   irFSetLe,
+   irFSetGt,
+   irFSetGe,
+   irIntToReal,
+   irLoad,
+   irStore,
+   irCopy,
+   irAlloc,
+   irPush,
+   irPushBlock,
+   irCall,
+   irPop,
+   irPopBlock,
+   irWriteInt,
+   irWriteReal,
+   irWriteStr,
+   irWriteLn,
+   irCheck,
+   irJump,
+   irBranch,
+   irSwitch
+};
+
+struct IrBlock;
+
+//dst = a op b; loads and stores address [a + offset], blocks of memory are size bytes long;
+//a switch goes to cases[a - offset] or to alt when there is no such case;
+//a check stops the program unless offset <= a <= offset + size
+struct IrInstr {
+   IrOpCode op;
+   IrOperand dst, a, b;
+   int offset;
+   size_t size;
+   IrBlock* target;
+   IrBlock* alt;
+   vector<IrBlock*> cases;
+   AsmStrImmediate* callee;
+   IrInstr(IrOpCode, IrOperand = IrOperand(), IrOperand = IrOperand(), IrOperand = IrOperand());
+   bool IsTerminator() const;
+   bool IsCall() const;
+   bool HasSideEffects() const;
+   int GetStackEffect() const;
+   vector<int> GetUses() const;
+   int GetDef() const;
+   void Print() const;
+};
+
+typedef vector<IrInstr> IrInstrs;
+
+struct IrBlock {
+   size_t id;
+   IrInstrs instrs;
+   IrBlock(size_t);
+   bool IsTerminated() const;
+   vector<IrBlock*> GetSuccessors() const;
+   bool FindArguments(size_t, size_t&, unordered_map<size_t, int>&) const;
+   void Print() const;
+};
+
+typedef vector<IrBlock*> IrBlocks;
+
+struct IrFunction {
+   AsmStrImmediate* label;
+   size_t frameSize;
+   size_t blockCount;
+   //frame offsets where the variables of an inlined callee begin, no address crosses them
+   set<int> regions;
+   vector<IrType> regTypes;
+   IrBlocks blocks;
+   IrBlock* entry;
+   IrBlock* exit;
+   IrFunction(AsmStrImmediate*, size_t);
+   IrBlock* NewBlock();
+   IrOperand NewReg(IrType);
+   IrType GetType(const IrOperand&) const;
+   IrOperand AllocFrame(size_t);
+   int GetRegion(int) const;
+   string GetName() const;
+   void Print() const;
+};
+
+struct IrProgram {
+   AsmCode& asmCode;
+   vector<IrFunction*> functions;
+   IrProgram(AsmCode&);
+   void Print() const;
+};
+
+typedef set<int> IrRegSet;
+
+struct IrLiveness {
+   unordered_map<IrBlock*, IrRegSet> liveIn;
+   unordered_map<IrBlock*, IrRegSet> liveOut;
+   IrLiveness(IrFunction*);
+};
+
+class IrBuilder {
+public:
+   IrProgram& program;
+   IrFunction* function;
+   IrBlock* block;
+   IrBuilder(IrProgram&, AsmStrImmediate*, size_t);
+   AsmCode& GetAsmCode();
+   IrBlock* NewBlock();
+   void SetBlock(IrBlock*);
+   void Finish();
+   IrOperand NewReg(IrType);
+   IrType GetType(const IrOperand&) const;
+   IrOperand AllocTemp(size_t);
+   void Emit(IrInstr);
+   IrOperand Unary(IrOpCode, IrOperand);
+   IrOperand Binary(IrOpCode, IrOperand, IrOperand);
+   IrOperand Offset(IrOperand, int);
+   IrOperand Load(IrOperand, IrType = itInt, int = 0);
+   void Store(IrOperand, IrOperand, int = 0);
+   void Copy(IrOperand, IrOperand, size_t);
+   IrOperand GetFrame(unsigned);
+   void Alloc(size_t);
+   void Push(IrOperand);
+   void PushBlock(IrOperand, size_t);
+   void Call(AsmStrImmediate*, size_t, IrOperand);
+   IrOperand Pop(IrType);
+   void PopBlock(IrOperand, size_t);
+   void Write(IrOpCode, IrOperand = IrOperand());
+   void Check(IrOperand, int, int);
+   void Jump(IrBlock*);
+   void Branch(IrOperand, IrBlock*, IrBlock*);
+   void Switch(IrOperand, int, IrBlock*, const vector<IrBlock*>&);
+};
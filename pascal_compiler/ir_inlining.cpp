@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <climits>
+#include "ir_inlining.h"
+
+static size_t GetStackSize(size_t size)
+{
+   return (size + 3) / 4 * 4;
+}
+
+static size_t GetCost(IrFunction* function)
+{
+   size_t result = 0;
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         result += instr.op != irJump;
+      }
+   }
+   return result;
+}
+
+static size_t CountCalls(IrFunction* function, const string& name)
+{
+   size_t result = 0;
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         result += instr.op == irCall && instr.callee->GetStrValue() == name;
+      }
+   }
+   return result;
+}
+
+IrInliner::IrInliner(size_t AThreshold):
+   threshold(AThreshold),
+   program(nullptr)
+{}
+
+IrFunction* IrInliner::FindFunction(AsmStrImmediate* label) const
+{
+   for (auto &function : program->functions) {
+      if (function->label != nullptr && function->label->GetStrValue() == label->GetStrValue()) {
+         return function;
+      }
+   }
+   return nullptr;
+}
+
+bool IrInliner::IsLeaf(IrFunction* function) const
+{
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         if (instr.op == irCall) return false;
+      }
+   }
+   return true;
+}
+
+//whether the callee only loads the argument at [frame + offset], so the pushed value can be used instead;
+//an address computed from the frame or an argument below, like the data of an open array, may reach any argument above it
+bool IrInliner::IsReadOnly(IrFunction* function, int offset) const
+{
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         for (int i = 0; i < 2; i++) {
+            const IrOperand& oper = i ? instr.b : instr.a;
+            if (oper.kind != ioFrame) continue;
+            bool isAccess = i == 0 && (instr.op == irLoad || instr.op == irStore);
+            int begin = oper.value + (isAccess ? instr.offset : 0);
+            int size = isAccess ? 4 : instr.op == irCopy ? instr.size : 1;
+            if (!isAccess && instr.op != irCopy && begin >= 0 && begin <= offset) return false;
+            if (begin < offset + 4 && offset < begin + size && (instr.op != irLoad || !isAccess || begin != offset)) return false;
+         }
+      }
+   }
+   return true;
+}
+
+bool IrInliner::InlineCall(IrFunction* caller, IrBlock* block, size_t index)
+{
+   IrInstrs& instrs = block->instrs;
+   IrInstr call = instrs[index];
+   IrFunction* callee = FindFunction(call.callee);
+   if (callee == nullptr || callee == caller || !IsLeaf(callee)) return false;
+   size_t begin, end = index + 1;
+   unordered_map<size_t, int> slots;
+   if (!block->FindArguments(index, begin, slots)) return false;
+   int resultSize = 0, argsSize = call.size;
+   if (end < instrs.size() && (instrs[end].op == irPop || instrs[end].op == irPopBlock)) {
+      resultSize = -instrs[end++].GetStackEffect();
+   }
+   size_t cost = GetCost(callee);
+   if (cost > threshold + slots.size() + 2) return false;
+
+   size_t frameSize = GetStackSize(callee->frameSize);
+   int shift = caller->AllocFrame(frameSize + 12 + argsSize + resultSize).value + frameSize;
+   for (auto &region : callee->regions) {
+      caller->regions.insert(region == INT_MIN ? shift - int(frameSize) : region + shift);
+   }
+   caller->regions.insert(shift + 12 + argsSize + resultSize);
+   int regShift = caller->regTypes.size();
+   for (auto &type : callee->regTypes) {
+      caller->NewReg(type);
+   }
+   auto map = [&](IrOperand oper) {
+      if (oper.IsReg()) {
+         oper.value += regShift;
+      } else if (oper.kind == ioFrame) {
+         oper.value += shift;
+      }
+      return oper;
+   };
+
+   unordered_map<int, IrOperand> arguments;
+   IrInstrs head(instrs.begin(), instrs.begin() + begin);
+   for (size_t i = begin; i < index; i++) {
+      const IrInstr& instr = instrs[i];
+      if (slots.count(i) == 0) {
+         if (i != begin || instr.op != irAlloc) {
+            head.push_back(instr);
+         }
+         continue;
+      }
+      int slot = slots[i];
+      if (instr.op == irPush && IsReadOnly(callee, slot)) {
+         arguments[slot] = instr.a;
+      } else if (instr.op == irPush) {
+         head.push_back(IrInstr(irStore, IrOperand(), IrFrame(shift + slot), instr.a));
+      } else {
+         IrInstr copy(irCopy, IrOperand(), IrFrame(shift + slot), instr.a);
+         copy.size = instr.size;
+         head.push_back(copy);
+      }
+   }
+   if (!IsReadOnly(callee, 8)) {
+      head.push_back(IrInstr(irStore, IrOperand(), IrFrame(shift + 8), call.a));
+   }
+
+   IrBlock* next = caller->NewBlock();
+   IrOperand result = IrFrame(shift + 12 + argsSize);
+   if (resultSize > 0 && instrs[index + 1].op == irPop) {
+      next->instrs.push_back(IrInstr(irLoad, instrs[index + 1].dst, result));
+   } else if (resultSize > 0) {
+      IrInstr copy(irCopy, IrOperand(), instrs[index + 1].a, result);
+      copy.size = instrs[index + 1].size;
+      next->instrs.push_back(copy);
+   }
+   next->instrs.insert(next->instrs.end(), instrs.begin() + end, instrs.end());
+
+   //the static link of the callee is the one passed by the call
+   unordered_map<IrBlock*, IrBlock*> clones;
+   IrBlocks blocks;
+   for (auto &calleeBlock : callee->blocks) {
+      blocks.push_back(clones[calleeBlock] = caller->NewBlock());
+   }
+   for (auto &calleeBlock : callee->blocks) {
+      IrInstrs& cloned = clones[calleeBlock]->instrs;
+      for (auto instr : calleeBlock->instrs) {
+         int offset = instr.a.value + instr.offset;
+         if (instr.op == irLoad && instr.a.kind == ioFrame && offset == 8) {
+            instr = IrInstr(irMov, instr.dst, call.a);
+         } else if (instr.op == irLoad && instr.a.kind == ioFrame && arguments.count(offset)) {
+            instr = IrInstr(irMov, instr.dst, arguments[offset]);
+         } else {
+            instr.a = map(instr.a);
+            instr.b = map(instr.b);
+         }
+         instr.dst = map(instr.dst);
+         if (instr.target != nullptr) {
+            instr.target = clones[instr.target];
+         }
+         if (instr.alt != nullptr) {
+            instr.alt = clones[instr.alt];
+         }
+         for (auto &target : instr.cases) {
+            target = clones[target];
+         }
+         cloned.push_back(instr);
+      }
+   }
+   IrInstr jump(irJump);
+   jump.target = next;
+   clones[callee->exit]->instrs.push_back(jump);
+   jump.target = clones[callee->entry];
+   head.push_back(jump);
+   instrs = head;
+   blocks.push_back(next);
+   auto position = find(caller->blocks.begin(), caller->blocks.end(), block) + 1;
+   caller->blocks.insert(position, blocks.begin(), blocks.end());
+   report.push_back("inlined " + callee->GetName() + " into " + caller->GetName() + ", " + to_string(cost) + " instructions");
+   return true;
+}
+
+//callees are inlined bottom up: once all calls of a caller are gone, it is a leaf itself;
+//subroutines that lost all their calls this way are dropped
+void IrInliner::Inline(IrProgram& AProgram)
+{
+   program = &AProgram;
+   unordered_map<IrFunction*, size_t> calls;
+   for (auto &function : program->functions) {
+      for (auto &caller : program->functions) {
+         calls[function] += function->label != nullptr ? CountCalls(caller, function->label->GetStrValue()) : 0;
+      }
+   }
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto &caller : program->functions) {
+         for (size_t i = 0; i < caller->blocks.size(); i++) {
+            IrBlock* block = caller->blocks[i];
+            for (size_t j = 0; j < block->instrs.size(); j++) {
+               if (block->instrs[j].op == irCall && InlineCall(caller, block, j)) {
+                  isChanged = true;
+                  break;
+               }
+            }
+         }
+      }
+   }
+   unordered_set<IrFunction*> dropped;
+   for (auto &function : program->functions) {
+      size_t count = 0;
+      for (auto &caller : program->functions) {
+         count += function->label != nullptr ? CountCalls(caller, function->label->GetStrValue()) : 0;
+      }
+      if (calls[function] > 0 && count == 0) {
+         dropped.insert(function);
+      }
+   }
+   vector<IrFunction*>& functions = program->functions;
+   functions.erase(remove_if(functions.begin(), functions.end(), [&](IrFunction* function) {
+      return dropped.count(function) > 0;
+   }), functions.end());
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "ir.h"
+
+//replaces calls of small subroutines which call nothing themselves by a copy of
+//their body; the callee's frame becomes a part of the caller's one
+class IrInliner {
+   size_t threshold;
+   IrProgram* program;
+
+   IrFunction* FindFunction(AsmStrImmediate*) const;
+   bool IsLeaf(IrFunction*) const;
+   bool IsReadOnly(IrFunction*, int) const;
+   bool InlineCall(IrFunction*, IrBlock*, size_t);
+public:
+   vector<string> report;
+   IrInliner(size_t);
+   void Inline(IrProgram&);
+};
@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <climits>
+#include "ir_lowering.h"
+
+static const Register allocatableRegs[] = { EBX, ESI, EDI, ECX };
+
+static bool IsRegister(AsmOperand* oper)
+{
+   return TryToCastOperand<AsmRegister>(oper);
+}
+
+static OpCode GetIntOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irAdd: return ADD;
+      case irSub: return SUB;
+      case irMul: return IMUL;
+      case irAnd: return AND;
+      case irOr:  return OR;
+      case irXor: return XOR;
+      case irShl: return SHL;
+      case irShr: return SHR;
+      default:    return MOV;
+   }
+}
+
+static OpCode GetSetOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irSetEq:  return SETE;
+      case irSetNe:  return SETNE;
+      case irSetLt:  return SETL;
+      case irSetLe:  return SETLE;
+      case irSetGt:  return SETG;
+      case irSetGe:  return SETGE;
+      case irFSetEq: return SETE;
+      case irFSetNe: return SETNE;
+      case irFSetLt: return SETA;
+      case irFSetLe: return SETAE;
+      case irFSetGt: return SETB;
+      case irFSetGe: return SETBE;
+      default:       return SETE;
+   }
+}
+
+//the jump taken when a comparison holds and the one taken when it does not
+static pair<OpCode, OpCode> GetJumpOpCodes(IrOpCode op)
+{
+   switch (op) {
+      case irSetEq:  return make_pair(JE, JNE);
+      case irSetNe:  return make_pair(JNE, JE);
+      case irSetLt:  return make_pair(JL, JGE);
+      case irSetLe:  return make_pair(JLE, JG);
+      case irSetGt:  return make_pair(JG, JLE);
+      case irSetGe:  return make_pair(JGE, JL);
+      case irFSetEq: return make_pair(JE, JNE);
+      case irFSetNe: return make_pair(JNE, JE);
+      case irFSetLt: return make_pair(JA, JBE);
+      case irFSetLe: return make_pair(JAE, JB);
+      case irFSetGt: return make_pair(JB, JAE);
+      default:       return make_pair(JBE, JA);
+   }
+}
+
+static bool IsComparison(IrOpCode op)
+{
+   return (op >= irSetEq && op <= irSetGe) || (op >= irFSetEq && op <= irFSetGe);
+}
+
+static bool IsWrite(IrOpCode op)
+{
+   return op == irWriteInt || op == irWriteReal || op == irWriteStr || op == irWriteLn;
+}
+
+static size_t GetWritesEnd(const IrInstrs& instrs, size_t first)
+{
+   size_t last = first;
+   while (last < instrs.size() && IsWrite(instrs[last].op)) {
+      last++;
+   }
+   return last;
+}
+
+static OpCode GetRealOpCode(IrOpCode op)
+{
+   switch (op) {
+      case irFAdd: return FADDP;
+      case irFSub: return FSUBP;
+      case irFMul: return FMULP;
+      default:     return FDIVP;
+   }
+}
+
+IrLowering::IrLowering(AsmCode& AAsmCode):
+   asmCode(AAsmCode),
+   function(nullptr),
+   scratch(nullptr),
+   nextBlock(nullptr)
+{}
+
+void IrLowering::Allocate()
+{
+   size_t regCount = function->regTypes.size();
+   vector<int> start(regCount, INT_MAX), end(regCount, -1);
+   vector<int> calls, writes;
+   IrLiveness liveness(function);
+   auto extend = [&](int reg, int pos) {
+      start[reg] = min(start[reg], pos);
+      end[reg] = max(end[reg], pos);
+   };
+   int pos = 0;
+   for (auto &block : function->blocks) {
+      for (auto &reg : liveness.liveIn[block]) {
+         extend(reg, pos);
+      }
+      for (auto &instr : block->instrs) {
+         pos += 2;
+         for (auto &reg : instr.GetUses()) {
+            extend(reg, pos);
+         }
+         if (instr.GetDef() >= 0) {
+            extend(instr.GetDef(), pos + 1);
+         }
+         if (instr.op == irCall) {
+            calls.push_back(pos);
+         } else if (instr.IsCall()) {
+            writes.push_back(pos);
+         }
+         if ((instr.op == irDiv || instr.op == irMod || instr.op == irIntToReal) && scratch == nullptr) {
+            scratch = new AsmMemory(EBP, function->AllocFrame(4).value, szDWORD);
+         }
+      }
+      pos += 2;
+      for (auto &reg : liveness.liveOut[block]) {
+         extend(reg, pos);
+      }
+   }
+   auto crosses = [&](int reg, vector<int>& points) -> bool {
+      for (auto &point : points) {
+         if (start[reg] < point && end[reg] > point) {
+            return true;
+         }
+      }
+      return false;
+   };
+   vector<int> order;
+   for (size_t reg = 0; reg < regCount; reg++) {
+      if (end[reg] >= 0) {
+         order.push_back(reg);
+      }
+   }
+   stable_sort(order.begin(), order.end(), [&](int r1, int r2) { return start[r1] < start[r2]; });
+   vector<int> spilled;
+   vector<pair<int, Register>> active;
+   for (auto &reg : order) {
+      active.erase(
+         remove_if(active.begin(), active.end(), [&](const pair<int, Register>& a) { return end[a.first] < start[reg]; }),
+         active.end()
+      );
+      if (function->regTypes[reg] == itReal || crosses(reg, calls)) {
+         spilled.push_back(reg);
+         continue;
+      }
+      bool canUseEcx = !crosses(reg, writes);
+      bool isAllocated = false;
+      for (auto &phys : allocatableRegs) {
+         if (phys == ECX && !canUseEcx) continue;
+         auto it = find_if(active.begin(), active.end(), [&](const pair<int, Register>& a) { return a.second == phys; });
+         if (it == active.end()) {
+            active.push_back(make_pair(reg, phys));
+            locations[reg] = new AsmRegister(phys);
+            isAllocated = true;
+            break;
+         }
+      }
+      if (!isAllocated) {
+         auto victim = active.end();
+         for (auto it = active.begin(); it != active.end(); it++) {
+            if ((it->second != ECX || canUseEcx) && end[it->first] > end[reg] && (victim == active.end() || end[it->first] > end[victim->first])) {
+               victim = it;
+            }
+         }
+         if (victim != active.end()) {
+            locations[reg] = new AsmRegister(victim->second);
+            spilled.push_back(victim->first);
+            *victim = make_pair(reg, victim->second);
+         } else {
+            spilled.push_back(reg);
+         }
+      }
+   }
+   for (auto &reg : spilled) {
+      locations[reg] = new AsmMemory(EBP, function->AllocFrame(4).value, szDWORD);
+   }
+}
+
+AsmLabel* IrLowering::GetLabel(IrBlock* block)
+{
+   auto it = labels.find(block);
+   if (it == labels.end()) {
+      it = labels.insert(make_pair(block, asmCode.GenLabel("bb"))).first;
+   }
+   return it->second;
+}
+
+bool IrLowering::IsMemory(AsmOperand* oper) const
+{
+   return TryToCastOperand<AsmMemory>(oper);
+}
+
+AsmOperand* IrLowering::Src(const IrOperand& oper, Register tmp)
+{
+   switch (oper.kind) {
+      case ioReg:
+         if (IsRegister(locations[oper.value])) {
+            return new AsmRegister(*CastOperand<AsmRegister>(locations[oper.value]));
+         }
+         return new AsmMemory(*CastOperand<AsmMemory>(locations[oper.value]));
+      case ioImm:
+         return new AsmIntImmediate(oper.value, szNONE);
+      case ioAddr:
+         return new AsmVarAddr(oper.label, oper.value);
+      default:
+         asmCode.AddCmd(LEA, tmp, AsmMemory(EBP, oper.value));
+         return new AsmRegister(tmp);
+   }
+}
+
+AsmMemory IrLowering::Mem(const IrOperand& base, int offset, Register tmp)
+{
+   switch (base.kind) {
+      case ioFrame:
+         return AsmMemory(EBP, base.value + offset, szDWORD);
+      case ioAddr:
+         return AsmMemory(base.label, base.value + offset, szDWORD);
+      default:
+         AsmOperand* addr = Src(base, tmp);
+         if (!IsRegister(addr)) {
+            Move(new AsmRegister(tmp), addr);
+            addr = new AsmRegister(tmp);
+         }
+         return AsmMemory(*CastOperand<AsmRegister>(addr), offset, szDWORD);
+   }
+}
+
+void IrLowering::Move(AsmOperand* dst, AsmOperand* src)
+{
+   if (CmpOperands(dst, src)) return;
+   if (IsMemory(dst) && IsMemory(src)) {
+      asmCode.AddCmd(MOV, AsmRegister(EAX), src);
+      asmCode.AddCmd(MOV, dst, new AsmRegister(EAX));
+   } else {
+      asmCode.AddCmd(MOV, dst, src);
+   }
+}
+
+void IrLowering::LoadAddress(Register reg, const IrOperand& addr)
+{
+   if (addr.kind == ioFrame) {
+      asmCode.AddCmd(LEA, reg, AsmMemory(EBP, addr.value));
+   } else {
+      Move(new AsmRegister(reg), Src(addr, reg));
+   }
+}
+
+void IrLowering::CopyMemory(size_t size)
+{
+   size_t count = (size + 3) / 4;
+   if (count <= 8) {
+      for (size_t i = 0; i < count; i++) {
+         asmCode.AddCmd(PUSH, AsmMemory(EDX, i * 4, szDWORD));
+         asmCode.AddCmd(POP, AsmMemory(EAX, i * 4, szDWORD));
+      }
+   } else {
+      AsmLabel* labelBegin = asmCode.GenLabel("copy");
+      asmCode.AddCmd(PUSH, ECX);
+      asmCode.AddCmd(MOV, ECX, count);
+      asmCode.AddLabel(labelBegin);
+      asmCode.AddCmd(PUSH, AsmMemory(EDX, 0, szDWORD));
+      asmCode.AddCmd(POP, AsmMemory(EAX, 0, szDWORD));
+      asmCode.AddCmd(ADD, EDX, 4);
+      asmCode.AddCmd(ADD, EAX, 4);
+      asmCode.AddCmd(DEC, ECX);
+      asmCode.AddCmd(JNE, labelBegin);
+      asmCode.AddCmd(POP, ECX);
+   }
+}
+
+void IrLowering::LowerBinary(const IrInstr& instr)
+{
+   OpCode op = GetIntOpCode(instr.op);
+   bool isCommutative = instr.op != irSub;
+   AsmOperand* dst = Src(instr.dst, EAX);
+   AsmOperand* right = instr.b.IsReg() ? Src(instr.b, EDX) : nullptr;
+   if (IsRegister(dst) && (right == nullptr || !CmpOperands(dst, right))) {
+      Move(dst, Src(instr.a, EAX));
+      asmCode.AddCmd(op, dst, Src(instr.b, EDX));
+   } else if (IsRegister(dst) && isCommutative) {
+      asmCode.AddCmd(op, dst, Src(instr.a, EAX));
+   } else {
+      Move(new AsmRegister(EAX), Src(instr.a, EAX));
+      asmCode.AddCmd(op, new AsmRegister(EAX), Src(instr.b, EDX));
+      Move(dst, new AsmRegister(EAX));
+   }
+}
+
+void IrLowering::LowerDivision(const IrInstr& instr)
+{
+   Move(new AsmRegister(EAX), Src(instr.a, EAX));
+   AsmOperand* divisor = Src(instr.b, EDX);
+   if (!IsRegister(divisor) && !IsMemory(divisor)) {
+      asmCode.AddCmd(MOV, new AsmMemory(*scratch), divisor);
+      divisor = new AsmMemory(*scratch);
+   }
+   asmCode.AddCmd(CDQ);
+   asmCode.AddCmd(IDIV, divisor);
+   Move(Src(instr.dst, EAX), new AsmRegister(instr.op == irDiv ? EAX : EDX));
+}
+
+void IrLowering::LowerShift(const IrInstr& instr)
+{
+   OpCode op = GetIntOpCode(instr.op);
+   Move(new AsmRegister(EAX), Src(instr.a, EAX));
+   if (instr.b.IsImm()) {
+      asmCode.AddCmd(op, EAX, instr.b.value);
+   } else {
+      asmCode.AddCmd(PUSH, ECX);
+      Move(new AsmRegister(ECX), Src(instr.b, EDX));
+      asmCode.AddCmd(op, EAX, CL);
+      asmCode.AddCmd(POP, ECX);
+   }
+   Move(Src(instr.dst, EAX), new AsmRegister(EAX));
+}
+
+void IrLowering::Compare(const IrInstr& instr)
+{
+   if (instr.op >= irFSetEq) {
+      asmCode.AddCmd(FLD, Src(instr.a, EAX));
+      asmCode.AddCmd(FLD, Src(instr.b, EAX));
+      asmCode.AddCmd(FCOMPP);
+      asmCode.AddCmd(FNSTSW, AX);
+      asmCode.AddCmd(SAHF);
+      return;
+   }
+   AsmOperand* left = Src(instr.a, EAX);
+   AsmOperand* right = Src(instr.b, EDX);
+   if (!IsRegister(left) && !(IsMemory(left) && !IsMemory(right))) {
+      Move(new AsmRegister(EAX), left);
+      left = new AsmRegister(EAX);
+   }
+   asmCode.AddCmd(CMP, left, right);
+}
+
+void IrLowering::LowerSet(const IrInstr& instr)
+{
+   Compare(instr);
+   asmCode.AddCmd(GetSetOpCode(instr.op), AL);
+   MoveFlag(Src(instr.dst, EAX));
+}
+
+void IrLowering::MoveFlag(AsmOperand* dst)
+{
+   if (IsRegister(dst)) {
+      asmCode.AddCmd(MOVZX, *CastOperand<AsmRegister>(dst), new AsmRegister(AL));
+   } else {
+      asmCode.AddCmd(MOVZX, EAX, AL);
+      Move(dst, new AsmRegister(EAX));
+   }
+}
+
+void IrLowering::LowerReal(const IrInstr& instr)
+{
+   asmCode.AddCmd(FLD, Src(instr.a, EAX));
+   if (instr.op == irFNeg) {
+      asmCode.AddCmd(FCHS);
+   } else {
+      asmCode.AddCmd(FLD, Src(instr.b, EAX));
+      asmCode.AddCmd(GetRealOpCode(instr.op), ST1, ST);
+   }
+   asmCode.AddCmd(FSTP, Src(instr.dst, EAX));
+}
+
+void IrLowering::LowerIntToReal(const IrInstr& instr)
+{
+   AsmOperand* value = Src(instr.a, EAX);
+   if (!IsMemory(value)) {
+      asmCode.AddCmd(MOV, new AsmMemory(*scratch), value);
+      value = new AsmMemory(*scratch);
+   }
+   asmCode.AddCmd(FILD, value);
+   asmCode.AddCmd(FSTP, Src(instr.dst, EAX));
+}
+
+//a comparison only used by the branch after it sets the flags the branch jumps on
+void IrLowering::LowerCompareBranch(const IrInstr& cmp, const IrInstr& instr)
+{
+   Compare(cmp);
+   pair<OpCode, OpCode> jumps = GetJumpOpCodes(cmp.op);
+   if (instr.target == nextBlock) {
+      asmCode.AddCmd(jumps.second, GetLabel(instr.alt));
+   } else {
+      asmCode.AddCmd(jumps.first, GetLabel(instr.target));
+      if (instr.alt != nextBlock) {
+         asmCode.AddCmd(JMP, GetLabel(instr.alt));
+      }
+   }
+}
+
+void IrLowering::LowerBranch(const IrInstr& instr)
+{
+   if (instr.a.IsImm()) {
+      IrBlock* target = instr.a.value ? instr.target : instr.alt;
+      if (target != nextBlock) {
+         asmCode.AddCmd(JMP, GetLabel(target));
+      }
+      return;
+   }
+   AsmOperand* cond = Src(instr.a, EAX);
+   if (IsRegister(cond)) {
+      asmCode.AddCmd(TEST, cond, cond);
+   } else {
+      asmCode.AddCmd(CMP, cond, new AsmIntImmediate(0, szNONE));
+   }
+   if (instr.target == nextBlock) {
+      asmCode.AddCmd(JE, GetLabel(instr.alt));
+   } else {
+      asmCode.AddCmd(JNE, GetLabel(instr.target));
+      if (instr.alt != nextBlock) {
+         asmCode.AddCmd(JMP, GetLabel(instr.alt));
+      }
+   }
+}
+
+//the unsigned comparison sends values below the first case to the default as well
+void IrLowering::LowerSwitch(const IrInstr& instr)
+{
+   Move(new AsmRegister(EAX), Src(instr.a, EAX));
+   if (instr.offset) {
+      asmCode.AddCmd(SUB, EAX, instr.offset);
+   }
+   asmCode.AddCmd(CMP, EAX, int(instr.cases.size() - 1));
+   asmCode.AddCmd(JA, GetLabel(instr.alt));
+   vector<AsmLabel*> table;
+   for (auto &target : instr.cases) {
+      table.push_back(GetLabel(target));
+   }
+   asmCode.AddCmd(JMP, new AsmMemory(asmCode.AddData(table), EAX, 4, 0, szDWORD));
+}
+
+//an index below the low bound wraps around to a big unsigned number, so one compare does
+void IrLowering::LowerCheck(const IrInstr& instr)
+{
+   AsmOperand* value = Src(instr.a, EAX);
+   if (instr.offset || instr.a.IsImm()) {
+      Move(new AsmRegister(EAX), value);
+      if (instr.offset) {
+         asmCode.AddCmd(SUB, EAX, instr.offset);
+      }
+      value = new AsmRegister(EAX);
+   }
+   asmCode.AddCmd(CMP, value, new AsmIntImmediate(instr.size));
+   asmCode.AddCmd(JA, asmCode.GetRangeErrorLabel());
+}
+
+void IrLowering::Lower(const IrInstr& instr)
+{
+   switch (instr.op) {
+      case irMov:
+         Move(Src(instr.dst, EAX), Src(instr.a, EAX));
+         break;
+      case irAdd:
+      case irSub:
+      case irMul:
+      case irAnd:
+      case irOr:
+      case irXor:
+         LowerBinary(instr);
+         break;
+      case irDiv:
+      case irMod:
+         LowerDivision(instr);
+         break;
+      case irShl:
+      case irShr:
+         LowerShift(instr);
+         break;
+      case irNeg:
+         {
+            AsmOperand* dst = Src(instr.dst, EAX);
+            Move(dst, Src(instr.a, EAX));
+            asmCode.AddCmd(NEG, dst);
+         }
+         break;
+      case irSetEq:
+      case irSetNe:
+      case irSetLt:
+      case irSetLe:
+      case irSetGt:
+      case irSetGe:
+         LowerSet(instr);
+         break;
+      case irFAdd:
+      case irFSub:
+      case irFMul:
+      case irFDiv:
+      case irFNeg:
+         LowerReal(instr);
+         break;
+      case irFSetEq:
+      case irFSetNe:
+      case irFSetLt:
+      case irFSetLe:
+      case irFSetGt:
+      case irFSetGe:
+         LowerSet(instr);
+         break;
+      case irIntToReal:
+         LowerIntToReal(instr);
+         break;
+      case irLoad:
+         {
+            AsmMemory mem = Mem(instr.a, instr.offset, EDX);
+            AsmOperand* dst = Src(instr.dst, EAX);
+            if (IsRegister(dst)) {
+               asmCode.AddCmd(MOV, dst, new AsmMemory(mem));
+            } else {
+               asmCode.AddCmd(MOV, EAX, mem);
+               asmCode.AddCmd(MOV, dst, new AsmRegister(EAX));
+            }
+         }
+         break;
+      case irStore:
+         {
+            AsmMemory mem = Mem(instr.a, instr.offset, EDX);
+            AsmOperand* value = Src(instr.b, EAX);
+            if (IsMemory(value)) {
+               asmCode.AddCmd(MOV, AsmRegister(EAX), value);
+               value = new AsmRegister(EAX);
+            }
+            asmCode.AddCmd(MOV, mem, value);
+         }
+         break;
+      case irCopy:
+         LoadAddress(EAX, instr.a);
+         LoadAddress(EDX, instr.b);
+         CopyMemory(instr.size);
+         break;
+      case irAlloc:
+         asmCode.AddCmd(SUB, ESP, instr.size);
+         break;
+      case irPush:
+         asmCode.AddCmd(PUSH, Src(instr.a, EAX));
+         break;
+      case irPushBlock:
+         LoadAddress(EDX, instr.a);
+         if (instr.size <= 16) {
+            for (int i = (instr.size + 3) / 4 - 1; i >= 0; i--) {
+               asmCode.AddCmd(PUSH, AsmMemory(EDX, i * 4, szDWORD));
+            }
+         } else {
+            asmCode.AddCmd(SUB, ESP, (instr.size + 3) / 4 * 4);
+            asmCode.AddCmd(MOV, EAX, ESP);
+            CopyMemory(instr.size);
+         }
+         break;
+      case irCall:
+         if (instr.a.kind == ioFrame && instr.a.value == 0) {
+            asmCode.AddCmd(PUSH, EBP);
+         } else {
+            asmCode.AddCmd(PUSH, Src(instr.a, EAX));
+         }
+         asmCode.AddCmd(CALL, instr.callee);
+         if (instr.size > 0) {
+            asmCode.AddCmd(ADD, ESP, instr.size);
+         }
+         break;
+      case irPop:
+         asmCode.AddCmd(POP, Src(instr.dst, EAX));
+         break;
+      case irPopBlock:
+         LoadAddress(EAX, instr.a);
+         asmCode.AddCmd(MOV, EDX, ESP);
+         CopyMemory(instr.size);
+         asmCode.AddCmd(ADD, ESP, (instr.size + 3) / 4 * 4);
+         break;
+      case irWriteInt:
+         asmCode.AddCmd(PUSH, Src(instr.a, EAX));
+         asmCode.GenCallWriteForInt();
+         break;
+      case irWriteReal:
+         asmCode.GenCallWriteForReal(Src(instr.a, EAX));
+         break;
+      case irWriteStr:
+         asmCode.AddCmd(PUSH, Src(instr.a, EAX));
+         asmCode.GenCallWriteForStr();
+         break;
+      case irWriteLn:
+         asmCode.GenWriteNewLine();
+         break;
+      case irCheck:
+         LowerCheck(instr);
+         break;
+      case irJump:
+         if (instr.target != nextBlock) {
+            asmCode.AddCmd(JMP, GetLabel(instr.target));
+         }
+         break;
+      case irBranch:
+         LowerBranch(instr);
+         break;
+      case irSwitch:
+         LowerSwitch(instr);
+         break;
+   }
+}
+
+//the writes from first to last are one call of the runtime with their values and kinds
+void IrLowering::LowerWrites(const IrInstrs& instrs, size_t first, size_t last)
+{
+   string kinds;
+   for (size_t i = last; i-- > first;) {
+      const IrInstr& instr = instrs[i];
+      switch (instr.op) {
+         case irWriteInt:  kinds = 'i' + kinds; break;
+         case irWriteReal: kinds = 'r' + kinds; break;
+         case irWriteStr:  kinds = 's' + kinds; break;
+         default:          kinds = 'n' + kinds; break;
+      }
+      if (instr.op != irWriteLn) {
+         asmCode.AddCmd(PUSH, Src(instr.a, EAX));
+      }
+   }
+   asmCode.GenCallWriteList(kinds);
+}
+
+void IrLowering::GeneratePrologue()
+{
+   if (function->label != nullptr) {
+      asmCode.AddSubroutineBegin(function->label);
+      asmCode.AddCmd(PUSH, EBP);
+   } else {
+      asmCode.AddCmd("main:");
+   }
+   asmCode.AddCmd(MOV, EBP, ESP);
+   if (function->frameSize > 0) {
+      asmCode.AddCmd(SUB, ESP, function->frameSize);
+   }
+}
+
+void IrLowering::GenerateEpilogue()
+{
+   asmCode.AddCmd(MOV, ESP, EBP);
+   if (function->label != nullptr) {
+      asmCode.AddCmd(POP, EBP);
+      asmCode.AddCmd(RET, 4, szBYTE);
+      asmCode.AddSubroutineEnd(function->label);
+   } else {
+      asmCode.GenFlushWrites();
+      asmCode.AddCmd(MOV, EAX, 0);
+      asmCode.AddCmd(RET);
+   }
+}
+
+void IrLowering::Lower(IrFunction* AFunction)
+{
+   function = AFunction;
+   scratch = nullptr;
+   labels.clear();
+   locations = Locations(function->regTypes.size(), nullptr);
+   useCounts = vector<int>(function->regTypes.size(), 0);
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         for (auto &reg : instr.GetUses()) {
+            useCounts[reg]++;
+         }
+      }
+   }
+   Allocate();
+   for (auto &block : function->blocks) {
+      for (auto &succ : block->GetSuccessors()) {
+         GetLabel(succ);
+      }
+   }
+   GeneratePrologue();
+   for (size_t i = 0; i < function->blocks.size(); i++) {
+      IrBlock* block = function->blocks[i];
+      nextBlock = i + 1 < function->blocks.size() ? function->blocks[i + 1] : nullptr;
+      if (labels.count(block)) {
+         asmCode.AddLabel(labels[block]);
+      }
+      IrInstrs& instrs = block->instrs;
+      for (size_t j = 0; j < instrs.size(); j++) {
+         if (j + 1 < instrs.size() && IsComparison(instrs[j].op) && instrs[j + 1].op == irBranch
+            && instrs[j + 1].a == instrs[j].dst && useCounts[instrs[j].dst.value] == 1) {
+            LowerCompareBranch(instrs[j], instrs[j + 1]);
+            j++;
+         } else if (IsWrite(instrs[j].op) && GetWritesEnd(instrs, j) - j >= WRITE_LIST_MIN) {
+            size_t last = GetWritesEnd(instrs, j);
+            LowerWrites(instrs, j, last);
+            j = last - 1;
+         } else {
+            Lower(instrs[j]);
+         }
+      }
+   }
+   GenerateEpilogue();
+}
+
+void IrLowering::Lower(IrProgram& program)
+{
+   for (auto &function : program.functions) {
+      Lower(function);
+   }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ir.h"
+
+class IrLowering {
+   typedef vector<AsmOperand*> Locations;
+
+   AsmCode& asmCode;
+   IrFunction* function;
+   Locations locations;
+   vector<int> useCounts;
+   AsmMemory* scratch;
+   unordered_map<IrBlock*, AsmLabel*> labels;
+   IrBlock* nextBlock;
+
+   void Allocate();
+   AsmLabel* GetLabel(IrBlock*);
+   bool IsMemory(AsmOperand*) const;
+   AsmOperand* Src(const IrOperand&, Register);
+   AsmMemory Mem(const IrOperand&, int, Register);
+   void Move(AsmOperand*, AsmOperand*);
+   void MoveFlag(AsmOperand*);
+   void LoadAddress(Register, const IrOperand&);
+   void CopyMemory(size_t);
+   void LowerBinary(const IrInstr&);
+   void LowerDivision(const IrInstr&);
+   void LowerShift(const IrInstr&);
+   void Compare(const IrInstr&);
+   void LowerSet(const IrInstr&);
+   void LowerReal(const IrInstr&);
+   void LowerIntToReal(const IrInstr&);
+   void LowerCompareBranch(const IrInstr&, const IrInstr&);
+   void LowerBranch(const IrInstr&);
+   void LowerSwitch(const IrInstr&);
+   void LowerCheck(const IrInstr&);
+   void LowerWrites(const IrInstrs&, size_t, size_t);
+   void Lower(const IrInstr&);
+   void GeneratePrologue();
+   void GenerateEpilogue();
+public:
+   IrLowering(AsmCode&);
+   void Lower(IrFunction*);
+   void Lower(IrProgram&);
+};
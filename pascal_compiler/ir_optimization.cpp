@@ -0,0 +1,1372 @@
+#include <algorithm>
+#include <climits>
+#include "ir_optimization.h"
+
+static string GetOperandKey(const IrOperand& oper)
+{
+   return to_string(oper.kind) + ':' + to_string(oper.value) + ':' + (oper.label != nullptr ? oper.label->GetStrValue() : "");
+}
+
+static bool IsCommutative(IrOpCode op)
+{
+   switch (op) {
+      case irAdd: case irMul: case irAnd: case irOr: case irXor: case irSetEq: case irSetNe:
+      case irFAdd: case irFMul: case irFSetEq: case irFSetNe:
+         return true;
+      default:
+         return false;
+   }
+}
+
+//arithmetic wraps around and shift counts are taken mod 32 as by add, imul, shl and shr
+static int WrapAdd(int a, int b)
+{
+   return int(unsigned(a) + unsigned(b));
+}
+
+static int WrapMul(int a, int b)
+{
+   return int(unsigned(a) * unsigned(b));
+}
+
+static bool Fold(IrOpCode op, const IrOperand& a, const IrOperand& b, int& result)
+{
+   if (op == irNeg && a.IsImm()) {
+      result = int(0u - unsigned(a.value));
+      return true;
+   }
+   if (!a.IsImm() || !b.IsImm()) return false;
+   switch (op) {
+      case irAdd:   result = WrapAdd(a.value, b.value); break;
+      case irSub:   result = int(unsigned(a.value) - unsigned(b.value)); break;
+      case irMul:   result = WrapMul(a.value, b.value); break;
+      case irAnd:   result = a.value & b.value; break;
+      case irOr:    result = a.value | b.value; break;
+      case irXor:   result = a.value ^ b.value; break;
+      case irShl:   result = int(unsigned(a.value) << (b.value & 31)); break;
+      case irShr:   result = unsigned(a.value) >> (b.value & 31); break;
+      case irSetEq: result = a.value == b.value; break;
+      case irSetNe: result = a.value != b.value; break;
+      case irSetLt: result = a.value < b.value; break;
+      case irSetLe: result = a.value <= b.value; break;
+      case irSetGt: result = a.value > b.value; break;
+      case irSetGe: result = a.value >= b.value; break;
+      default:      return false;
+   }
+   return true;
+}
+
+static bool Overlaps(const IrOperand& base1, int offset1, size_t size1, const IrOperand& base2, int offset2, size_t size2)
+{
+   if (base1.IsReg() || base2.IsReg()) {
+      if (!base1.IsReg() || !base2.IsReg() || base1.value != base2.value) return true;
+   } else if (base1.kind != base2.kind || (base1.kind == ioAddr && base1.label->GetStrValue() != base2.label->GetStrValue())) {
+      return false;
+   } else {
+      offset1 += base1.value;
+      offset2 += base2.value;
+   }
+   return offset1 < offset2 + int(size2) && offset2 < offset1 + int(size1);
+}
+
+//merges what two values may point into, see GetBase
+static IrOperand MergeBases(const IrOperand& base1, const IrOperand& base2)
+{
+   if (base1.IsImm() || GetOperandKey(base1) == GetOperandKey(base2)) return base2;
+   return base2.IsImm() ? base1 : IrOperand();
+}
+
+//address of a variable accessed directly, with the offset folded in
+static IrOperand GetAddress(const IrInstr& instr)
+{
+   IrOperand result = instr.a;
+   if (!result.IsReg()) {
+      result.value += instr.offset;
+   }
+   return result;
+}
+
+IrOptimizator::IrOptimizator(size_t AInlineThreshold):
+   function(nullptr),
+   inlineThreshold(AInlineThreshold)
+{
+   optimizations.push_back(&IrOptimizator::FoldBranches);
+   optimizations.push_back(&IrOptimizator::ThreadJumps);
+   optimizations.push_back(&IrOptimizator::RemoveUnreachableBlocks);
+   optimizations.push_back(&IrOptimizator::MergeBlocks);
+}
+
+void IrOptimizator::ComputePredecessors()
+{
+   predecessors.clear();
+   for (auto &block : function->blocks) {
+      for (auto &succ : block->GetSuccessors()) {
+         predecessors[succ].push_back(block);
+      }
+   }
+}
+
+void IrOptimizator::ComputeDominators()
+{
+   ComputePredecessors();
+   IrBlocks order;
+   unordered_set<IrBlock*> visited;
+   vector<pair<IrBlock*, size_t>> stack(1, make_pair(function->entry, 0));
+   visited.insert(function->entry);
+   while (!stack.empty()) {
+      IrBlock* block = stack.back().first;
+      vector<IrBlock*> succs = block->GetSuccessors();
+      if (stack.back().second < succs.size()) {
+         IrBlock* succ = succs[stack.back().second++];
+         if (visited.insert(succ).second) {
+            stack.push_back(make_pair(succ, 0));
+         }
+      } else {
+         order.push_back(block);
+         stack.pop_back();
+      }
+   }
+   reverse(order.begin(), order.end());
+   unordered_map<IrBlock*, size_t> index;
+   for (size_t i = 0; i < order.size(); i++) {
+      index[order[i]] = i;
+   }
+   auto intersect = [&](IrBlock* a, IrBlock* b) {
+      while (a != b) {
+         while (index[a] > index[b]) a = dominators[a];
+         while (index[b] > index[a]) b = dominators[b];
+      }
+      return a;
+   };
+   dominators.clear();
+   dominators[function->entry] = function->entry;
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (size_t i = 1; i < order.size(); i++) {
+         IrBlock* idom = nullptr;
+         for (auto &pred : predecessors[order[i]]) {
+            if (dominators.count(pred)) {
+               idom = idom != nullptr ? intersect(pred, idom) : pred;
+            }
+         }
+         if (dominators[order[i]] != idom) {
+            dominators[order[i]] = idom;
+            isChanged = true;
+         }
+      }
+   }
+   dominatorTree.clear();
+   for (size_t i = 1; i < order.size(); i++) {
+      dominatorTree[dominators[order[i]]].push_back(order[i]);
+   }
+}
+
+void IrOptimizator::RemoveBlock(IrBlock* block)
+{
+   function->blocks.erase(find(function->blocks.begin(), function->blocks.end(), block));
+}
+
+//end of a chain of empty blocks which only jump further, nullptr for a cycle
+IrBlock* IrOptimizator::GetJumpTarget(IrBlock* block) const
+{
+   for (size_t i = 0; i <= function->blocks.size(); i++) {
+      if (block->instrs.size() != 1 || block->instrs[0].op != irJump) {
+         return block;
+      }
+      block = block->instrs[0].target;
+   }
+   return nullptr;
+}
+
+//branch on a constant or to the same block twice is a plain jump, so is a switch on a constant
+bool IrOptimizator::FoldBranches()
+{
+   bool result = false;
+   for (auto &block : function->blocks) {
+      if (!block->IsTerminated()) continue;
+      IrInstr& last = block->instrs.back();
+      if (last.op == irBranch && (last.a.IsImm() || last.target == last.alt)) {
+         IrBlock* target = !last.a.IsImm() || last.a.value ? last.target : last.alt;
+         last = IrInstr(irJump);
+         last.target = target;
+         result = true;
+      } else if (last.op == irSwitch && last.a.IsImm()) {
+         size_t index = last.a.value - last.offset;
+         IrBlock* target = index < last.cases.size() ? last.cases[index] : last.alt;
+         last = IrInstr(irJump);
+         last.target = target;
+         result = true;
+      }
+   }
+   return result;
+}
+
+bool IrOptimizator::ThreadJumps()
+{
+   bool result = false;
+   auto thread = [&](IrBlock*& target) {
+      IrBlock* end = target != nullptr ? GetJumpTarget(target) : nullptr;
+      if (end != nullptr && end != target) {
+         target = end;
+         result = true;
+      }
+   };
+   for (auto &block : function->blocks) {
+      if (!block->IsTerminated()) continue;
+      IrInstr& last = block->instrs.back();
+      thread(last.target);
+      thread(last.alt);
+      for (auto &target : last.cases) {
+         thread(target);
+      }
+   }
+   return result;
+}
+
+bool IrOptimizator::RemoveUnreachableBlocks()
+{
+   unordered_set<IrBlock*> reached;
+   vector<IrBlock*> queue(1, function->entry);
+   reached.insert(function->entry);
+   while (!queue.empty()) {
+      IrBlock* block = queue.back();
+      queue.pop_back();
+      for (auto &succ : block->GetSuccessors()) {
+         if (reached.insert(succ).second) {
+            queue.push_back(succ);
+         }
+      }
+   }
+   size_t size = function->blocks.size();
+   function->blocks.erase(remove_if(function->blocks.begin(), function->blocks.end(), [&](IrBlock* block) {
+      return block != function->exit && reached.count(block) == 0;
+   }), function->blocks.end());
+   return size != function->blocks.size();
+}
+
+//a jump to a block with no other predecessors glues the two blocks together
+bool IrOptimizator::MergeBlocks()
+{
+   ComputePredecessors();
+   for (auto &block : function->blocks) {
+      if (!block->IsTerminated() || block->instrs.back().op != irJump) continue;
+      IrBlock* succ = block->instrs.back().target;
+      if (succ == block || succ == function->entry || succ == function->exit || predecessors[succ].size() != 1) continue;
+      block->instrs.pop_back();
+      block->instrs.insert(block->instrs.end(), succ->instrs.begin(), succ->instrs.end());
+      RemoveBlock(succ);
+      return true;
+   }
+   return false;
+}
+
+void IrOptimizator::Retarget(IrBlock* block, IrBlock* from, IrBlock* to)
+{
+   IrInstr& last = block->instrs.back();
+   if (last.target == from) {
+      last.target = to;
+   }
+   if (last.alt == from) {
+      last.alt = to;
+   }
+   replace(last.cases.begin(), last.cases.end(), from, to);
+}
+
+//puts an empty block on the edge, so code can run only when control goes from one block to the other
+IrBlock* IrOptimizator::SplitEdge(IrBlock* from, IrBlock* to)
+{
+   IrBlock* result = function->NewBlock();
+   IrInstr jump(irJump);
+   jump.target = to;
+   result->instrs.push_back(jump);
+   Retarget(from, to, result);
+   function->blocks.insert(find(function->blocks.begin(), function->blocks.end(), to), result);
+   return result;
+}
+
+unordered_map<int, int> IrOptimizator::CountDefinitions() const
+{
+   unordered_map<int, int> result;
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         if (instr.GetDef() >= 0) {
+            result[instr.GetDef()]++;
+         }
+      }
+   }
+   return result;
+}
+
+vector<IrPosition> IrOptimizator::GetUses(int reg) const
+{
+   vector<IrPosition> result;
+   for (auto &block : function->blocks) {
+      for (size_t i = 0; i < block->instrs.size(); i++) {
+         vector<int> uses = block->instrs[i].GetUses();
+         if (find(uses.begin(), uses.end(), reg) != uses.end()) {
+            result.push_back(make_pair(block, i));
+         }
+      }
+   }
+   return result;
+}
+
+void IrOptimizator::ReplaceUses(int reg, const IrOperand& value)
+{
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         if (instr.a.IsReg() && instr.a.value == reg) {
+            instr.a = value;
+         }
+         if (instr.b.IsReg() && instr.b.value == reg) {
+            instr.b = value;
+         }
+      }
+   }
+}
+
+//whether reg may be assigned on a path from one instruction to another, which the first dominates
+bool IrOptimizator::IsRedefined(int reg, IrPosition from, IrPosition to)
+{
+   unordered_set<IrBlock*> visited;
+   vector<IrPosition> stack(1, to);
+   while (!stack.empty()) {
+      IrBlock* block = stack.back().first;
+      size_t end = stack.back().second;
+      stack.pop_back();
+      bool isStart = block == from.first && end > from.second;
+      for (size_t i = isStart ? from.second + 1 : 0; i < end; i++) {
+         if (block->instrs[i].GetDef() == reg) return true;
+      }
+      if (isStart) continue;
+      for (auto &pred : predecessors[block]) {
+         if (visited.insert(pred).second) {
+            stack.push_back(make_pair(pred, pred->instrs.size()));
+         }
+      }
+   }
+   return false;
+}
+
+//what a value may point into: a global, the locals or the arguments of the own frame or of an inlined callee,
+//IrImm for no pointer at all and IrOperand() for anything else; pascal has no pointers
+//but the static links and var params, which live at offsets from 8 on in a frame and
+//never point into the own frame, and an address plus an integer stays in its variable
+IrOperand IrOptimizator::GetBase(const IrOperand& oper) const
+{
+   switch (oper.kind) {
+      case ioAddr:
+         return IrAddr(oper.label);
+      case ioFrame:
+         return IrFrame(function->GetRegion(oper.value));
+      case ioReg:
+         {
+            auto it = bases.find(oper.value);
+            return it != bases.end() ? it->second : IrImm(0);
+         }
+      default:
+         return IrImm(0);
+   }
+}
+
+static bool IsKnownBase(const IrOperand& base)
+{
+   return base.kind == ioAddr || base.kind == ioFrame;
+}
+
+IrOperand IrOptimizator::GetInstrBase(const IrInstr& instr) const
+{
+   switch (instr.op) {
+      case irMov:
+         return GetBase(instr.a);
+      case irAdd:
+         if (IsKnownBase(GetBase(instr.a)) || GetBase(instr.b).IsImm()) return GetBase(instr.a);
+         return IsKnownBase(GetBase(instr.b)) || GetBase(instr.a).IsImm() ? GetBase(instr.b) : IrOperand();
+      case irSub:
+         return GetBase(instr.b).IsImm() ? GetBase(instr.a) : IrOperand();
+      case irLoad:
+         {
+            int offset = instr.a.IsReg() ? instr.offset : GetAddress(instr).value;
+            return instr.a.kind == ioAddr || offset < 8 ? IrImm(0) : IrOperand();
+         }
+      default:
+         return IrImm(0);
+   }
+}
+
+void IrOptimizator::ComputeBases()
+{
+   bases.clear();
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto &block : function->blocks) {
+         for (auto &instr : block->instrs) {
+            if (instr.GetDef() < 0) continue;
+            IrOperand base = MergeBases(GetBase(instr.dst), GetInstrBase(instr));
+            if (GetOperandKey(base) != GetOperandKey(GetBase(instr.dst))) {
+               bases[instr.GetDef()] = base;
+               isChanged = true;
+            }
+         }
+      }
+   }
+}
+
+//accesses through different registers can only overlap when they may point into the same variable
+bool IrOptimizator::MayAlias(const IrOperand& addr1, int offset1, size_t size1, const IrOperand& addr2, int offset2, size_t size2) const
+{
+   if ((!addr1.IsReg() && !addr2.IsReg()) || (addr1.IsReg() && addr2.IsReg() && addr1.value == addr2.value)) {
+      return Overlaps(addr1, offset1, size1, addr2, offset2, size2);
+   }
+   IrOperand base1 = GetBase(addr1), base2 = GetBase(addr2);
+   if (base1.IsImm() || base2.IsImm()) return true;
+   if (base1.kind == ioFrame || base2.kind == ioFrame) return GetOperandKey(base1) == GetOperandKey(base2);
+   return !IsKnownBase(base1) || !IsKnownBase(base2) || GetOperandKey(base1) == GetOperandKey(base2);
+}
+
+//whether the instruction reads or writes the integer variable at addr
+bool IrOptimizator::MayAccess(const IrInstr& instr, const IrOperand& addr) const
+{
+   switch (instr.op) {
+      case irLoad:
+      case irStore:
+         return MayAlias(instr.a, instr.offset, 4, addr, 0, 4);
+      case irCopy:
+         return MayAlias(instr.a, instr.offset, instr.size, addr, 0, 4) || MayAlias(instr.b, 0, instr.size, addr, 0, 4);
+      case irPushBlock:
+      case irPopBlock:
+         return MayAlias(instr.a, 0, instr.size, addr, 0, 4);
+      case irWriteStr:
+         return !instr.a.IsImm() && MayAlias(instr.a, 0, 4, addr, 0, 4);
+      case irCall:
+         return true;
+      default:
+         return false;
+   }
+}
+
+const IrInstr* IrOptimizator::GetDefinition(const IrOperand& oper, IrOpCode op) const
+{
+   auto it = oper.IsReg() ? definitions.find(oper.value) : definitions.end();
+   return it != definitions.end() && it->second.op == op ? &it->second : nullptr;
+}
+
+IrOperand IrOptimizator::Replace(IrOperand oper) const
+{
+   for (auto it = replacements.end(); oper.IsReg() && (it = replacements.find(oper.value)) != replacements.end();) {
+      oper = it->second;
+   }
+   return oper;
+}
+
+//folds constants and reassociates additions of constants outwards,
+//so a[j] and a[j - 1] share the address &a + j * size
+IrOperand IrOptimizator::Simplify(IrInstr& instr, IrInstrs& instrs, ValueTable& values)
+{
+   int folded;
+   if (instr.op == irMov) {
+      return instr.a;
+   }
+   if (Fold(instr.op, instr.a, instr.b, folded)) {
+      return IrImm(folded);
+   }
+   if (instr.op == irSub && instr.b.IsImm()) {
+      instr.op = irAdd;
+      instr.b = IrImm(int(0u - unsigned(instr.b.value)));
+   }
+   if (IsCommutative(instr.op) && (instr.a.IsImm() || (!instr.b.IsImm() && GetOperandKey(instr.b) < GetOperandKey(instr.a)))) {
+      swap(instr.a, instr.b);
+   }
+   if (instr.op == irAdd && instr.b.IsImm()) {
+      const IrInstr* def = GetDefinition(instr.a, irAdd);
+      if (def != nullptr && def->b.IsImm()) {
+         instr.b = IrImm(WrapAdd(def->b.value, instr.b.value));
+         instr.a = def->a;
+      }
+      if (instr.b.value == 0) {
+         return instr.a;
+      }
+      if (instr.a.kind == ioAddr || instr.a.kind == ioFrame) {
+         IrOperand result = instr.a;
+         result.value += instr.b.value;
+         return result;
+      }
+   } else if (instr.op == irAdd) {
+      for (int i = 0; i < 2; i++) {
+         const IrInstr* def = GetDefinition(instr.a, irAdd);
+         if (def != nullptr && def->b.IsImm()) {
+            IrOperand sum = NumberValue(IrInstr(irAdd, function->NewReg(itInt), def->a, instr.b), instrs, values);
+            instr.a = sum;
+            instr.b = def->b;
+            return Simplify(instr, instrs, values);
+         }
+         swap(instr.a, instr.b);
+      }
+   } else if (instr.op == irMul && instr.b.IsImm()) {
+      if (instr.b.value == 0 || instr.b.value == 1) {
+         return instr.b.value ? instr.a : IrImm(0);
+      }
+      const IrInstr* def = GetDefinition(instr.a, irAdd);
+      if (def != nullptr && def->b.IsImm()) {
+         IrOperand product = NumberValue(IrInstr(irMul, function->NewReg(itInt), def->a, instr.b), instrs, values);
+         instr = IrInstr(irAdd, instr.dst, product, IrImm(WrapMul(def->b.value, instr.b.value)));
+         return Simplify(instr, instrs, values);
+      }
+   }
+   return IrOperand();
+}
+
+IrOperand IrOptimizator::NumberValue(IrInstr instr, IrInstrs& instrs, ValueTable& values)
+{
+   IrOperand result = Simplify(instr, instrs, values);
+   if (!result.IsNone()) {
+      return result;
+   }
+   string key = to_string(instr.op) + ' ' + GetOperandKey(instr.a) + ' ' + GetOperandKey(instr.b);
+   auto it = values.find(key);
+   if (it != values.end()) {
+      return it->second;
+   }
+   values[key] = instr.dst;
+   definitions.insert(make_pair(instr.dst.value, instr));
+   bases.insert(make_pair(instr.dst.value, GetInstrBase(instr)));
+   instrs.push_back(instr);
+   return instr.dst;
+}
+
+//moves constant address arithmetic into the offset of a load or store
+void IrOptimizator::FoldAddress(IrInstr& instr) const
+{
+   for (const IrInstr* def; (def = GetDefinition(instr.a, irAdd)) != nullptr && def->b.IsImm();) {
+      instr.offset += def->b.value;
+      instr.a = def->a;
+   }
+   if (instr.a.kind == ioFrame || instr.a.kind == ioAddr) {
+      instr.a.value += instr.offset;
+      instr.offset = 0;
+   }
+}
+
+void IrOptimizator::KillLoads(LoadTable& loads, const IrInstr& instr) const
+{
+   if (instr.op == irCall) {
+      loads.clear();
+      return;
+   }
+   if (instr.op != irStore && instr.op != irCopy && instr.op != irPopBlock) return;
+   size_t size = instr.op == irStore ? 4 : instr.size;
+   for (auto it = loads.begin(); it != loads.end();) {
+      if (MayAlias(it->second.base, it->second.offset, 4, instr.a, instr.offset, size)) {
+         it = loads.erase(it);
+      } else {
+         it++;
+      }
+   }
+}
+
+//values are numbered along the dominator tree; loads are reused, and stored values
+//forwarded to later loads, only along single-predecessor chains where no store or
+//call can change memory in between, except static links which never change
+void IrOptimizator::NumberBlock(IrBlock* block, ValueTable values)
+{
+   vector<IrBlock*>& preds = predecessors[block];
+   LoadTable loads = preds.size() == 1 ? loadsOut[preds[0]] : LoadTable();
+   IrInstrs instrs;
+   for (auto instr : block->instrs) {
+      instr.a = Replace(instr.a);
+      instr.b = Replace(instr.b);
+      if (instr.op <= irIntToReal) {
+         IrOperand value = NumberValue(instr, instrs, values);
+         if (value != instr.dst) {
+            replacements[instr.dst.value] = value;
+         }
+         continue;
+      }
+      if (instr.op == irCheck) {
+         string key = "check " + GetOperandKey(instr.a) + ' ' + to_string(instr.offset) + ' ' + to_string(instr.size);
+         bool isInRange = instr.a.IsImm() && unsigned(instr.a.value - instr.offset) <= instr.size;
+         if (isInRange || values.count(key)) continue;
+         values[key] = instr.a;
+      }
+      if (instr.op == irLoad || instr.op == irStore) {
+         FoldAddress(instr);
+      }
+      if (instr.op == irLoad) {
+         string key = GetOperandKey(instr.a) + ' ' + to_string(instr.offset) + ' ' + to_string(function->GetType(instr.dst));
+         bool isStaticLink =
+               (instr.a.kind == ioFrame && instr.a.value == 8)
+            || (instr.a.IsReg() && staticLinks.count(instr.a.value) && instr.offset == 8);
+         if (isStaticLink && values.count(key)) {
+            replacements[instr.dst.value] = values[key];
+            continue;
+         }
+         if (!isStaticLink && loads.count(key)) {
+            replacements[instr.dst.value] = loads[key].value;
+            continue;
+         }
+         if (isStaticLink) {
+            values[key] = instr.dst;
+            staticLinks.insert(instr.dst.value);
+         } else {
+            IrAvailableLoad load = { instr.dst, instr.a, instr.offset };
+            loads[key] = load;
+         }
+      }
+      KillLoads(loads, instr);
+      if (instr.op == irStore) {
+         IrType type = instr.b.IsReg() ? function->GetType(instr.b) : itInt;
+         IrAvailableLoad load = { instr.b, instr.a, instr.offset };
+         loads[GetOperandKey(instr.a) + ' ' + to_string(instr.offset) + ' ' + to_string(type)] = load;
+      }
+      instrs.push_back(instr);
+   }
+   block->instrs = instrs;
+   loadsOut[block] = loads;
+   for (auto &child : dominatorTree[block]) {
+      NumberBlock(child, values);
+   }
+}
+
+void IrOptimizator::NumberValues()
+{
+   ComputeDominators();
+   replacements.clear();
+   definitions.clear();
+   loadsOut.clear();
+   staticLinks.clear();
+   ComputeBases();
+   NumberBlock(function->entry, ValueTable());
+}
+
+//a definition is dead when no path from it reads the register before it is assigned again;
+//promoted variables are assigned in several places, so plain use counts are not enough
+void IrOptimizator::RemoveDeadCode()
+{
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      IrLiveness liveness(function);
+      for (auto &block : function->blocks) {
+         IrRegSet live = liveness.liveOut[block];
+         IrInstrs& instrs = block->instrs;
+         for (size_t i = instrs.size(); i-- > 0;) {
+            if (!instrs[i].HasSideEffects() && instrs[i].GetDef() >= 0 && live.count(instrs[i].GetDef()) == 0) {
+               instrs.erase(instrs.begin() + i);
+               isChanged = true;
+               continue;
+            }
+            live.erase(instrs[i].GetDef());
+            for (auto &reg : instrs[i].GetUses()) {
+               live.insert(reg);
+            }
+         }
+      }
+   }
+}
+
+static bool IsLocalStore(const IrInstr& instr)
+{
+   return instr.op == irStore && instr.a.kind == ioFrame && instr.a.value + instr.offset < 0;
+}
+
+//a store into a local of the own frame is dead when no path from it reads the local before
+//it is stored again or the function returns; a call may read any of them through a static link
+void IrOptimizator::RemoveDeadStores()
+{
+   ComputeBases();
+   set<int> slots;
+   for (auto &block : function->blocks) {
+      for (auto &instr : block->instrs) {
+         if (IsLocalStore(instr)) {
+            slots.insert(instr.a.value + instr.offset);
+         }
+      }
+   }
+   auto transfer = [&](const IrInstr& instr, set<int>& live) {
+      if (IsLocalStore(instr)) {
+         live.erase(instr.a.value + instr.offset);
+         return;
+      }
+      for (auto &slot : slots) {
+         if (instr.op != irStore && MayAccess(instr, IrFrame(slot))) {
+            live.insert(slot);
+         }
+      }
+   };
+   unordered_map<IrBlock*, set<int>> liveIn;
+   auto getLiveOut = [&](IrBlock* block) {
+      set<int> live;
+      for (auto &succ : block->GetSuccessors()) {
+         live.insert(liveIn[succ].begin(), liveIn[succ].end());
+      }
+      return live;
+   };
+   bool isChanged = !slots.empty();
+   while (isChanged) {
+      isChanged = false;
+      for (auto it = function->blocks.rbegin(); it != function->blocks.rend(); it++) {
+         set<int> live = getLiveOut(*it);
+         for (auto instr = (*it)->instrs.rbegin(); instr != (*it)->instrs.rend(); instr++) {
+            transfer(*instr, live);
+         }
+         if (live != liveIn[*it]) {
+            liveIn[*it] = live;
+            isChanged = true;
+         }
+      }
+   }
+   for (auto &block : function->blocks) {
+      set<int> live = getLiveOut(block);
+      IrInstrs& instrs = block->instrs;
+      for (size_t i = instrs.size(); i-- > 0;) {
+         if (IsLocalStore(instrs[i]) && live.count(instrs[i].a.value + instrs[i].offset) == 0) {
+            instrs.erase(instrs.begin() + i);
+         } else {
+            transfer(instrs[i], live);
+         }
+      }
+   }
+}
+
+//replaces the result of a move by its source wherever the source still holds the same value
+void IrOptimizator::PropagateCopies()
+{
+   ComputePredecessors();
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   for (auto &block : function->blocks) {
+      for (size_t i = 0; i < block->instrs.size(); i++) {
+         IrInstr instr = block->instrs[i];
+         if (instr.op != irMov || (!instr.a.IsReg() && !instr.a.IsImm()) || definitionCounts[instr.dst.value] != 1) continue;
+         bool isSafe = true;
+         for (auto &use : GetUses(instr.dst.value)) {
+            const IrInstr& user = use.first->instrs[use.second];
+            isSafe = isSafe && (instr.a.IsReg() ? !IsRedefined(instr.a.value, make_pair(block, i), use) : user.op <= irIntToReal);
+         }
+         if (!isSafe) continue;
+         ReplaceUses(instr.dst.value, instr.a);
+         block->instrs.erase(block->instrs.begin() + i--);
+         for (auto &block : function->blocks) {
+            for (auto &user : block->instrs) {
+               if (IsCommutative(user.op) && user.a.IsImm() && !user.b.IsImm()) {
+                  swap(user.a, user.b);
+               }
+            }
+         }
+      }
+   }
+}
+
+//x = a op b; v = mov x becomes v = a op b when nothing else needs x
+//or v still holds x wherever else it is used
+void IrOptimizator::CoalesceCopies()
+{
+   ComputePredecessors();
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   for (auto &block : function->blocks) {
+      IrInstrs& instrs = block->instrs;
+      for (size_t i = 0; i < instrs.size(); i++) {
+         if (instrs[i].op != irMov || !instrs[i].a.IsReg()) continue;
+         int reg = instrs[i].a.value;
+         if (definitionCounts[reg] != 1) continue;
+         bool isHeld = true;
+         for (auto &use : GetUses(reg)) {
+            isHeld = isHeld && (use == make_pair(block, i) || !IsRedefined(instrs[i].dst.value, make_pair(block, i), use));
+         }
+         if (!isHeld) continue;
+         size_t j = i;
+         while (j > 0 && instrs[j - 1].GetDef() != reg) j--;
+         if (j == 0) continue;
+         bool isFree = true;
+         for (size_t k = j; k < i; k++) {
+            vector<int> uses = instrs[k].GetUses();
+            isFree = isFree && instrs[k].GetDef() != instrs[i].dst.value && find(uses.begin(), uses.end(), instrs[i].dst.value) == uses.end();
+         }
+         if (!isFree) continue;
+         instrs[j - 1].dst = instrs[i].dst;
+         instrs.erase(instrs.begin() + i--);
+         ReplaceUses(reg, instrs[j - 1].dst);
+      }
+   }
+}
+
+//natural loops of the back edges, innermost first
+void IrOptimizator::FindLoops(vector<IrLoop>& loops)
+{
+   ComputeDominators();
+   loops.clear();
+   for (auto &block : function->blocks) {
+      if (dominators.count(block) == 0) continue;
+      for (auto &succ : block->GetSuccessors()) {
+         IrBlock* dom = block;
+         while (dom != succ && dom != function->entry) {
+            dom = dominators[dom];
+         }
+         if (dom != succ) continue;
+         auto loop = find_if(loops.begin(), loops.end(), [&](const IrLoop& loop) { return loop.header == succ; });
+         if (loop == loops.end()) {
+            IrLoop newLoop = { succ, nullptr, unordered_set<IrBlock*>() };
+            newLoop.blocks.insert(succ);
+            loops.push_back(newLoop);
+            loop = loops.end() - 1;
+         }
+         vector<IrBlock*> stack(1, block);
+         while (!stack.empty()) {
+            IrBlock* body = stack.back();
+            stack.pop_back();
+            if (loop->blocks.insert(body).second) {
+               stack.insert(stack.end(), predecessors[body].begin(), predecessors[body].end());
+            }
+         }
+      }
+   }
+   stable_sort(loops.begin(), loops.end(), [](const IrLoop& l1, const IrLoop& l2) { return l1.blocks.size() < l2.blocks.size(); });
+}
+
+//the only block entering the loop from outside, where invariant code goes
+void IrOptimizator::InsertPreheader(IrLoop& loop)
+{
+   IrBlocks outside;
+   for (auto &pred : predecessors[loop.header]) {
+      if (loop.blocks.count(pred) == 0) {
+         outside.push_back(pred);
+      }
+   }
+   if (outside.size() == 1 && outside[0]->instrs.back().op == irJump && loop.header != function->entry) {
+      loop.preheader = outside[0];
+      return;
+   }
+   loop.preheader = function->NewBlock();
+   IrInstr jump(irJump);
+   jump.target = loop.header;
+   loop.preheader->instrs.push_back(jump);
+   for (auto &pred : outside) {
+      Retarget(pred, loop.header, loop.preheader);
+   }
+   if (loop.header == function->entry) {
+      function->entry = loop.preheader;
+   }
+   function->blocks.insert(find(function->blocks.begin(), function->blocks.end(), loop.header), loop.preheader);
+   ComputePredecessors();
+}
+
+IrBlocks IrOptimizator::GetLoopBlocks(const IrLoop& loop) const
+{
+   IrBlocks result;
+   for (auto &block : function->blocks) {
+      if (loop.blocks.count(block)) {
+         result.push_back(block);
+      }
+   }
+   return result;
+}
+
+//moves computations whose operands do not change in the loop to the preheader; loads
+//move when nothing in the loop may write their memory and they cannot fault, that is
+//their address is constant or they are in the header which runs whenever the preheader does
+void IrOptimizator::HoistInvariants(IrLoop& loop)
+{
+   IrBlocks blocks = GetLoopBlocks(loop);
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   unordered_set<int> variant;
+   IrInstrs writes;
+   bool hasCalls = false;
+   for (auto &block : blocks) {
+      for (auto &instr : block->instrs) {
+         variant.insert(instr.GetDef());
+         hasCalls = hasCalls || instr.op == irCall;
+         if (instr.op == irStore || instr.op == irCopy || instr.op == irPopBlock) {
+            writes.push_back(instr);
+         }
+      }
+   }
+   auto isHoistable = [&](const IrInstr& instr, IrBlock* block) {
+      if (instr.GetDef() < 0 || definitionCounts[instr.GetDef()] != 1) return false;
+      for (auto &reg : instr.GetUses()) {
+         if (variant.count(reg)) return false;
+      }
+      if (instr.op <= irIntToReal) {
+         return instr.op != irDiv && instr.op != irMod;
+      }
+      if (instr.op != irLoad || hasCalls || (instr.a.IsReg() && block != loop.header)) return false;
+      for (auto &write : writes) {
+         if (MayAlias(instr.a, instr.offset, 4, write.a, write.offset, write.op == irStore ? 4 : write.size)) return false;
+      }
+      return true;
+   };
+   IrInstrs& preheader = loop.preheader->instrs;
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto &block : blocks) {
+         for (size_t i = 0; i < block->instrs.size(); i++) {
+            if (!isHoistable(block->instrs[i], block)) continue;
+            variant.erase(block->instrs[i].GetDef());
+            preheader.insert(preheader.end() - 1, block->instrs[i]);
+            block->instrs.erase(block->instrs.begin() + i--);
+            isChanged = true;
+         }
+      }
+   }
+}
+
+//a variable can live in a register during the loop when every access to it there is a plain load or store
+bool IrOptimizator::CanPromote(const IrLoop& loop, const IrOperand& addr) const
+{
+   for (auto &block : loop.blocks) {
+      for (auto &instr : block->instrs) {
+         if ((instr.op == irLoad || instr.op == irStore) && !instr.a.IsReg() && GetOperandKey(GetAddress(instr)) == GetOperandKey(addr)) {
+            if (function->GetType(instr.op == irLoad ? instr.dst : instr.b) != itInt) return false;
+         } else if (MayAccess(instr, addr)) {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+//keeps the variable in a register for the loop: it is loaded (or taken from a store just
+//before) in the preheader and stored back on every edge leaving the loop
+void IrOptimizator::PromoteVariable(IrLoop& loop, const IrOperand& addr)
+{
+   IrOperand reg = function->NewReg(itInt);
+   IrInstrs& preheader = loop.preheader->instrs;
+   IrInstr init(irLoad, reg, addr);
+   for (size_t i = preheader.size() - 1; i-- > 0;) {
+      const IrInstr& instr = preheader[i];
+      if (instr.op == irStore && !instr.a.IsReg() && GetOperandKey(GetAddress(instr)) == GetOperandKey(addr)) {
+         bool isChanged = false;
+         for (size_t j = i + 1; j < preheader.size(); j++) {
+            isChanged = isChanged || (instr.b.IsReg() && preheader[j].GetDef() == instr.b.value);
+         }
+         if (!isChanged) {
+            init = IrInstr(irMov, reg, instr.b);
+         }
+         break;
+      }
+      if (MayAccess(instr, addr) && instr.op != irLoad) break;
+   }
+   preheader.insert(preheader.end() - 1, init);
+   IrBlocks blocks = GetLoopBlocks(loop);
+   for (auto &block : blocks) {
+      for (auto &instr : block->instrs) {
+         if ((instr.op == irLoad || instr.op == irStore) && !instr.a.IsReg() && GetOperandKey(GetAddress(instr)) == GetOperandKey(addr)) {
+            instr = instr.op == irLoad ? IrInstr(irMov, instr.dst, reg) : IrInstr(irMov, reg, instr.b);
+         }
+      }
+   }
+   for (auto &block : blocks) {
+      for (auto &succ : block->GetSuccessors()) {
+         if (loop.blocks.count(succ) == 0) {
+            IrInstrs& instrs = SplitEdge(block, succ)->instrs;
+            IrInstr store(irStore, IrOperand(), addr, reg);
+            instrs.insert(instrs.begin(), store);
+         }
+      }
+   }
+}
+
+void IrOptimizator::PromoteVariables(IrLoop& loop)
+{
+   //in the order of the blocks, so that the registers do not depend on where the blocks are allocated
+   vector<IrOperand> candidates;
+   for (auto &block : GetLoopBlocks(loop)) {
+      for (auto &instr : block->instrs) {
+         if (instr.op == irCall) return;
+         if (instr.op == irStore && !instr.a.IsReg()) {
+            candidates.push_back(GetAddress(instr));
+         }
+      }
+   }
+   unordered_set<string> promoted;
+   for (auto &addr : candidates) {
+      if (promoted.insert(GetOperandKey(addr)).second && CanPromote(loop, addr)) {
+         PromoteVariable(loop, addr);
+      }
+   }
+   PropagateCopies();
+   CoalesceCopies();
+}
+
+//i = i + step in a loop makes i * c and i * c + x inductions too; they become registers of
+//their own, set up in the preheader and advanced next to i, so the multiplication goes away
+//%c = mov %v; ...; %v = add %c, k, left when the old value of a promoted variable is
+//still needed after it is counted, becomes %v = add %v, k; %c = add %v, -k;
+//the uses of %c up to the update read %v instead
+void IrOptimizator::NormalizeCounters(const IrBlocks& blocks)
+{
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   for (auto &block : blocks) {
+      IrInstrs& instrs = block->instrs;
+      for (size_t q = 0; q < instrs.size(); q++) {
+         IrInstr update = instrs[q];
+         if (update.op != irAdd || !update.a.IsReg() || !update.b.IsImm() || definitionCounts[update.a.value] != 1) continue;
+         size_t p = q;
+         while (p > 0 && instrs[p - 1].GetDef() != update.a.value && instrs[p - 1].GetDef() != update.dst.value) p--;
+         if (p == 0 || instrs[p - 1].op != irMov || instrs[p - 1].dst != update.a || instrs[p - 1].a != update.dst) continue;
+         for (size_t k = p; k <= q; k++) {
+            if (instrs[k].a == update.a) instrs[k].a = update.dst;
+            if (instrs[k].b == update.a) instrs[k].b = update.dst;
+         }
+         instrs.insert(instrs.begin() + q + 1, IrInstr(irAdd, update.a, update.dst, IrImm(-update.b.value)));
+         instrs.erase(instrs.begin() + p - 1);
+      }
+   }
+}
+
+void IrOptimizator::ReduceInductions(IrLoop& loop)
+{
+   IrBlocks blocks = GetLoopBlocks(loop);
+   NormalizeCounters(blocks);
+   unordered_map<int, int> loopDefinitions;
+   for (auto &block : blocks) {
+      for (auto &instr : block->instrs) {
+         loopDefinitions[instr.GetDef()]++;
+      }
+   }
+   unordered_map<int, int> steps, basics;
+   for (auto &block : blocks) {
+      for (auto &instr : block->instrs) {
+         if (instr.op == irAdd && instr.a == instr.dst && instr.b.IsImm() && loopDefinitions[instr.GetDef()] == 1) {
+            steps[instr.GetDef()] = instr.b.value;
+            basics[instr.GetDef()] = instr.GetDef();
+         }
+      }
+   }
+   if (steps.empty()) return;
+   ComputePredecessors();
+   IrInstrs& preheader = loop.preheader->instrs;
+   unordered_map<int, int> constants;
+   for (auto &instr : preheader) {
+      if (instr.op == irMov && instr.a.IsImm()) {
+         constants[instr.GetDef()] = instr.a.value;
+      } else {
+         constants.erase(instr.GetDef());
+      }
+   }
+   auto getConstant = [&](const IrOperand& oper) {
+      return oper.IsReg() && constants.count(oper.value) ? IrImm(constants[oper.value]) : oper;
+   };
+   auto findUpdate = [&](int reg) {
+      for (auto &block : blocks) {
+         for (size_t i = 0; i < block->instrs.size(); i++) {
+            const IrInstr& instr = block->instrs[i];
+            if (instr.GetDef() == reg && instr.op == irAdd && instr.a == instr.dst) return make_pair(block, i);
+         }
+      }
+      return make_pair((IrBlock*)nullptr, size_t(0));
+   };
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto &block : blocks) {
+         for (size_t i = 0; i < block->instrs.size() && !isChanged; i++) {
+            IrInstr instr = block->instrs[i];
+            if (instr.GetDef() < 0 || definitionCounts[instr.GetDef()] != 1) continue;
+            if (instr.op == irAdd && instr.b.IsReg() && steps.count(instr.b.value)) {
+               swap(instr.a, instr.b);
+            }
+            if (!instr.a.IsReg() || steps.count(instr.a.value) == 0) continue;
+            bool isScaled = instr.op == irMul && instr.b.IsImm();
+            bool isScaledLater = instr.b.IsImm();
+            for (auto &use : GetUses(instr.GetDef())) {
+               const IrInstr& user = use.first->instrs[use.second];
+               isScaledLater = isScaledLater && user.op == irMul && user.b.IsImm();
+            }
+            bool isOffset = instr.op == irAdd && (basics[instr.a.value] != instr.a.value || isScaledLater)
+               && (!instr.b.IsReg() || loopDefinitions.count(instr.b.value) == 0);
+            if (!isScaled && !isOffset) continue;
+            int basic = basics[instr.a.value];
+            bool isSafe = true;
+            for (auto &use : GetUses(instr.GetDef())) {
+               isSafe = isSafe && !IsRedefined(basic, make_pair(block, i), use);
+            }
+            if (!isSafe) continue;
+            IrOperand reg = function->NewReg(itInt);
+            int step = isScaled ? steps[instr.a.value] * instr.b.value : steps[instr.a.value];
+            int folded;
+            IrInstr init(instr.op, reg, instr.a, instr.b);
+            IrOperand a = getConstant(instr.a), b = getConstant(instr.b);
+            if (Fold(instr.op, a, b, folded)) {
+               init = IrInstr(irMov, reg, IrImm(folded));
+               constants[reg.value] = folded;
+            } else if (instr.op == irAdd && a.IsImm() && b.kind == ioAddr) {
+               b.value += a.value;
+               init = IrInstr(irMov, reg, b);
+            }
+            preheader.insert(preheader.end() - 1, init);
+            block->instrs.erase(block->instrs.begin() + i);
+            auto update = findUpdate(basic);
+            update.first->instrs.insert(update.first->instrs.begin() + update.second + 1, IrInstr(irAdd, reg, reg, IrImm(step)));
+            ReplaceUses(instr.GetDef(), reg);
+            steps[reg.value] = step;
+            basics[reg.value] = basic;
+            loopDefinitions[reg.value] = 1;
+            isChanged = true;
+         }
+      }
+   }
+   for (auto &step : steps) {
+      if (basics[step.first] == step.first) continue;
+      auto update = findUpdate(step.first);
+      bool isUsed = false;
+      for (auto &use : GetUses(step.first)) {
+         isUsed = isUsed || (use != update && use.first != loop.preheader);
+      }
+      if (!isUsed) {
+         update.first->instrs.erase(update.first->instrs.begin() + update.second);
+      }
+   }
+}
+
+//loop optimizations go from the innermost loops outwards; a promoted variable is a
+//register assigned in several places, so value numbering cannot run after them
+void IrOptimizator::OptimizeLoops()
+{
+   unordered_set<IrBlock*> visited;
+   vector<IrLoop> loops;
+   ComputeBases();
+   while (true) {
+      FindLoops(loops);
+      auto loop = find_if(loops.begin(), loops.end(), [&](const IrLoop& loop) { return visited.count(loop.header) == 0; });
+      if (loop == loops.end()) break;
+      visited.insert(loop->header);
+      InsertPreheader(*loop);
+      HoistInvariants(*loop);
+      PromoteVariables(*loop);
+      ReduceInductions(*loop);
+      PropagateCopies();
+      ComputeBases();
+   }
+}
+
+//a check of a counter in its loop goes when the counter starts at a constant, only grows
+//or only shrinks by a constant and the header leaves the loop once it passes a constant
+//bound, so the body sees values from the start to the bound; the same for a constant plus
+//or minus the counter, computed where the counter still holds the value the header tested
+void IrOptimizator::EliminateRangeChecks()
+{
+   vector<IrLoop> loops;
+   FindLoops(loops);
+   unordered_map<int, int> definitionCounts = CountDefinitions();
+   unordered_map<int, IrPosition> positions;
+   set<IrPosition> removed;
+   for (auto &block : function->blocks) {
+      for (size_t i = 0; i < block->instrs.size(); i++) {
+         int def = block->instrs[i].GetDef();
+         if (def >= 0 && definitionCounts[def] == 1) {
+            positions[def] = make_pair(block, i);
+         }
+      }
+   }
+   auto getDefinition = [&](const IrOperand& oper) {
+      auto it = oper.IsReg() ? positions.find(oper.value) : positions.end();
+      return it != positions.end() ? &it->second.first->instrs[it->second.second] : nullptr;
+   };
+   auto dominates = [&](IrBlock* dom, IrBlock* block) {
+      while (block != dom && block != function->entry) {
+         block = dominators[block];
+      }
+      return block == dom;
+   };
+   for (auto &loop : loops) {
+      IrInstrs& header = loop.header->instrs;
+      if (header.size() < 2 || header.back().op != irBranch) continue;
+      const IrInstr& branch = header.back();
+      const IrInstr& compare = header[header.size() - 2];
+      if (compare.dst != branch.a || !compare.a.IsReg() || !compare.b.IsImm() || compare.op < irSetLt || compare.op > irSetGe) continue;
+      bool isExitOnTrue = loop.blocks.count(branch.target) == 0;
+      if (isExitOnTrue == (loop.blocks.count(branch.alt) == 0)) continue;
+      int counter = compare.a.value;
+      if (definitionCounts[counter] != 2) continue;
+      long long start = 0, step = 0;
+      bool hasStart = false;
+      for (auto &block : function->blocks) {
+         for (auto &instr : block->instrs) {
+            if (instr.GetDef() != counter) continue;
+            const IrInstr* update = instr.op == irMov ? getDefinition(instr.a) : &instr;
+            if (loop.blocks.count(block) && update != nullptr && update->op == irAdd && update->a == instr.dst && update->b.IsImm()) {
+               step = update->b.value;
+            } else if (!loop.blocks.count(block) && instr.op == irMov && instr.a.IsImm() && dominates(block, loop.header)) {
+               start = instr.a.value;
+               hasStart = true;
+            }
+         }
+      }
+      if (!hasStart || step == 0) continue;
+      //the values the header lets into the body
+      bool isUpper = (compare.op == irSetGt || compare.op == irSetGe) == isExitOnTrue;
+      long long bound = compare.b.value;
+      if ((compare.op == irSetGe && isExitOnTrue) || (compare.op == irSetLt && !isExitOnTrue)) bound--;
+      if ((compare.op == irSetLe && isExitOnTrue) || (compare.op == irSetGt && !isExitOnTrue)) bound++;
+      if (isUpper != (step > 0) || bound + step > INT_MAX || bound + step < INT_MIN) continue;
+      long long low = isUpper ? start : bound, high = isUpper ? bound : start;
+      IrPosition test = make_pair(loop.header, header.size() - 1);
+      auto isHeld = [&](IrPosition use) {
+         return use.first != loop.header && loop.blocks.count(use.first) && !IsRedefined(counter, test, use);
+      };
+      for (auto &block : GetLoopBlocks(loop)) {
+         for (size_t i = 0; i < block->instrs.size(); i++) {
+            const IrInstr& check = block->instrs[i];
+            if (check.op != irCheck || !check.a.IsReg()) continue;
+            long long first = low, last = high;
+            const IrInstr* def = getDefinition(check.a);
+            bool isCounter = check.a.value == counter && isHeld(make_pair(block, i));
+            if (!isCounter && def != nullptr && isHeld(positions[check.a.value])) {
+               if (def->op == irAdd && def->a.value == counter && def->a.IsReg() && def->b.IsImm()) {
+                  first = low + def->b.value;
+                  last = high + def->b.value;
+                  isCounter = true;
+               } else if (def->op == irSub && def->a.IsImm() && def->b.IsReg() && def->b.value == counter) {
+                  first = def->a.value - high;
+                  last = def->a.value - low;
+                  isCounter = true;
+               }
+            }
+            if (isCounter && first >= check.offset && last <= check.offset + (long long)check.size) {
+               removed.insert(make_pair(block, i));
+            }
+         }
+      }
+   }
+   for (auto it = removed.rbegin(); it != removed.rend(); it++) {
+      it->first->instrs.erase(it->first->instrs.begin() + it->second);
+   }
+}
+
+//a call of the function itself right before the exit, maybe with its result stored as the own one,
+//reuses the frame: the arguments are stored over the own ones and control goes back to the start;
+//the arguments must not point into the frame; the static link stays, as the function passes its
+//own one to itself
+void IrOptimizator::EliminateTailCalls()
+{
+   ComputeBases();
+   IrBlock* start = function->entry;
+   bool isChanged = false;
+   for (auto &block : function->blocks) {
+      IrInstrs& instrs = block->instrs;
+      if (function->label == nullptr || instrs.size() < 2 || instrs.back().op != irJump || instrs.back().target != function->exit) continue;
+      size_t index = instrs.size() - 2;
+      if (index >= 2 && instrs[index].op == irStore && instrs[index - 1].op == irPop && instrs[index].b == instrs[index - 1].dst) {
+         const IrInstr& store = instrs[index];
+         index -= 2;
+         if (store.a.kind != ioFrame || GetAddress(store).value != 12 + int(instrs[index].size)) continue;
+      }
+      const IrInstr& call = instrs[index];
+      if (call.op != irCall || call.callee->GetStrValue() != function->label->GetStrValue()) continue;
+      size_t begin;
+      unordered_map<size_t, int> slots;
+      if (!block->FindArguments(index, begin, slots)) continue;
+      bool isSafe = true;
+      for (auto &slot : slots) {
+         const IrInstr& push = instrs[slot.first];
+         isSafe = isSafe && push.op == irPush && GetBase(push.a).kind != ioFrame;
+      }
+      if (!isSafe) continue;
+      IrInstrs result, stores;
+      for (size_t i = 0; i < index; i++) {
+         if (slots.count(i) > 0) {
+            stores.push_back(IrInstr(irStore, IrOperand(), IrFrame(slots[i]), instrs[i].a));
+         } else if (i != begin || instrs[i].op != irAlloc) {
+            result.push_back(instrs[i]);
+         }
+      }
+      result.insert(result.end(), stores.begin(), stores.end());
+      IrInstr jump(irJump);
+      jump.target = start;
+      result.push_back(jump);
+      instrs = result;
+      isChanged = true;
+   }
+   if (isChanged) {
+      function->entry = function->NewBlock();
+      IrInstr jump(irJump);
+      jump.target = start;
+      function->entry->instrs.push_back(jump);
+      function->blocks.insert(function->blocks.begin(), function->entry);
+   }
+}
+
+//chains blocks so that jumps fall through; the exit block keeps the epilogue and goes last,
+//a loop body goes before the code after the loop so that its registers are not held over it
+void IrOptimizator::LayoutBlocks()
+{
+   unordered_map<IrBlock*, size_t> order;
+   for (size_t i = 0; i < function->blocks.size(); i++) {
+      order[function->blocks[i]] = i;
+   }
+   vector<IrLoop> loops;
+   FindLoops(loops);
+   auto staysInLoop = [&](IrBlock* block, IrBlock* succ) {
+      return any_of(loops.begin(), loops.end(), [&](const IrLoop& loop) {
+         return loop.blocks.count(block) > 0 && loop.blocks.count(succ) > 0;
+      });
+   };
+   unordered_set<IrBlock*> placed;
+   placed.insert(function->exit);
+   IrBlocks layout;
+   for (auto &start : function->blocks) {
+      IrBlock* block = start;
+      while (block != nullptr && placed.insert(block).second) {
+         layout.push_back(block);
+         IrBlock* next = nullptr;
+         for (auto &succ : block->GetSuccessors()) {
+            if (placed.count(succ) > 0) continue;
+            if (next == nullptr || make_pair(!staysInLoop(block, succ), order[succ]) < make_pair(!staysInLoop(block, next), order[next])) {
+               next = succ;
+            }
+         }
+         block = next;
+      }
+   }
+   layout.push_back(function->exit);
+   function->blocks = layout;
+}
+
+void IrOptimizator::SimplifyCfg()
+{
+   bool isChanged = true;
+   while (isChanged) {
+      isChanged = false;
+      for (auto &optimization : optimizations) {
+         isChanged = (this->*optimization)() || isChanged;
+      }
+   }
+}
+
+void IrOptimizator::Optimize(IrFunction* AFunction)
+{
+   function = AFunction;
+   SimplifyCfg();
+   NumberValues();
+   RemoveDeadCode();
+   OptimizeLoops();
+   EliminateRangeChecks();
+   RemoveDeadStores();
+   RemoveDeadCode();
+   SimplifyCfg();
+   LayoutBlocks();
+}
+
+//callees are inlined once value numbering has cleaned them up, so their size is known
+//and their arguments are read by plain loads; a recursive one may become a leaf by then
+void IrOptimizator::Optimize(IrProgram& program)
+{
+   for (auto &function : program.functions) {
+      this->function = function;
+      SimplifyCfg();
+      NumberValues();
+      RemoveDeadCode();
+      EliminateTailCalls();
+   }
+   if (inlineThreshold > 0) {
+      IrInliner inliner(inlineThreshold);
+      inliner.Inline(program);
+      report = inliner.report;
+   }
+   for (auto &function : program.functions) {
+      Optimize(function);
+   }
+}
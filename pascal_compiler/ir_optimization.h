@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include "ir.h"
+#include "ir_inlining.h"
+
+struct IrAvailableLoad {
+   IrOperand value;
+   IrOperand base;
+   int offset;
+};
+
+struct IrLoop {
+   IrBlock* header;
+   IrBlock* preheader;
+   unordered_set<IrBlock*> blocks;
+};
+
+typedef pair<IrBlock*, size_t> IrPosition;
+
+class IrOptimizator {
+   typedef bool (IrOptimizator::*optimizationFunc)();
+   typedef unordered_map<IrBlock*, vector<IrBlock*>> Predecessors;
+   typedef unordered_map<string, IrOperand> ValueTable;
+   typedef unordered_map<string, IrAvailableLoad> LoadTable;
+
+   IrFunction* function;
+   size_t inlineThreshold;
+   Predecessors predecessors;
+   vector<optimizationFunc> optimizations;
+   unordered_map<IrBlock*, IrBlock*> dominators;
+   Predecessors dominatorTree;
+   unordered_map<int, IrOperand> replacements;
+   unordered_map<int, IrInstr> definitions;
+   unordered_map<IrBlock*, LoadTable> loadsOut;
+   unordered_set<int> staticLinks;
+   unordered_map<int, IrOperand> bases;
+
+   void ComputePredecessors();
+   void ComputeDominators();
+   void RemoveBlock(IrBlock*);
+   IrBlock* GetJumpTarget(IrBlock*) const;
+   void Retarget(IrBlock*, IrBlock*, IrBlock*);
+   IrBlock* SplitEdge(IrBlock*, IrBlock*);
+   unordered_map<int, int> CountDefinitions() const;
+   vector<IrPosition> GetUses(int) const;
+   void ReplaceUses(int, const IrOperand&);
+   bool IsRedefined(int, IrPosition, IrPosition);
+   IrOperand GetBase(const IrOperand&) const;
+   IrOperand GetInstrBase(const IrInstr&) const;
+   void ComputeBases();
+   bool MayAlias(const IrOperand&, int, size_t, const IrOperand&, int, size_t) const;
+   bool MayAccess(const IrInstr&, const IrOperand&) const;
+   const IrInstr* GetDefinition(const IrOperand&, IrOpCode) const;
+   IrOperand Replace(IrOperand) const;
+   IrOperand Simplify(IrInstr&, IrInstrs&, ValueTable&);
+   IrOperand NumberValue(IrInstr, IrInstrs&, ValueTable&);
+   void FoldAddress(IrInstr&) const;
+   void KillLoads(LoadTable&, const IrInstr&) const;
+   void NumberBlock(IrBlock*, ValueTable);
+   bool FoldBranches();
+   bool ThreadJumps();
+   bool RemoveUnreachableBlocks();
+   bool MergeBlocks();
+   void SimplifyCfg();
+   void NumberValues();
+   void RemoveDeadCode();
+   void RemoveDeadStores();
+   void PropagateCopies();
+   void CoalesceCopies();
+   void FindLoops(vector<IrLoop>&);
+   void InsertPreheader(IrLoop&);
+   IrBlocks GetLoopBlocks(const IrLoop&) const;
+   void HoistInvariants(IrLoop&);
+   bool CanPromote(const IrLoop&, const IrOperand&) const;
+   void PromoteVariable(IrLoop&, const IrOperand&);
+   void PromoteVariables(IrLoop&);
+   void NormalizeCounters(const IrBlocks&);
+   void ReduceInductions(IrLoop&);
+   void OptimizeLoops();
+   void EliminateRangeChecks();
+   void EliminateTailCalls();
+   void LayoutBlocks();
+public:
+   vector<string> report;
+   IrOptimizator(size_t = 0);
+   void Optimize(IrFunction*);
+   void Optimize(IrProgram&);
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <string>
+#include <cstring>
 #include <sstream>
 #include "parser.h"
 #include "scanner.h"
@@ -12,6 +13,7 @@ int main(int argc, char *argv[])
 {
 	bool isErr = false;
 	string errMsg;
+   int exitCode = 0;
    try {
 		Printer printer;
       //Scanner scanner1("test.tree");
@@ -23,6 +25,12 @@ int main(int argc, char *argv[])
       //parser.Generate();
       if (argc > 1) {
          if (argv[1][0] == '-') {
+            bool isReorderFields = strchr(argv[1], 'r') != nullptr;
+            bool isObjectCode = strchr(argv[1], 'e') != nullptr;
+            bool isRun = strchr(argv[1], 'x') != nullptr;
+            bool isReport = strchr(argv[1], 'V') != nullptr;
+            const char* threshold = strpbrk(argv[1], "0123456789");
+            size_t inlineThreshold = threshold != nullptr ? atoi(threshold) : 16;
             for (int i = 1, len = strlen(argv[1]); i < len; i++) {
 					for (int j = 2; j < argc; j++) {
 						Scanner scanner(argv[j]);
@@ -55,14 +63,50 @@ int main(int argc, char *argv[])
                         {
                            Parser parser(scanner);
                            parser.isOptimize = false;
-                           printer.printAsmCode(parser);
+                           parser.isReorderFields = isReorderFields;
+                           if (isRun) {
+                              exitCode = printer.printProgramOutput(parser);
+                           } else if (isObjectCode) {
+                              printer.printObjectCode(parser);
+                           } else {
+                              printer.printAsmCode(parser);
+                           }
                         }
                         break;
                      case 'o':
                         {
                            Parser parser(scanner);
                            parser.isOptimize = true;
-                           printer.printAsmCode(parser);
+                           parser.isReorderFields = isReorderFields;
+                           parser.inlineThreshold = inlineThreshold;
+                           parser.isReport = isReport;
+                           if (isRun) {
+                              exitCode = printer.printProgramOutput(parser);
+                           } else if (isObjectCode) {
+                              printer.printObjectCode(parser);
+                           } else {
+                              printer.printAsmCode(parser);
+                           }
+                        }
+                        break;
+                     case 'i':
+                        {
+                           Parser parser(scanner);
+                           parser.isOptimize = true;
+                           parser.isReorderFields = isReorderFields;
+                           parser.inlineThreshold = inlineThreshold;
+                           parser.isReport = isReport;
+                           printer.printIr(parser);
+                        }
+                        break;
+                     case 'v':
+                        {
+                           Parser parser(scanner);
+                           parser.isOptimize = true;
+                           parser.isReorderFields = isReorderFields;
+                           parser.inlineThreshold = inlineThreshold;
+                           parser.isReport = isReport;
+                           exitCode = printer.printBytecodeOutput(parser);
                         }
                         break;
 						}
@@ -112,9 +156,15 @@ int main(int argc, char *argv[])
 	} catch (IllegalTypeConversionException& e) {
       isErr = true;
       errMsg = e.getMessage();
+   } catch (EncodeException& e) {
+      isErr = true;
+      errMsg = e.getMessage();
+   } catch (JitException& e) {
+      isErr = true;
+      errMsg = e.getMessage();
    }
 	if (isErr) {
 		cout << errMsg << endl;
 	}
-   return 0;
+   return exitCode;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "parser.h"
 #include "error.h"
 
@@ -14,7 +15,10 @@ Parser::Parser(const Scanner& AScanner): scanner(AScanner), _priorities(PRIORITI
       _isGlobalNamespace(true),
       _isConstantParsing(false),
       isOptimize(false),
-      isDeclarationParse(false)
+      isDeclarationParse(false),
+      isReorderFields(false),
+      inlineThreshold(0),
+      isReport(false)
 {
 	symTable->Add(typeChar);
 	symTable->Add(typeFloat);
@@ -75,32 +79,102 @@ Parser::Parser(const Scanner& AScanner): scanner(AScanner), _priorities(PRIORITI
 	computable_binary_op.insert(make_pair(Tag::GE,				  &Parser::ComputeBinaryGe));
 }
 
-void Parser::Generate()
+void Parser::GenerateIr(IrProgram& program)
+{
+   symTable->GenerateDataDeclarations(asmCode);
+   symTable->GenerateIrDeclarations(program);
+   IrBuilder builder(program, nullptr, 0);
+   symTable->block->GenerateIr(builder);
+   builder.Finish();
+}
+
+//what the optimizer did goes to cerr only when asked for, so that compiling stays quiet
+void Parser::PrintReport(const vector<string>& report) const
+{
+   if (!isReport) return;
+   for (auto &line : report) {
+      cerr << scanner.fname << ": " << line << endl;
+   }
+}
+
+void Parser::GenerateCode()
 {
-   symTable->GenerateDeclarations(asmCode);
-   asmCode.AddCmd("main:");
-   asmCode.AddCmd(MOV, EBP, ESP);
-   symTable->block->Generate(asmCode);
-   asmCode.AddCmd(MOV, ESP, EBP);
-   asmCode.AddCmd(MOV, EAX, 0);
-   asmCode.AddCmd(RET);
    if (isOptimize) {
-      //asmCode.AddCmd(MOV, EBP, ESP);
-      //asmCode.AddLabel("@exit");
-      //asmCode.AddCmd(MOV, ESP, EBP);
-      //asmCode.AddCmd(MOV, EBX, AsmMemory(EBX, 8));
-      //asmCode.AddCmd(ADD, EBX, 12);
-      //asmCode.AddCmd(PUSH, EBX);
-      //mov   ebp, esp
-      //   @exit_1:
-      //mov   esp, ebp
-      Optimizator optimizator;
-      optimizator.Optimize(asmCode);
+      IrProgram program(asmCode);
+      GenerateIr(program);
+      IrOptimizator optimizator(inlineThreshold);
+      optimizator.Optimize(program);
+      PrintReport(optimizator.report);
+      IrLowering(asmCode).Lower(program);
+      InstructionScheduler(asmCode).Schedule();
+   } else {
+      symTable->GenerateDeclarations(asmCode);
+      asmCode.AddCmd("main:");
+      asmCode.AddCmd(MOV, EBP, ESP);
+      symTable->block->Generate(asmCode);
+      asmCode.GenFlushWrites();
+      asmCode.AddCmd(MOV, ESP, EBP);
+      asmCode.AddCmd(MOV, EAX, 0);
+      asmCode.AddCmd(RET);
    }
+   asmCode.GenRangeErrorHandler();
+   asmCode.GenWriteRuntime();
    asmCode.AddCmd("end main");
+   if (isOptimize) {
+      PrintReport(asmCode.GetConstReport());
+   }
+}
+
+void Parser::Generate()
+{
+   GenerateCode();
    asmCode.Print();
 }
 
+void Parser::GenerateObject(ostream& out)
+{
+   GenerateCode();
+   AsmEncoder encoder(scanner.fname);
+   asmCode.Encode(encoder);
+   encoder.Write(out);
+}
+
+int Parser::Run()
+{
+   GenerateCode();
+   return AsmJit(scanner.fname).Run(asmCode);
+}
+
+//the data declarations are all the code holds before the ir is lowered, so the encoder lays out just them
+int Parser::Interpret()
+{
+   IrProgram program(asmCode);
+   GenerateIr(program);
+   IrOptimizator optimizator(inlineThreshold);
+   optimizator.Optimize(program);
+   PrintReport(optimizator.report);
+   if (isOptimize) {
+      PrintReport(asmCode.GetConstReport());
+   }
+   AsmEncoder encoder(scanner.fname);
+   asmCode.Encode(encoder);
+   BcProgram bytecode;
+   BytecodeCompiler(bytecode, encoder).Compile(program);
+   return BytecodeVm(scanner.fname).Run(bytecode);
+}
+
+void Parser::PrintIr()
+{
+   IrProgram program(asmCode);
+   GenerateIr(program);
+   if (isOptimize) {
+      IrOptimizator optimizator(inlineThreshold);
+      optimizator.Optimize(program);
+      PrintReport(optimizator.report);
+   }
+   program.Print();
+}
+
 void Parser::ParseProgram()
 {
 	if (isDeclarationParse) {
@@ -221,6 +295,15 @@ void Parser::CheckSubrangeBoundType(Symbol* symbol, int line)
 	}
 }
 
+//the subroutines being parsed down to the one of the given depth keep their static links, as the
+//frame of that one is reached through theirs; the main program keeps its variables out of frames
+void Parser::MarkFrameAccess(unsigned depth)
+{
+	for (size_t i = depth; depth > 0 && i < subroutineStack.size(); i++) {
+		subroutineStack[i]->UseLink();
+	}
+}
+
 void Parser::ReserveOperationPriority(priorityType type, int tag)
 {
 	_priorities[type].push_back(tag);
@@ -233,6 +316,24 @@ void Parser::ParseBlock(string name, unsigned depth)
 		NodeSubroutineBlock* block = new NodeSubroutineBlock;
 		symTable->block = block;
 		block->AddBody(ParseCompoundStatement(name, depth));
+	} else if (CheckNextTokenTag(Tag::BEGIN)) {
+		SkipCompoundStatement();
+	}
+}
+
+void Parser::SkipCompoundStatement()
+{
+	CheckExpectedToken(Tag::BEGIN);
+	int nesting = 1;
+	while (nesting > 0) {
+		TokenPtr token = GetToken();
+		if (*token == Tag::BEGIN || *token == Tag::CASE) {
+			nesting++;
+		} else if (*token == Tag::END) {
+			nesting--;
+		} else if (token->isEndOfFile()) {
+			throw SyntaxException(scanner.fname, token->text, _line, Tag::END);
+		}
 	}
 }
 
@@ -277,14 +378,16 @@ void Parser::ParseProcedureDefinition(unsigned depth)
 {
 	string name = GetSubroutineName();
 	CheckNameForUnique(name);
-	SymProcedure* proc = new SymProcedure(name);
+	SymProcedure* proc = new SymProcedure(name, depth + 1);
    proc->GenerateLabel(asmCode);
 	symTable->Add(proc);
    _isGlobalNamespace = false;
 	SymTable* params = ParseFormalParameterList(proc, depth + 1);
 	CheckExpectedToken(Tag::SEMICOLON);
 	proc->SetParams(params);
+   subroutineStack.push_back(proc);
 	proc->SetVars(ParseProcFuncBlock(params, name, depth + 1));
+   subroutineStack.pop_back();
    _isGlobalNamespace = true;
 }
 
@@ -292,7 +395,7 @@ void Parser::ParseFunctionDefinition(unsigned depth)
 {
 	string name = GetSubroutineName();
 	CheckNameForUnique(name);
-	SymFunction* func = new SymFunction(name);
+	SymFunction* func = new SymFunction(name, depth + 1);
    func->GenerateLabel(asmCode);
 	symTable->Add(func);
    _isGlobalNamespace = false;
@@ -302,7 +405,9 @@ void Parser::ParseFunctionDefinition(unsigned depth)
 	CheckExpectedToken(Tag::SEMICOLON);
    params->Add(new SymParamResult(SymbolPtr(resultType), params->GetSize(), func, depth + 1), "result");
 	func->SetParams(params, resultType);
+   subroutineStack.push_back(func);
 	func->SetVars(ParseProcFuncBlock(params, name, depth + 1));
+   subroutineStack.pop_back();
    _isGlobalNamespace = true;
 }
 
@@ -494,10 +599,7 @@ double Parser::ComputeConstantExpression(NodeExpr* node, int line)
 			? castToken<IntegerNumber>(node->token)->value
 			: castToken<RealNumber>(node->token)->value;
 	} else if (*node == ntVar) {
-		Symbol* sym = FindSymbolByName(node->token->text);
-		if (sym == nullptr) {
-			throw IdentifierNotFoundException(scanner.fname, node->token->text, _line);
-		}
+		Symbol* sym = node->GetSymbol();
 		if (*sym != stConstFloat && *sym != stConstInteger) {
 			throw IllegalExprException(scanner.fname, _line);
 		}
@@ -624,13 +726,14 @@ Symbol* Parser::ParseArrayDeclaration(bool isOpenArray)
 	return result;
 }
 
-Symbol* Parser::ParseRecordDeclaration()
+Symbol* Parser::ParseRecordDeclaration(bool isPacked)
 {
 	symTable = new SymTable();
 	tableStack.Add(symTable);
 	ParseVariableDeclaration(0);
 	CheckExpectedToken(Tag::END);
-	Symbol* result = new SymTypeRecord(tableStack.Top());
+	SymTypeRecord* result = new SymTypeRecord(tableStack.Top(), isPacked);
+	result->ComputeLayout(isReorderFields);
 	tableStack.Pop();
 	symTable = tableStack.Top();
 	return result;
@@ -674,6 +777,9 @@ Symbol* Parser::ParseType(bool isOpenArray)
 		symbol = ParseArrayDeclaration(isOpenArray);
 	} else if (*token == Tag::RECORD) {
 		symbol = ParseRecordDeclaration();
+	} else if (*token == Tag::PACKED) {
+		CheckExpectedToken(Tag::RECORD);
+		symbol = ParseRecordDeclaration(true);
 	} else {
 		PutToken(token);
 		symbol = ParseSubrangeType();
@@ -732,6 +838,8 @@ SymTable* Parser::ParseProcFuncBlock(SymTable* params, string& name, unsigned de
 	ParseBlock(name, depth);
 	if (!isDeclarationParse) {
 		CheckExpectedToken(Tag::SEMICOLON);
+	} else if (CheckNextTokenTag(Tag::SEMICOLON)) {
+		GetToken();
 	}
 	SymTable* result = tableStack.Top();
 	tableStack.Pop();
@@ -818,6 +926,9 @@ NodeExpr* Parser::ParseIdentifier(TokenPtr token, unsigned depth, bool isLookAhe
 	if (symbol->IsType()) {
 		throw SimpleException(scanner.fname, _line, "Variable identifier expected");
 	}
+	if (!findInCurTable && (*symbol == stVarLocal || *symbol == stParam || *symbol == stVarParam || *symbol == stParamResult)) {
+		MarkFrameAccess(dynamic_cast<SymSubroutineVar*>(symbol)->GetDepth());
+	}
 	NodeExpr* result = new NodeVar(token, symbol, depth);
 	while (isLookAhead) {
 		token = GetToken();
@@ -858,6 +969,8 @@ SyntaxNode* Parser::ParseStatement(unsigned depth)
       statement = CreateWriteNode(token, depth);
 	} else if (*token == Tag::IF) {
 		statement = ParseIfStatement(depth);
+	} else if (*token == Tag::CASE) {
+		statement = ParseCaseStatement(depth);
 	} else if (*token == Tag::WHILE) {
 		statement = ParseWhileStatement(depth);
 	} else if (*token == Tag::FOR) {
@@ -911,6 +1024,54 @@ SyntaxNode* Parser::ParseIfStatement(unsigned depth)
 	return new NodeIfStmt(expr, thenStmt, elseStmt, depth);
 }
 
+int Parser::ParseCaseLabel()
+{
+	int line = _line;
+	Symbol* label = ParseConstantExpression();
+	if (*label != stConstInteger) {
+		throw IncompatibleTypesException(scanner.fname, line, stTypeInteger);
+	}
+	int result = dynamic_cast<SymConstInteger*>(label)->getValue();
+	delete label;
+	return result;
+}
+
+SyntaxNode* Parser::ParseCaseStatement(unsigned depth)
+{
+	NodeExpr* expr = ParseExpression(0, depth);
+	CheckExpectedExpressionType(expr->GetType(), stTypeInteger);
+	CheckExpectedToken(Tag::OF);
+	NodeCaseStmt* caseStmt = new NodeCaseStmt(expr, depth);
+	TokenPtr token;
+	do {
+		do {
+			int low = ParseCaseLabel();
+			int high = low;
+			if (CheckNextTokenTag(Tag::DOUBLE_DOT)) {
+				GetToken();
+				high = ParseCaseLabel();
+			}
+			if (low > high || !caseStmt->AddLabel(low, high)) {
+				throw SimpleException(scanner.fname, _line, "Duplicate case label");
+			}
+		} while (*(token = GetToken()) == Tag::COMMA);
+		PutToken(token);
+		CheckExpectedToken(Tag::COLON);
+		caseStmt->AddBranch(CheckNextTokenTag(Tag::SEMICOLON) ? nullptr : ParseStatement(depth));
+		if (CheckNextTokenTag(Tag::SEMICOLON)) {
+			GetToken();
+		}
+	} while (!CheckNextTokenTag(Tag::ELSE) && !CheckNextTokenTag(Tag::END));
+	if (CheckNextTokenTag(Tag::ELSE)) {
+		GetToken();
+		NodeBlock* elseStmt = new NodeBlock("else");
+		ParseStatementSequence(elseStmt, depth);
+		caseStmt->SetElse(elseStmt);
+	}
+	CheckExpectedToken(Tag::END);
+	return caseStmt;
+}
+
 SyntaxNode* Parser::ParseWhileStatement(unsigned depth)
 {
 	NodeWhileStmt* whileStmt = new NodeWhileStmt(ParseExpression(0, depth), depth);
@@ -933,6 +1094,9 @@ SyntaxNode* Parser::ParseForStatement(unsigned depth)
 		throw SimpleException(scanner.fname, _line, "Integer variable identifier expected");
 	}
 	CheckVariableForLoopUsage(var);
+	if (*var == stVarLocal) {
+		MarkFrameAccess(dynamic_cast<SymSubroutineVar*>(var)->GetDepth());
+	}
 	CheckExpectedToken(Tag::ASSIGNMENT);
 	NodeExpr* initialExpr = ParseExpression(0, depth);
 	if (*(token = GetToken()) != Tag::TO && *token != Tag::DOWNTO) {
@@ -975,7 +1139,7 @@ SyntaxNode* Parser::ParseJumpStatement(TokenPtr token)
 
 NodeCall* Parser::CreateCallNode(NodeExpr* name, Args args, unsigned depth)
 {
-	SymSubroutine* symbol = dynamic_cast<SymSubroutine*>(FindSymbolByName(name->token->text));
+	SymSubroutine* symbol = dynamic_cast<SymSubroutine*>(name->GetSymbol());
 	SymTable* params = symbol->GetParams();
 	if (args.size() != params->Size() - (*symbol == stFunction)) {
 		throw WrongParametersException(scanner.fname, _line, name->token->text);
@@ -985,7 +1149,7 @@ NodeCall* Parser::CreateCallNode(NodeExpr* name, Args args, unsigned depth)
 		if (*(params->symbols[i]) == stVarParam) {
 			Symbol* argType   = args[i]->GetType();
 			if (*paramType == stTypeOpenArray) {
-				if (!paramType->IsEqualType(argType)) {
+				if (!paramType->IsEqualType(argType, canonicalTypes)) {
 					throw IncompatibleTypeArgException(scanner.fname, _line, i + 1, paramType->symType, true);
 				}
 			} else if (*paramType != *argType) {
@@ -997,11 +1161,17 @@ NodeCall* Parser::CreateCallNode(NodeExpr* name, Args args, unsigned depth)
       } else if (*(params->symbols[i]) == stParam) {
 			DoRight2LeftSimpleTypecast(paramType, &args[i]);
 			Symbol* argType = args[i]->GetType();
-			if (!paramType->IsEqualType(argType)) {
+			if (!paramType->IsEqualType(argType, canonicalTypes)) {
 				throw IncompatibleTypeArgException(scanner.fname, _line, i + 1, paramType->symType);
 			}
 		}
 	}
+	if (symbol->IsLinkUsed() || find(subroutineStack.begin(), subroutineStack.end(), symbol) != subroutineStack.end()) {
+		MarkFrameAccess(symbol->GetDepth() - 1);
+	}
+	if (!subroutineStack.empty()) {
+		subroutineStack.back()->AddCall();
+	}
 	return new NodeCall(name, args, depth);
 }
 
@@ -1014,7 +1184,7 @@ NodeArrIdx* Parser::CreateArrIdxNode(NodeExpr* name, unsigned depth)
 			throw IncompatibleTypesException(scanner.fname, _line, stTypeInteger);
 		}
 	}
-	return new NodeArrIdx(name, args, depth);
+	return new NodeArrIdx(name, args, depth, scanner.IsRangeChecked());
 }
 
 NodeWriteBase* Parser::CreateWriteNode(TokenPtr token, unsigned depth)
@@ -1049,7 +1219,7 @@ NodeAssignOp* Parser::CreateAssignmentStatement(TokenPtr token, NodeExpr* stmt,
 	Symbol* ltype = stmt->GetType();
 	DoRight2LeftSimpleTypecast(ltype, &expr);
 	Symbol* rtype = expr->GetType();
-	if (ltype->IsEqualType(rtype)) {
+	if (ltype->IsEqualType(rtype, canonicalTypes)) {
 		result = new NodeAssignOp(token, stmt, expr);
 	} else {
 		throw IncompatibleTypesException(scanner.fname, _line, ltype->symType);
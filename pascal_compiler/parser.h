@@ -9,7 +9,13 @@
 #include "syntax_node.h"
 #include "syntax_nodes.h"
 #include "CodeGen.h"
-#include "optimization.h"
+#include "instruction_scheduling.h"
+#include "ir.h"
+#include "ir_lowering.h"
+#include "ir_optimization.h"
+#include "asm_encoder.h"
+#include "asm_jit.h"
+#include "bytecode.h"
 
 const int PRIORITIES_NUMBER = 4;
 
@@ -43,9 +49,11 @@ class Parser {
    AsmCode asmCode;
 	SyntaxNode* root;
 	SymTable* symTable;
+   CanonicalTypes canonicalTypes;
 	queue<TokenPtr> tokens;
 	SymTableStack tableStack;
 	vector<NodeStmt*> loopStack;
+   vector<SymSubroutine*> subroutineStack;
 	priorityTable _priorities;
 	DeclarationParseList declParseList;
 	ComputableUnaryFuncs computable_unary_op;
@@ -60,9 +68,11 @@ class Parser {
 	void CheckExpectedExpressionType(Symbol*, SymbolType);
 	void CheckExpectedSubroutineType(Symbol*);
 	void CheckVariableForLoopUsage(Symbol*);
+   void MarkFrameAccess(unsigned);
 	void CheckSubrangeBoundType(Symbol*, int);
 	void ReserveOperationPriority(priorityType, int);
 	void ParseBlock(string = "", unsigned = 0);
+	void SkipCompoundStatement();
 	void ParseDeclarationPart(unsigned);
    void ParseConstantDefinition(unsigned);
    void ParseTypeDefinition(unsigned);
@@ -111,7 +121,7 @@ class Parser {
 	Symbol* CreateConstExprSymbol(int);
 	Symbol* ParseConstantExpression();
 	Symbol* ParseArrayDeclaration(bool);
-   Symbol* ParseRecordDeclaration();
+   Symbol* ParseRecordDeclaration(bool = false);
 	Symbol* ParseSubrangeType();
 	Symbol* ParseType(bool = false);
 
@@ -124,6 +134,8 @@ class Parser {
 	
 	SyntaxNode* ParseStatement(unsigned);
 	SyntaxNode* ParseIfStatement(unsigned);
+	SyntaxNode* ParseCaseStatement(unsigned);
+	int ParseCaseLabel();
    SyntaxNode* ParseWhileStatement(unsigned);
    SyntaxNode* ParseForStatement(unsigned);
    SyntaxNode* ParseRepeatStatement(unsigned);
@@ -138,12 +150,22 @@ class Parser {
    NodeWriteBase* CreateWriteNode(TokenPtr, unsigned);
 
 	NodeAssignOp* CreateAssignmentStatement(TokenPtr, NodeExpr*, NodeExpr*);
+   void GenerateIr(IrProgram&);
+   void GenerateCode();
+   void PrintReport(const vector<string>&) const;
 public:
    bool isOptimize;
 	bool isDeclarationParse;
+   bool isReorderFields;
+   size_t inlineThreshold;
+   bool isReport;
 	Scanner scanner;
 	Parser(const Scanner&);
    void Generate();
+   void GenerateObject(ostream&);
+   int Run();
+   int Interpret();
+   void PrintIr();
 	void ParseProgram();
 	void PrintTree();
 	void PrintBlock();
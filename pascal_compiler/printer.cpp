@@ -1,5 +1,6 @@
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <cstdio>
 #include "printer.h"
 #include "token.h"
@@ -88,6 +89,39 @@ void Printer::printAsmCode(Parser& parser)
    parser.Generate();
 }
 
+void Printer::printObjectCode(Parser& parser)
+{
+   string tmp = parser.scanner.fname.substr(0, parser.scanner.fname.find('.') + 1) + "o";
+   ofstream out(tmp, ios::binary);
+   parser.isDeclarationParse = false;
+   parser.ParseProgram();
+   parser.GenerateObject(out);
+}
+
+//the program's output goes to the console as it runs
+int Printer::printProgramOutput(Parser& parser)
+{
+   parser.isDeclarationParse = false;
+   parser.ParseProgram();
+   return parser.Run();
+}
+
+int Printer::printBytecodeOutput(Parser& parser)
+{
+   parser.isDeclarationParse = false;
+   parser.ParseProgram();
+   return parser.Interpret();
+}
+
+void Printer::printIr(Parser& parser)
+{
+   string tmp = parser.scanner.fname.substr(0, parser.scanner.fname.find('.') + 1) + "ir";
+   freopen(tmp.c_str(), "w", stdout);
+   parser.isDeclarationParse = false;
+   parser.ParseProgram();
+   parser.PrintIr();
+}
+
 void Printer::printProgramParseTree(Parser& parser)
 {
 	string tmp = parser.scanner.fname.substr(0, parser.scanner.fname.find('.') + 1) + "comp";
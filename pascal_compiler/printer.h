@@ -15,5 +15,9 @@ public:
    void printTestToFile(Scanner&, bool = true);
 	void printDeclarationTable(Parser&, bool = false);
    void printAsmCode(Parser&);
+   void printObjectCode(Parser&);
+   int printProgramOutput(Parser&);
+   int printBytecodeOutput(Parser&);
+   void printIr(Parser&);
 	void printProgramParseTree(Parser&);
 };
@@ -29,6 +29,7 @@ Scanner::Scanner(const char* _fname):
             _line(1),
             _peek(' '),
             _isEof(false),
+            _isRangeChecked(false),
             fname(_fname),
             _token(nullptr),
             _fin(ifstream(_fname)),
@@ -60,6 +61,7 @@ Scanner::Scanner(const char* _fname):
    reserve<Word>(_keywords, Word(Tag::NIL,       "nil"));
    reserve<Word>(_keywords, Word(Tag::OF,        "of"));
 	reserve<Word>(_keywords, Word(Tag::ORD,       "ord"));
+   reserve<Word>(_keywords, Word(Tag::PACKED,    "packed"));
    reserve<Word>(_keywords, Word(Tag::PROCEDURE, "procedure"));   
    reserve<Word>(_keywords, Word(Tag::PROGRAM,   "program"));
    reserve<Word>(_keywords, Word(Tag::RECORD,    "record"));
@@ -114,6 +116,7 @@ Scanner::Scanner(const Scanner& scanner):
    _line(1),
    _peek(' '),
    _isEof(false),
+   _isRangeChecked(false),
    fname(scanner.fname),
    _token(nullptr),
    _tmp_peeks(vector<char>()),
@@ -143,10 +146,14 @@ bool Scanner::Next()
             incLine();
             continue;
          case '{':
-            do { 
-               readch();
+            readch();
+            if (_peek == '$') {
+               readDirective();
+            }
+            while (_peek != '}' && !_isEof) {
                incLine();
-            } while (_peek != '}' && !_isEof);
+               readch();
+            }
             break;
          case '(':
             {
@@ -390,6 +397,23 @@ TokenPtr Scanner::Get() const
    return _token;
 }
 
+bool Scanner::IsRangeChecked() const
+{
+   return _isRangeChecked;
+}
+
+//{$R+} and {$R-} switch range checks on and off, other directives are ignored
+void Scanner::readDirective()
+{
+   readch();
+   if (_peek == '}' || _isEof) return;
+   char name = toupper(_peek);
+   readch();
+   if (name == 'R' && (_peek == '+' || _peek == '-')) {
+      _isRangeChecked = _peek == '+';
+   }
+}
+
 int Scanner::readBinary(string& text)
 {
    while (true) {
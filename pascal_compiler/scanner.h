@@ -16,6 +16,7 @@ class Scanner {
    int _line;
    char _peek;
    bool _isEof;
+   bool _isRangeChecked;
    ifstream _fin;
    TokenPtr _token;
    key_t _keywords, _separators, _operators;
@@ -33,6 +34,7 @@ class Scanner {
    void addCharToBuffer(const char);
    void incLine();
    void readch();
+   void readDirective();
    bool isBinaryDigit() const;
    bool isDecimalDigit() const;
    bool isHexadecimalDigit() const;
@@ -53,6 +55,7 @@ public:
    ~Scanner();
    bool Next();
    TokenPtr Get() const;
+   bool IsRangeChecked() const;
 };
 
 template<class T>
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include "symbol_table.h"
 
 using namespace std;
@@ -16,6 +17,7 @@ SymTable::SymTable():
    block(nullptr),
    symbols(Symbols()),
    symNames(SymbolNames()),
+   scope(nullptr),
    _tableSize(0)
 {}
 
@@ -24,6 +26,9 @@ void SymTable::Add(Symbol* symbol)
    _tableSize = symbol->IsVar() ? _tableSize + symbol->GetSize() : _tableSize;
 	symbols.push_back(symbol);
 	symNames.insert(make_pair(symbol->name, symbols.size() - 1));
+	if (scope != nullptr) {
+		scope->Bind(symbol->name, this);
+	}
 }
 
 void SymTable::Add(Symbol* symbol, string name)
@@ -55,7 +60,7 @@ void SymTable::SetBlock(NodeBlock* ABlock, string AName)
 	dynamic_cast<NodeBlock*>(block)->name = AName;
 }
 
-void SymTable::GenerateDeclarations(AsmCode& asmCode) const
+void SymTable::GenerateDataDeclarations(AsmCode& asmCode) const
 {
    for (auto &symbol : symbols) {
       if (*symbol == stVarGlobal) {
@@ -64,6 +69,11 @@ void SymTable::GenerateDeclarations(AsmCode& asmCode) const
          dynamic_cast<SymConstFloat*>(symbol)->GenerateDeclaration(asmCode);
       }
    }
+}
+
+void SymTable::GenerateDeclarations(AsmCode& asmCode) const
+{
+   GenerateDataDeclarations(asmCode);
    for (auto &symbol : symbols) {
       if (*symbol == stProcedure || *symbol == stFunction) {
          dynamic_cast<SymSubroutine*>(symbol)->GenerateDeclaration(asmCode);
@@ -71,6 +81,15 @@ void SymTable::GenerateDeclarations(AsmCode& asmCode) const
    }
 }
 
+void SymTable::GenerateIrDeclarations(IrProgram& program) const
+{
+   for (auto &symbol : symbols) {
+      if (*symbol == stProcedure || *symbol == stFunction) {
+         dynamic_cast<SymSubroutine*>(symbol)->GenerateIr(program);
+      }
+   }
+}
+
 void SymTable::Print(int d)
 {
 	for (size_t i = 0; i < symbols.size(); i++) {
@@ -114,10 +133,30 @@ size_t SymTable::GetSize() const
 void SymTableStack::Add(SymTable* table)
 {
 	tables.push(table);
+	table->scope = this;
+	for (auto &symbol: table->symbols) {
+		Bind(symbol->name, table);
+	}
+}
+
+void SymTableStack::Bind(const string& name, SymTable* table)
+{
+	vector<SymTable*>& chain = chains[name];
+	if (chain.empty() || chain.back() != table) {
+		chain.push_back(table);
+	}
 }
 
 void SymTableStack::Pop()
 {
+	SymTable* table = tables.top();
+	for (auto &symbol: table->symbols) {
+		auto it = chains.find(symbol->name);
+		if (it != chains.end() && !it->second.empty() && it->second.back() == table) {
+			it->second.pop_back();
+		}
+	}
+	table->scope = nullptr;
 	tables.pop();
 }
 
@@ -129,7 +168,7 @@ SymTable* SymTableStack::Top()
 SymTable* SymTableStack::GetTop()
 {
 	SymTable* table = tables.top();
-	tables.pop();
+	Pop();
 	return table;
 }
 
@@ -146,26 +185,38 @@ Symbol* SymTableStack::GetSymbol(string& name)
 
 SymTable* SymTableStack::FindSymbolTable(string& name)
 {
-	TableStack tmp;
-	SymTable* table;
-	bool isExist = false;
-	do {
-		table = tables.top();
-		tables.pop();
-		tmp.push(table);
-		isExist = table->FindSymbol(name); 
-	} while(tables.size() != 0 && !isExist);
-	SymTable* result = isExist ? table : nullptr;
-	while (tmp.size() != 0) {
-		tables.push(tmp.top());
-		tmp.pop();
-	}
-	return result;
+	auto it = chains.find(name);
+	return it == chains.end() || it->second.empty() ? nullptr : it->second.back();
 }
 
-SymTypeRecord::SymTypeRecord(SymTable* AFields): SymType(stTypeRecord), fields(AFields)
+SymTypeRecord::SymTypeRecord(SymTable* AFields, bool AIsPacked):
+   SymType(stTypeRecord),
+   fields(AFields),
+   isPacked(AIsPacked),
+   _alignment(1)
 {
 	name = "record";
+   _size = fields->GetSize();
+}
+
+void SymTypeRecord::ComputeLayout(bool isReorder)
+{
+   Symbols order = fields->symbols;
+   if (isReorder) {
+      stable_sort(order.begin(), order.end(), [](Symbol* a, Symbol* b) {
+         return a->GetType()->GetAlignment() > b->GetType()->GetAlignment();
+      });
+   }
+   size_t offset = 0;
+   _alignment = 1;
+   for (auto &field: order) {
+      size_t align = isPacked ? 1 : field->GetType()->GetAlignment();
+      offset = (offset + align - 1) / align * align;
+      field->SetOffset(offset);
+      offset += field->GetSize();
+      _alignment = max(_alignment, align);
+   }
+   _size = (offset + _alignment - 1) / _alignment * _alignment;
 }
 
 void SymTypeRecord::PrintType(int d)
@@ -191,26 +242,31 @@ SymTable* SymTypeRecord::GetFields() const
 	return fields;
 }
 
-bool SymTypeRecord::IsEqualType(Symbol* symbol)
+string SymTypeRecord::GetStructureKey(CanonicalTypes& canonicalTypes)
 {
-	SymTypeRecord* record = dynamic_cast<SymTypeRecord*>(symbol);
-	bool result = record != nullptr && fields->Size() == record->fields->Size();
-	if (result) {
-		for (size_t i = 0; i < fields->Size() && result; i++) {
-			result = result && fields->symbols[i]->GetType()->IsEqualType(record->fields->symbols[i]->GetType());
-		}
+	string result = Symbol::GetStructureKey(canonicalTypes) + (isPacked ? " packed {" : " {");
+	for (auto &field: fields->symbols) {
+		result += " " + GetCanonicalKey(field->GetType(), canonicalTypes) + ";";
 	}
-	return result;
+	return result + " }";
 }
 
 size_t SymTypeRecord::GetSize()
 {
-   return _size = fields->GetSize();
+   return _size;
+}
+
+size_t SymTypeRecord::GetAlignment()
+{
+   return _alignment;
 }
 
-SymSubroutine::SymSubroutine(string& AName, SymbolType AType):
+SymSubroutine::SymSubroutine(string& AName, SymbolType AType, unsigned ADepth):
    Symbol(AType),
-   _label(nullptr)
+   _label(nullptr),
+   _depth(ADepth),
+   _isLinkUsed(false),
+   _hasCalls(false)
 {
 	name = AName;
 }
@@ -225,18 +281,40 @@ void SymSubroutine::SetVars(SymTable* AVars)
 	localVariables = AVars;
 }
 
+//the static link comes in EAX and the first arguments in registers, all of them go to the frame
+//below the locals; a scalar result leaves in EAX and the arguments on the stack are popped by ret
+//unless their size is only known at run time
 void SymSubroutine::GenerateDeclaration(AsmCode& asmCode)
 {
    asmCode.AddSubroutineBegin(_label);
+   size_t begin = asmCode.commands.size();
    asmCode.AddCmd(PUSH, EBP);
    asmCode.AddCmd(MOV, EBP, ESP);
-   if (localVariables->GetSize() > 0) {
-      asmCode.AddCmd(SUB, ESP, localVariables->GetSize());
+   size_t size = GetFrameSize();
+   if (_isLinkUsed) {
+      asmCode.AddCmd(PUSH, EAX);
+      size -= 4;
+   }
+   if (size > 0) {
+      asmCode.AddCmd(SUB, ESP, size);
+   }
+   for (size_t i = 0; i < GetRegisterParamCount(); i++) {
+      asmCode.AddCmd(PUSH, GetArgRegister(i));
    }
    localVariables->block->Generate(asmCode);
+   if (IsResultInRegister()) {
+      asmCode.AddCmd(MOV, EAX, AsmMemory(EBP, -int(GetFrameSize())));
+   }
    asmCode.AddCmd(MOV, ESP, EBP);
    asmCode.AddCmd(POP, EBP);
-   asmCode.AddCmd(RET, 4, szBYTE);
+   if (GetArgsPopSize() > 0) {
+      asmCode.AddCmd(RET, GetArgsPopSize(), szBYTE);
+   } else {
+      asmCode.AddCmd(RET);
+   }
+   if (IsLeaf()) {
+      asmCode.OmitFramePointer(begin);
+   }
    asmCode.AddSubroutineEnd(_label);
    for (auto &symbol : localVariables->symbols) {
       if (*symbol == stProcedure || *symbol == stFunction) {
@@ -245,6 +323,14 @@ void SymSubroutine::GenerateDeclaration(AsmCode& asmCode)
    }
 }
 
+void SymSubroutine::GenerateIr(IrProgram& program)
+{
+   IrBuilder builder(program, _label, localVariables->GetSize());
+   localVariables->block->GenerateIr(builder);
+   builder.Finish();
+   localVariables->GenerateIrDeclarations(program);
+}
+
 void SymSubroutine::PrintSymbol(int d)
 {
 	string fname = " " + name;
@@ -293,8 +379,107 @@ size_t SymSubroutine::GetParamsSize()
    return result;
 }
 
-SymProcedure::SymProcedure(string& AName):
-   SymSubroutine(AName, stProcedure)
+//every local takes at least a double word, as it is pushed and popped whole
+size_t SymSubroutine::GetLocalsSize() const
+{
+   size_t result = 0;
+   for (auto &symbol : localVariables->symbols) {
+      if (*symbol == stVarLocal) {
+         result = max(result, symbol->GetOffset() + max(symbol->GetSize(), size_t(4)));
+      }
+   }
+   return (result + 3) / 4 * 4;
+}
+
+//the link, the locals and the result lie between the frame pointer and the register arguments
+size_t SymSubroutine::GetFrameSize() const
+{
+   size_t size = GetLocalsSize() + (IsResultInRegister() ? 4 : 0);
+   return size > 0 || _isLinkUsed ? size + 4 : 0;
+}
+
+unsigned SymSubroutine::GetDepth() const
+{
+   return _depth;
+}
+
+//the link is kept only by the subroutines whose frames are walked to reach an enclosing one
+void SymSubroutine::UseLink()
+{
+   _isLinkUsed = true;
+}
+
+bool SymSubroutine::IsLinkUsed() const
+{
+   return _isLinkUsed;
+}
+
+void SymSubroutine::AddCall()
+{
+   _hasCalls = true;
+}
+
+//a leaf calls no subroutine and no frame is reached through its own, so it needs no frame pointer
+bool SymSubroutine::IsLeaf() const
+{
+   return !_hasCalls && !_isLinkUsed;
+}
+
+static bool IsPassedInRegister(Symbol* param)
+{
+   Symbol* type = GetReferenceType(param->GetType());
+   return *param == stVarParam ? *type != stTypeOpenArray : *param == stParam && (*type == stTypeInteger || *type == stTypeFloat);
+}
+
+size_t SymSubroutine::GetRegisterParamCount() const
+{
+   size_t result = 0;
+   while (result < REG_ARGS_COUNT && result < params->Size() && IsPassedInRegister(params->symbols[result])) {
+      result++;
+   }
+   return result;
+}
+
+bool SymSubroutine::IsResultInRegister() const
+{
+   return false;
+}
+
+//the offset from the frame pointer of a parameter kept below the locals, zero for the ones on the stack
+int SymSubroutine::GetRegisterOffset(const Symbol* param) const
+{
+   if (param->symType == stParamResult) {
+      return IsResultInRegister() ? -int(GetFrameSize()) : 0;
+   }
+   for (size_t i = 0; i < GetRegisterParamCount(); i++) {
+      if (params->symbols[i] == param) {
+         return -int(GetFrameSize() + 4 * (i + 1));
+      }
+   }
+   return 0;
+}
+
+//the callee pops the arguments on the stack when they are all double words
+size_t SymSubroutine::GetArgsPopSize() const
+{
+   size_t result = 0;
+   for (size_t i = GetRegisterParamCount(); i < params->Size(); i++) {
+      Symbol* param = params->symbols[i];
+      if (*param == stParamResult) break;
+      if (!IsPassedInRegister(param)) return 0;
+      result += 4;
+   }
+   return result;
+}
+
+Register SymSubroutine::GetArgRegister(size_t index)
+{
+   static const Register registers[REG_ARGS_COUNT] = {ECX, EDX};
+   return registers[index];
+}
+
+SymProcedure::SymProcedure(string& AName, unsigned ADepth):
+   SymSubroutine(AName, stProcedure, ADepth)
 {}
 
 void SymProcedure::PrintSymbol(int d)
@@ -308,8 +493,8 @@ void SymProcedure::PrintSymbol(int d)
 	SymSubroutine::PrintSymbol(d);
 }
 
-SymFunction::SymFunction(string& AName):
-   SymSubroutine(AName, stFunction)
+SymFunction::SymFunction(string& AName, unsigned ADepth):
+   SymSubroutine(AName, stFunction, ADepth)
 {}
 
 void SymFunction::SetParams(SymTable* AParams, Symbol* AResultType)
@@ -334,17 +519,28 @@ Symbol* SymFunction::GetResultType() const
 	return resultType;
 }
 
+bool SymFunction::IsResultInRegister() const
+{
+   Symbol* type = GetReferenceType(resultType);
+   return *type == stTypeInteger || *type == stTypeFloat;
+}
+
 
 SymSubroutineVar::SymSubroutineVar(SymbolPtr AType, size_t AOffset, unsigned ADepth, SymbolType ASymbolType):
    SymVar(AType, AOffset, ASymbolType),
    _depth(ADepth)
 {}
 
+unsigned SymSubroutineVar::GetDepth() const
+{
+   return _depth;
+}
+
 void SymSubroutineVar::GetLexicalNesting(AsmCode& asmCode, unsigned stmtDepth) const
 {
    asmCode.AddCmd(MOV, EBX, EBP);
    for (size_t i = 0; i < stmtDepth - _depth; i++) {
-      asmCode.AddCmd(MOV, EBX, AsmMemory(EBX, 8));
+      asmCode.AddCmd(MOV, EBX, AsmMemory(EBX, -4));
    }
 }
 
@@ -352,6 +548,12 @@ SymVarLocal::SymVarLocal(SymbolPtr AType, size_t AOffset, unsigned ADepth):
    SymSubroutineVar(AType, AOffset, ADepth, stVarLocal)
 {}
 
+//the locals lie below the link
+int SymVarLocal::GetFrameOffset() const
+{
+   return -int(4 + _offset + max(type->GetSize(), size_t(4)));
+}
+
 void SymVarLocal::PrintSymbol(int d)
 {
    Symbol::PrintSymbol(d);
@@ -365,16 +567,27 @@ void SymVarLocal::PrintSymbol(int d)
 void SymVarLocal::Generate(AsmCode& asmCode, unsigned stmtDepth) const
 {
    GetLexicalNesting(asmCode, stmtDepth);
-   asmCode.AddCmd(PUSH, AsmMemory(EBX, -int(_offset) - 4));
+   asmCode.AddCmd(PUSH, AsmMemory(EBX, GetFrameOffset()));
 }
 
 void SymVarLocal::GenerateLValue(AsmCode& asmCode, unsigned stmtDepth) const
 {
    GetLexicalNesting(asmCode, stmtDepth);
-   asmCode.AddCmd(ADD, EBX, -int(_offset) - 4);
+   asmCode.AddCmd(ADD, EBX, GetFrameOffset());
    asmCode.AddCmd(PUSH, EBX);
 }
 
+//a variable of an enclosing subroutine is reached through the chain of frames
+AsmMemory* SymVarLocal::GenerateMemory(unsigned stmtDepth) const
+{
+   return stmtDepth == _depth ? new AsmMemory(EBP, GetFrameOffset(), szDWORD) : nullptr;
+}
+
+IrOperand SymVarLocal::GenerateIrLValue(IrBuilder& builder, unsigned stmtDepth) const
+{
+   return builder.Offset(builder.GetFrame(stmtDepth - _depth), -int(_offset + type->GetSize()));
+}
+
 SymParamBase::SymParamBase(SymbolPtr AType, size_t AOffset, SymSubroutine* ASubroutine, unsigned ADepth, SymbolType ASymType):
    SymSubroutineVar(AType, AOffset, ADepth, ASymType),
    subroutine(ASubroutine)
@@ -388,8 +601,14 @@ void SymParamBase::GetParamSize(AsmCode& asmCode) const
 void SymParamBase::GenerateOffsetInStack(AsmCode& asmCode, unsigned stmtDepth) const
 {
    GetLexicalNesting(asmCode, stmtDepth);
-   asmCode.AddCmd(ADD, EBX, 12); //EAX point to the first arg
+   int offset = subroutine->GetRegisterOffset(this);
+   if (offset != 0) {
+      asmCode.AddCmd(ADD, EBX, offset);
+      return;
+   }
+   asmCode.AddCmd(ADD, EBX, 8); //EAX point to the first arg
    Symbols params = subroutine->GetParams()->symbols;
+   params.erase(params.begin(), params.begin() + subroutine->GetRegisterParamCount());
    //      
    bool needBreak = false;
    for (auto &param : params) {
@@ -410,6 +629,29 @@ void SymParamBase::GenerateOffsetInStack(AsmCode& asmCode, unsigned stmtDepth) c
    }
 }
 
+IrOperand SymParamBase::GenerateIrOffsetInStack(IrBuilder& builder, unsigned stmtDepth) const
+{
+   IrOperand result = builder.Offset(builder.GetFrame(stmtDepth - _depth), 12);
+   for (auto &param : subroutine->GetParams()->symbols) {
+      bool isFound = name == param->name;
+      if (*param == stParam && *(param->GetType()) == stTypeArray) {
+         result = builder.Offset(result, 4);
+         if (isFound) break;
+         result = builder.Offset(result, (param->GetSize() + 3) / 4 * 4);
+      } else if (*param == stParam && *(param->GetType()) == stTypeOpenArray) {
+         IrOperand size = builder.Load(result);
+         result = builder.Offset(result, 4);
+         if (isFound) break;
+         result = builder.Binary(irAdd, result, size);
+      } else if (isFound) {
+         break;
+      } else {
+         result = builder.Offset(result, *param == stParam ? (param->GetSize() + 3) / 4 * 4 : 4);
+      }
+   }
+   return result;
+}
+
 SymParam::SymParam(SymbolPtr AType, size_t AOffset, SymSubroutine* ASubroutine, unsigned ADepth) :
    SymParamBase(AType, AOffset, ASubroutine, ADepth, stParam)
 {}
@@ -435,6 +677,33 @@ void SymParam::GenerateLValue(AsmCode& asmCode, unsigned stmtDepth) const
    asmCode.AddCmd(PUSH, EBX);
 }
 
+//the offset is known as long as no array comes before the parameter, the size of which is on the stack
+AsmMemory* SymParam::GenerateMemory(unsigned stmtDepth) const
+{
+   if (stmtDepth != _depth) return nullptr;
+   int offset = subroutine->GetRegisterOffset(this);
+   if (offset != 0) {
+      return new AsmMemory(EBP, offset, szDWORD);
+   }
+   offset = 8;
+   Symbols params = subroutine->GetParams()->symbols;
+   params.erase(params.begin(), params.begin() + subroutine->GetRegisterParamCount());
+   for (auto &param : params) {
+      bool isArray = *param == stParam && (*(param->GetType()) == stTypeOpenArray || *(param->GetType()) == stTypeArray);
+      if (name == param->name) {
+         return new AsmMemory(EBP, offset + (isArray ? 4 : 0), szDWORD);
+      }
+      if (isArray) return nullptr;
+      offset += *param == stParam ? param->GetSize() : 4;
+   }
+   return nullptr;
+}
+
+IrOperand SymParam::GenerateIrLValue(IrBuilder& builder, unsigned stmtDepth) const
+{
+   return GenerateIrOffsetInStack(builder, stmtDepth);
+}
+
 void SymParam::PrintSymbol(int d)
 {
    Symbol::PrintSymbol(d);
@@ -483,6 +752,11 @@ void SymVarParam::GenerateLValue(AsmCode& asmCode, unsigned stmtDepth) const
    asmCode.AddCmd(PUSH, AsmMemory(EBX));
 }
 
+IrOperand SymVarParam::GenerateIrLValue(IrBuilder& builder, unsigned stmtDepth) const
+{
+   return builder.Load(GenerateIrOffsetInStack(builder, stmtDepth));
+}
+
 bool SymVarParam::IsByRef() const
 {
    return true;
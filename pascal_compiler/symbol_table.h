@@ -7,6 +7,8 @@ typedef unordered_map<string, int> SymbolNames;
 typedef vector<Symbol*> Symbols;
 typedef void* Handle;
 
+class SymTableStack;
+
 class SymInterface {
 public:
 	virtual bool FindSymbol(string&) abstract;
@@ -17,6 +19,7 @@ class SymTable: public SymInterface {
    size_t _tableSize;
 	SymbolNames symNames;
 public:
+	SymTableStack* scope;
 	SyntaxNode* block;
 	Symbols symbols;
 	SymTable();
@@ -24,7 +27,9 @@ public:
 	void Add(Symbol*, string);
 	void DeleteParam(string&);
 	void SetBlock(NodeBlock*, string);
+   void GenerateDataDeclarations(AsmCode&) const;
    void GenerateDeclarations(AsmCode&) const;
+   void GenerateIrDeclarations(IrProgram&) const;
 	void Print(int);
 	void PrintBlock(int d);
 	bool FindSymbol(string&) override;
@@ -34,12 +39,15 @@ public:
 };
 
 typedef stack<SymTable*> TableStack;
+typedef unordered_map<string, vector<SymTable*>> ScopeChains;
 
 class SymTableStack: public SymInterface {
 	TableStack tables;
+	ScopeChains chains;
 	SymTable* FindSymbolTable(string&);
 public:
 	void Add(SymTable*);
+	void Bind(const string&, SymTable*);
 	void Pop();
 	SymTable* Top();
 	SymTable* GetTop();
@@ -49,47 +57,72 @@ public:
 
 class SymTypeRecord: public SymType {
 	SymTable* fields;
+   size_t _alignment;
+protected:
+   string GetStructureKey(CanonicalTypes&) override;
 public:
-	SymTypeRecord(SymTable*);
+   bool isPacked;
+	SymTypeRecord(SymTable*, bool = false);
+   void ComputeLayout(bool = false);
 	void PrintType(int) override;
 	void PrintSymbol(int) override;
 	SymTable* GetFields() const;
-	bool IsEqualType(Symbol*) override;
    size_t GetSize() override;
+   size_t GetAlignment() override;
 };
 
+//the leading integer, real and var parameters of a subroutine come in registers
+#define REG_ARGS_COUNT 2
+
 class SymSubroutine: public Symbol {
 protected:
 	SymTable* params;
 	SymTable* localVariables;
    AsmStrImmediate* _label;
+   unsigned _depth;
+   bool _isLinkUsed;
+   bool _hasCalls;
    size_t GetParamsSize();
+   size_t GetLocalsSize() const;
+   size_t GetFrameSize() const;
 public:
-	SymSubroutine(string&, SymbolType);
+	SymSubroutine(string&, SymbolType, unsigned);
 	void SetParams(SymTable*);
 	void SetVars(SymTable*);
 	void PrintSymbol(int) override;
    void GenerateLabel(AsmCode&);
    virtual void GenerateDeclaration(AsmCode&);
+   void GenerateIr(IrProgram&);
 	SymTable* getLocalVars() const;
 	SymTable* GetParams() const;
 	Symbol* GetType() override;
    SymVar* GetArg(unsigned) const;
    AsmStrImmediate* GetLabel() const;
+   unsigned GetDepth() const;
+   void UseLink();
+   bool IsLinkUsed() const;
+   void AddCall();
+   bool IsLeaf() const;
+   size_t GetRegisterParamCount() const;
+   virtual bool IsResultInRegister() const;
+   int GetRegisterOffset(const Symbol*) const;
+   size_t GetArgsPopSize() const;
+   static Register GetArgRegister(size_t);
 };
 
 struct SymProcedure: public SymSubroutine {
-	SymProcedure(string&);
+	SymProcedure(string&, unsigned);
 	void PrintSymbol(int) override;
 };
 
 class SymFunction: public SymSubroutine {
 	Symbol* resultType;
 public:
-	SymFunction(string&);
+	SymFunction(string&, unsigned);
 	void SetParams(SymTable*, Symbol*);
 	void PrintSymbol(int) override;
 	Symbol* GetResultType() const;
+   bool IsResultInRegister() const override;
 };
 
 class SymSubroutineVar: public SymVar {
@@ -98,13 +131,17 @@ protected:
    void GetLexicalNesting(AsmCode&, unsigned) const;
 public:
    SymSubroutineVar(SymbolPtr, size_t, unsigned, SymbolType);
+   unsigned GetDepth() const;
 };
 
 struct SymVarLocal: public SymSubroutineVar {
    SymVarLocal(SymbolPtr, size_t, unsigned);
+   int GetFrameOffset() const;
    void PrintSymbol(int) override;
    void Generate(AsmCode&, unsigned) const override;
    void GenerateLValue(AsmCode&, unsigned) const override;
+   AsmMemory* GenerateMemory(unsigned) const override;
+   IrOperand GenerateIrLValue(IrBuilder&, unsigned) const override;
 };
 
 class SymParamBase: public SymSubroutineVar {
@@ -112,6 +149,7 @@ protected:
    SymSubroutine* subroutine;
    void GetParamSize(AsmCode&) const;
    void GenerateOffsetInStack(AsmCode&, unsigned) const;
+   IrOperand GenerateIrOffsetInStack(IrBuilder&, unsigned) const;
 public:
    SymParamBase(SymbolPtr, size_t, SymSubroutine*, unsigned, SymbolType);
 };
@@ -121,6 +159,8 @@ struct SymParam: public SymParamBase {
    SymParam(SymbolPtr, size_t, SymSubroutine*, unsigned, SymbolType);
    void Generate(AsmCode&, unsigned) const override;
    void GenerateLValue(AsmCode&, unsigned) const override;
+   AsmMemory* GenerateMemory(unsigned) const override;
+   IrOperand GenerateIrLValue(IrBuilder&, unsigned) const override;
    void PrintSymbol(int) override;
 };
 
@@ -133,6 +173,7 @@ struct SymVarParam: public SymParamBase {
    SymVarParam(SymbolPtr, size_t, SymSubroutine*, unsigned);
    void Generate(AsmCode&, unsigned) const override;
    void GenerateLValue(AsmCode&, unsigned) const override;
+   IrOperand GenerateIrLValue(IrBuilder&, unsigned) const override;
    void PrintSymbol(int) override;
    bool IsByRef() const override;
    size_t GetSize() override;
@@ -19,7 +19,8 @@ static void printPart(string str, int len)
 
 Symbol::Symbol(SymbolType AType):
    symType(AType),
-   _size(0)
+   _size(0),
+   _canonical(nullptr)
 {}
 
 bool Symbol::operator ==(const SymbolType type)
@@ -56,6 +57,22 @@ void Symbol::Generate(AsmCode&, unsigned) const
 void Symbol::GenerateLValue(AsmCode&, unsigned) const
 {}
 
+//the variable as an operand when it takes no code to reach it
+AsmMemory* Symbol::GenerateMemory(unsigned) const
+{
+   return nullptr;
+}
+
+IrOperand Symbol::GenerateIrValue(IrBuilder&, unsigned) const
+{
+   return IrOperand();
+}
+
+IrOperand Symbol::GenerateIrLValue(IrBuilder&, unsigned) const
+{
+   return IrOperand();
+}
+
 bool Symbol::IsType()
 {
 	return false;
@@ -81,6 +98,12 @@ size_t Symbol::GetSize()
    return 0;
 }
 
+size_t Symbol::GetAlignment()
+{
+   size_t size = GetSize();
+   return size == 0 || size >= 4 ? 4 : size;
+}
+
 size_t Symbol::GetOffset() const
 {
    return 0;
@@ -91,9 +114,47 @@ Symbol* GetReferenceType(Symbol* symbol)
 	return symbol != nullptr && *symbol == stTypeAlias ? dynamic_cast<SymTypeAlias*>(symbol)->refType : symbol;
 }
 
-bool Symbol::IsEqualType(Symbol* symbol)
+bool Symbol::IsEqualType(Symbol* symbol, CanonicalTypes& canonicalTypes)
+{
+	return symbol != nullptr && GetCanonicalType(canonicalTypes) == symbol->GetCanonicalType(canonicalTypes);
+}
+
+string Symbol::GetStructureKey(CanonicalTypes&)
 {
-	return symbol != nullptr && *this == *symbol;
+	return to_string(symType);
+}
+
+Symbol* Symbol::GetCanonicalType(CanonicalTypes& canonicalTypes)
+{
+	if (_canonical == nullptr) {
+		_canonical =
+			*this == stTypeAlias
+			? GetReferenceType(this)->GetCanonicalType(canonicalTypes)
+			: canonicalTypes.insert(make_pair(GetStructureKey(canonicalTypes), this)).first->second;
+	}
+	return _canonical;
+}
+
+string GetCanonicalKey(Symbol* symbol, CanonicalTypes& canonicalTypes)
+{
+	stringstream str;
+	str << GetReferenceType(symbol)->GetCanonicalType(canonicalTypes);
+	return str.str();
+}
+
+IrType GetIrType(Symbol* symbol)
+{
+   return *GetReferenceType(symbol) == stTypeFloat ? itReal : itInt;
+}
+
+bool IsScalarType(Symbol* symbol)
+{
+   Symbol* type = GetReferenceType(symbol);
+   return
+      *type == stTypeInteger
+   || *type == stTypeFloat
+   || *type == stTypeChar
+   || *type == stTypeSubrange;
 }
 
 SymConst::SymConst(SymbolType AType): Symbol(AType) {}
@@ -134,6 +195,11 @@ void SymConstInteger::Generate(AsmCode& asmCode, unsigned) const
    asmCode.AddCmd(PUSH, value);
 }
 
+IrOperand SymConstInteger::GenerateIrValue(IrBuilder&, unsigned) const
+{
+   return IrImm(value);
+}
+
 SymConstFloat::SymConstFloat(double AValue): SymConst(stConstFloat), value(AValue) {}
 
 double SymConstFloat::getValue() const
@@ -153,7 +219,7 @@ size_t SymConstFloat::GetSize()
 
 void SymConstFloat::GenerateDeclaration(AsmCode& asmCode)
 {
-   constLabel = asmCode.AddData(name, value);
+   constLabel = asmCode.AddConst(value);
 }
 
 void SymConstFloat::Generate(AsmCode& asmCode, unsigned) const
@@ -161,6 +227,11 @@ void SymConstFloat::Generate(AsmCode& asmCode, unsigned) const
    asmCode.AddCmd(PUSH, constLabel);
 }
 
+IrOperand SymConstFloat::GenerateIrValue(IrBuilder& builder, unsigned) const
+{
+   return builder.Load(IrAddr(constLabel), itReal);
+}
+
 void SymConstFloat::PrintSymbol(int d)
 {
 	SymConst::printScalar(d, "double scalar", to_string(value));
@@ -168,7 +239,13 @@ void SymConstFloat::PrintSymbol(int d)
 
 void SymConstCharacterString::Generate(AsmCode& asmCode, unsigned stmtDepth) const
 {
-   asmCode.AddCmd(PUSH, AsmVarAddr(asmCode.AddData(asmCode.GenStrLabel("str"), value)));
+   asmCode.AddCmd(PUSH, AsmVarAddr(asmCode.AddConst(value)));
+}
+
+IrOperand SymConstCharacterString::GenerateIrValue(IrBuilder& builder, unsigned) const
+{
+   AsmCode& asmCode = builder.GetAsmCode();
+   return IrAddr(asmCode.AddConst(value));
 }
 
 SymConstCharacterString::SymConstCharacterString(string& val): SymConst(stConstCharacterString), value(val) {}
@@ -228,6 +305,12 @@ bool SymVar::IsByRef() const
    return false;
 }
 
+IrOperand SymVar::GenerateIrValue(IrBuilder& builder, unsigned stmtDepth) const
+{
+   IrOperand addr = GenerateIrLValue(builder, stmtDepth);
+   return IsScalarType(type.get()) ? builder.Load(addr, GetIrType(type.get())) : addr;
+}
+
 Symbol* SymVar::GetType()
 {
 	return GetReferenceType(type.get());
@@ -273,6 +356,16 @@ void SymVarGlobal::GenerateLValue(AsmCode& asmCode, unsigned) const
    asmCode.AddCmd(PUSH, AsmVarAddr(varLabel));
 }
 
+AsmMemory* SymVarGlobal::GenerateMemory(unsigned) const
+{
+   return new AsmMemory(varLabel, 0, szDWORD);
+}
+
+IrOperand SymVarGlobal::GenerateIrLValue(IrBuilder&, unsigned) const
+{
+   return IrAddr(varLabel);
+}
+
 void SymVarGlobal::PrintSymbol(int d)
 {
    Symbol::PrintSymbol(d);
@@ -312,10 +405,9 @@ void SymTypeSubrange::PrintSymbol(int d)
 	printPart(to_string(d), TABLE_IDX_LEN);
 }
 
-bool SymTypeSubrange::IsEqualType(Symbol* symbol)
+string SymTypeSubrange::GetStructureKey(CanonicalTypes& canonicalTypes)
 {
-	SymTypeSubrange* subrange = dynamic_cast<SymTypeSubrange*>(symbol);
-	return subrange != nullptr && GetLow() == subrange->GetLow() && GetHigh() == subrange->GetHigh();
+	return Symbol::GetStructureKey(canonicalTypes) + " " + getSubrangeStr();
 }
 
 size_t SymTypeSubrange::GetSize()
@@ -353,6 +445,11 @@ void SymTypeArry::PrintSymbol(int d)
 	printPart(to_string(d), TABLE_IDX_LEN);
 }
 
+size_t SymTypeArry::GetAlignment()
+{
+   return GetReferenceType(elemType)->GetAlignment();
+}
+
 int SymTypeArry::GetLow() const
 {
    return 0;
@@ -362,10 +459,15 @@ SymTypeOpenArray::SymTypeOpenArray():
    SymTypeArry(stTypeOpenArray)
 {}
 
-bool SymTypeOpenArray::IsEqualType(Symbol* symbol)
+bool SymTypeOpenArray::IsEqualType(Symbol* symbol, CanonicalTypes& canonicalTypes)
 {
 	SymTypeArry* arry = dynamic_cast<SymTypeArry*>(symbol);
-	return arry != nullptr && elemType->IsEqualType(arry->elemType);
+	return arry != nullptr && GetReferenceType(elemType)->GetCanonicalType(canonicalTypes) == GetReferenceType(arry->elemType)->GetCanonicalType(canonicalTypes);
+}
+
+string SymTypeOpenArray::GetStructureKey(CanonicalTypes& canonicalTypes)
+{
+	return Symbol::GetStructureKey(canonicalTypes) + " of " + GetCanonicalKey(elemType, canonicalTypes);
 }
 
 string SymTypeOpenArray::getTypeValue()
@@ -379,13 +481,10 @@ SymTypeArray::SymTypeArray(Symbol* ASubrange):
    subrange(ASubrange)
 {}
 
-bool SymTypeArray::IsEqualType(Symbol* symbol)
+string SymTypeArray::GetStructureKey(CanonicalTypes& canonicalTypes)
 {
-	SymTypeArray* arry = dynamic_cast<SymTypeArray*>(symbol);
-	return
-		arry != nullptr
-	&& subrange->IsEqualType(arry->subrange)
-	&& GetReferenceType(elemType)->IsEqualType(GetReferenceType(arry->elemType));
+	string range = *subrange == stTypeAlias ? to_string(stTypeAlias) : GetCanonicalKey(subrange, canonicalTypes);
+	return Symbol::GetStructureKey(canonicalTypes) + " [" + range + "] of " + GetCanonicalKey(elemType, canonicalTypes);
 }
 
 string SymTypeArray::getTypeValue()
@@ -459,4 +558,9 @@ void SymTypeAlias::PrintSymbol(int d)
 size_t SymTypeAlias::GetSize()
 {
    return _size = refType->GetSize();
+}
+
+size_t SymTypeAlias::GetAlignment()
+{
+   return refType->GetAlignment();
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <memory>
 #include <unordered_map>
 #include "CodeGen.h"
+#include "ir.h"
 
 using namespace std;
 
@@ -43,9 +44,16 @@ const int NAME_LEN = 8;
 const int TYPE_LEN = 15;
 const int TABLE_IDX_LEN = 2;
 
+class Symbol;
+
+//the first type seen with each structure, owned by the parser
+typedef unordered_map<string, Symbol*> CanonicalTypes;
+
 class Symbol {
 protected:
    size_t _size;
+   Symbol* _canonical;
+   virtual string GetStructureKey(CanonicalTypes&);
 public:
 	string name;
 	SymbolType symType;
@@ -56,12 +64,17 @@ public:
 	virtual void PrintSymbol(int);
    virtual void Generate(AsmCode&, unsigned) const;
    virtual void GenerateLValue(AsmCode&, unsigned) const;
+   virtual AsmMemory* GenerateMemory(unsigned) const;
+   virtual IrOperand GenerateIrValue(IrBuilder&, unsigned) const;
+   virtual IrOperand GenerateIrLValue(IrBuilder&, unsigned) const;
 	virtual bool IsType();
    virtual bool IsVar();
-   virtual bool IsEqualType(Symbol*);
+   virtual bool IsEqualType(Symbol*, CanonicalTypes&);
+   Symbol* GetCanonicalType(CanonicalTypes&);
 	virtual Symbol* GetType();
    virtual string getTypeValue();
    virtual size_t GetSize();
+   virtual size_t GetAlignment();
    virtual size_t GetOffset() const;
 	bool operator ==(const Symbol);
 	bool operator !=(const Symbol);
@@ -70,6 +83,9 @@ public:
 };
 
 Symbol* GetReferenceType(Symbol*);
+string GetCanonicalKey(Symbol*, CanonicalTypes&);
+IrType GetIrType(Symbol*);
+bool IsScalarType(Symbol*);
 
 struct SymConst: public Symbol {
 	SymConst(SymbolType);
@@ -85,6 +101,7 @@ public:
 	Symbol* GetType() override;
    size_t GetSize() override;
    void Generate(AsmCode&, unsigned) const override;
+   IrOperand GenerateIrValue(IrBuilder&, unsigned) const override;
 };
 
 class SymConstFloat: public SymConst {
@@ -98,6 +115,7 @@ public:
    size_t GetSize() override;
    void GenerateDeclaration(AsmCode&);
    void Generate(AsmCode&, unsigned) const override;
+   IrOperand GenerateIrValue(IrBuilder&, unsigned) const override;
 };
 
 class SymConstCharacterString: public SymConst {
@@ -107,6 +125,7 @@ public:
 	void PrintSymbol(int) override;
 	Symbol* GetType() override;
    void Generate(AsmCode&, unsigned) const override;
+   IrOperand GenerateIrValue(IrBuilder&, unsigned) const override;
 };
 
 typedef shared_ptr<Symbol> SymbolPtr;
@@ -127,6 +146,7 @@ public:
    SymVar(SymbolPtr, size_t, SymbolType);
    void SetOffset(size_t) override;
    virtual bool IsByRef() const;
+   IrOperand GenerateIrValue(IrBuilder&, unsigned) const override;
 	Symbol* GetType() override;
    bool IsVar() override;
    size_t GetSize() override;
@@ -140,17 +160,20 @@ public:
    void GenerateDeclaration(AsmCode&);
    void Generate(AsmCode&, unsigned) const override;
    void GenerateLValue(AsmCode&, unsigned) const override;
+   AsmMemory* GenerateMemory(unsigned) const override;
+   IrOperand GenerateIrLValue(IrBuilder&, unsigned) const override;
    void PrintSymbol(int) override;
 };
 
 class SymTypeSubrange: public SymType {
 	int lb, ub;
+protected:
+   string GetStructureKey(CanonicalTypes&) override;
 public:
 	SymTypeSubrange(int, int);
 	void PrintSymbol(int) override;
 	string getTypeValue() override;
 	string getSubrangeStr();
-	bool IsEqualType(Symbol*) override;
    size_t GetSize() override;
    int GetLow() const;
    int GetHigh() const;
@@ -161,20 +184,26 @@ struct SymTypeArry: public SymType {
 	SymTypeArry(SymbolType);
 	void SetElementType(Symbol*);
    void PrintSymbol(int) override;
+   size_t GetAlignment() override;
    virtual int GetLow() const;
 };
 
-struct SymTypeOpenArray: public SymTypeArry {
+class SymTypeOpenArray: public SymTypeArry {
+protected:
+   string GetStructureKey(CanonicalTypes&) override;
+public:
 	SymTypeOpenArray();
-	bool IsEqualType(Symbol*) override;
+	bool IsEqualType(Symbol*, CanonicalTypes&) override;
 	string getTypeValue() override;
 };
 
 
-struct SymTypeArray: public SymTypeArry {
+class SymTypeArray: public SymTypeArry {
+protected:
+   string GetStructureKey(CanonicalTypes&) override;
+public:
 	Symbol* subrange;
 	SymTypeArray(Symbol*);
-	bool IsEqualType(Symbol*) override;
 	string getTypeValue() override;
    size_t GetSize() override;
    int GetLow() const override;
@@ -203,6 +232,7 @@ struct SymTypeAlias: public SymType {
 	SymTypeAlias(Symbol*);
 	void PrintSymbol(int) override;
    size_t GetSize() override;
+   size_t GetAlignment() override;
 };
 
 extern Symbol* typeChar;
@@ -59,6 +59,13 @@ void NodeBlock::Generate(AsmCode& asmCode)
    }
 }
 
+void NodeBlock::GenerateIr(IrBuilder& builder)
+{
+   for (auto &statement : statements) {
+      statement->GenerateIr(builder);
+   }
+}
+
 void NodeBlock::PrintNode(int d)
 {
    for (size_t i = 0; i < statements.size(); i++) {
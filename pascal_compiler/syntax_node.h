@@ -2,6 +2,7 @@
 
 #include "scanner.h"
 #include "CodeGen.h"
+#include "ir.h"
 
 #define FACTOR   6
 #define TAIL_LEN 4
@@ -35,6 +36,7 @@ enum NodeType {
 	ntWhileStmt,
 	ntForStmt,
 	ntRepeateStmt,
+	ntCaseStmt,
    ntIntTypeCast,
    ntRealTypeCast
 };
@@ -49,6 +51,7 @@ public:
 	virtual void PrintNode(int) {};
    virtual void Generate(AsmCode&) {};
    virtual void GenerateLValue(AsmCode&) const {};
+   virtual void GenerateIr(IrBuilder&) {};
 	void PrintText(int, string);
 	bool operator == (NodeType);
 	bool operator != (NodeType);
@@ -64,5 +67,6 @@ struct NodeBlock: public SyntaxNode {
    NodeBlock(Statements, string, NodeType);
    void AddStatement(SyntaxNode*);
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
    void PrintNode(int) override;
 };
\ No newline at end of file
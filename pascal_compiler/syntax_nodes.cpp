@@ -1,11 +1,17 @@
 #include <iostream>
+#include <algorithm>
 #include "syntax_nodes.h"
+#include "instruction_selection.h"
+
+#define CASE_TABLE_MIN     4
+#define CASE_TABLE_DENSITY 3
 
 using namespace std;
 
 NodeSubroutineBlock::NodeSubroutineBlock():
    NodeBlock(ntSubroutineBlock),
-   exitLabel(nullptr)
+   exitLabel(nullptr),
+   exitBlock(nullptr)
 {}
 
 void NodeSubroutineBlock::AddBody(NodeBlock* ABlock)
@@ -26,22 +32,55 @@ AsmLabel* NodeSubroutineBlock::GetExitLabel() const
    return exitLabel;
 }
 
+void NodeSubroutineBlock::GenerateIr(IrBuilder& builder)
+{
+   exitBlock = builder.function->exit;
+   NodeBlock::GenerateIr(builder);
+}
+
+IrBlock* NodeSubroutineBlock::GetExitBlock() const
+{
+   return exitBlock;
+}
+
 NodeExpr::NodeExpr(TokenPtr ptr, NodeType AType, unsigned ADepth):
    token(ptr),
-   SyntaxNode(AType, ADepth)
+   SyntaxNode(AType, ADepth),
+   _type(nullptr),
+   _symbol(nullptr),
+   _isTypeResolved(false),
+   _isSymbolResolved(false)
 {}
 
+Symbol* NodeExpr::GetType()
+{
+	if (!_isTypeResolved) {
+		_type = GetReferenceType(ComputeType());
+		_isTypeResolved = true;
+	}
+	return _type;
+}
+
+Symbol* NodeExpr::GetSymbol()
+{
+	if (!_isSymbolResolved) {
+		_symbol = ComputeSymbol();
+		_isSymbolResolved = true;
+	}
+	return _symbol;
+}
+
 void NodeExpr::PrintNode(int d)
 {
 	SyntaxNode::PrintText(d, *token != ttOperator && *token != ttCharacterString ? token->getValue() : token->text);
 }
 
-Symbol* NodeExpr::GetType()
+Symbol* NodeExpr::ComputeType()
 {
 	return nullptr;
 }
 
-Symbol* NodeExpr::GetSymbol()
+Symbol* NodeExpr::ComputeSymbol()
 {
 	return nullptr;
 }
@@ -56,11 +95,55 @@ bool NodeExpr::IsSubroutineCall()
 	return false;
 }
 
+//whether the value is 0 or 1, so that and, or and not may be evaluated by jumps
+bool NodeExpr::IsCondition()
+{
+   return false;
+}
+
+//whether computing the value may write or stop the program: a call, a checked index or a division
+bool NodeExpr::HasSideEffects()
+{
+   return false;
+}
+
+void NodeExpr::GenerateCondition(AsmCode& asmCode, AsmLabel* label, bool jumpIfTrue)
+{
+   if (InstructionSelector::IsCovered(this)) {
+      InstructionSelector(asmCode).GenerateTest(this);
+   } else {
+      Generate(asmCode);
+      asmCode.AddCmd(POP, EAX);
+      asmCode.AddCmd(TEST, EAX, EAX);
+   }
+   asmCode.AddCmd(jumpIfTrue ? JNE : JE, label);
+}
+
+IrOperand NodeExpr::GenerateIrValue(IrBuilder&)
+{
+   return IrOperand();
+}
+
+IrOperand NodeExpr::GenerateIrLValue(IrBuilder& builder)
+{
+   return GenerateIrValue(builder);
+}
+
+void NodeExpr::GenerateIrCondition(IrBuilder& builder, IrBlock* trueBlock, IrBlock* falseBlock)
+{
+   builder.Branch(GenerateIrValue(builder), trueBlock, falseBlock);
+}
+
+void NodeExpr::GenerateIr(IrBuilder& builder)
+{
+   GenerateIrValue(builder);
+}
+
 NodeIntegerNumber::NodeIntegerNumber(TokenPtr ptr):
    NodeExpr(ptr, ntIntegerNumber, 0)
 {}
 
-Symbol* NodeIntegerNumber::GetType()
+Symbol* NodeIntegerNumber::ComputeType()
 {
    return typeInteger;
 }
@@ -70,18 +153,23 @@ void NodeIntegerNumber::Generate(AsmCode& asmCode)
    asmCode.AddCmd(PUSH, dynamic_cast<IntegerNumber*>(token.get())->value);
 }
 
+IrOperand NodeIntegerNumber::GenerateIrValue(IrBuilder&)
+{
+   return IrImm(dynamic_cast<IntegerNumber*>(token.get())->value);
+}
+
 NodeRealNumber::NodeRealNumber(TokenPtr ptr):
    NodeExpr(ptr, ntRealNumber, 0)
 {}
 
-Symbol* NodeRealNumber::GetType()
+Symbol* NodeRealNumber::ComputeType()
 {
    return typeFloat;
 }
 
 void NodeRealNumber::GenerateData(AsmCode& asmCode)
 {
-   constLabel = asmCode.AddData("v", dynamic_cast<RealNumber*>(token.get())->value);
+   constLabel = asmCode.AddConst(dynamic_cast<RealNumber*>(token.get())->value);
 }
 
 void NodeRealNumber::Generate(AsmCode& asmCode)
@@ -89,11 +177,16 @@ void NodeRealNumber::Generate(AsmCode& asmCode)
    asmCode.AddCmd(PUSH, constLabel);
 }
 
+IrOperand NodeRealNumber::GenerateIrValue(IrBuilder& builder)
+{
+   return builder.Load(IrAddr(constLabel), itReal);
+}
+
 NodeCharacterString::NodeCharacterString(TokenPtr ptr, unsigned ADepth):
    NodeExpr(ptr, ntCharacterString, ADepth)
 {}
 
-Symbol* NodeCharacterString::GetType()
+Symbol* NodeCharacterString::ComputeType()
 {
 	Symbol* symbol(nullptr);
 	if (dynamic_cast<CharacterString*>(token.get())->value.length() == 1) {
@@ -106,7 +199,13 @@ Symbol* NodeCharacterString::GetType()
 
 void NodeCharacterString::Generate(AsmCode& asmCode)
 {
-   asmCode.AddCmd(PUSH, AsmVarAddr(asmCode.AddData(asmCode.GenStrLabel("str"), token->getValue())));
+   asmCode.AddCmd(PUSH, AsmVarAddr(asmCode.AddConst(token->getValue())));
+}
+
+IrOperand NodeCharacterString::GenerateIrValue(IrBuilder& builder)
+{
+   AsmCode& asmCode = builder.GetAsmCode();
+   return IrAddr(asmCode.AddConst(token->getValue()));
 }
 
 NodeVar::NodeVar(TokenPtr ptr, Symbol* ASymbol, unsigned ADepth):
@@ -114,13 +213,13 @@ NodeVar::NodeVar(TokenPtr ptr, Symbol* ASymbol, unsigned ADepth):
    symbol(ASymbol)
 {}
 
-Symbol* NodeVar::GetType()
+Symbol* NodeVar::ComputeType()
 {
 	SymVar* symVar = dynamic_cast<SymVar*>(symbol);
 	return symVar != nullptr ? GetReferenceType(symVar->type.get()) : symbol->GetType();
 }
 
-Symbol* NodeVar::GetSymbol()
+Symbol* NodeVar::ComputeSymbol()
 {
 	return symbol;
 }
@@ -144,6 +243,16 @@ void NodeVar::GenerateLValue(AsmCode& asmCode) const
    symbol->GenerateLValue(asmCode, depth);
 }
 
+IrOperand NodeVar::GenerateIrValue(IrBuilder& builder)
+{
+   return symbol->GenerateIrValue(builder, depth);
+}
+
+IrOperand NodeVar::GenerateIrLValue(IrBuilder& builder)
+{
+   return symbol->GenerateIrLValue(builder, depth);
+}
+
 NodeUnaryOp::NodeUnaryOp(TokenPtr ptr, NodeExpr* NodeExpr_child, unsigned ADepth):
    NodeExpr(ptr, ntUnaryOp, ADepth),
    arg(NodeExpr_child)
@@ -154,7 +263,7 @@ NodeUnaryOp::NodeUnaryOp(TokenPtr ptr, NodeExpr* NodeExpr_child, NodeType AType,
    arg(NodeExpr_child)
 {}
 
-Symbol* NodeUnaryOp::GetType()
+Symbol* NodeUnaryOp::ComputeType()
 {
 	Symbol* result = arg->GetType();
 	if (*token == ttOperator && (*result != stTypeInteger && *result != stTypeFloat)) {
@@ -165,6 +274,10 @@ Symbol* NodeUnaryOp::GetType()
 
 void NodeUnaryOp::Generate(AsmCode& asmCode)
 {
+   if (InstructionSelector::IsCovered(this)) {
+      InstructionSelector(asmCode).Generate(this);
+      return;
+   }
    arg->Generate(asmCode);
    if (*(arg->GetType()) == stTypeInteger) {
       GenerateForInt(asmCode);
@@ -173,12 +286,55 @@ void NodeUnaryOp::Generate(AsmCode& asmCode)
    }
 }
 
+bool NodeUnaryOp::IsCondition()
+{
+   return token->tag == Tag::NEGATION && *(arg->GetType()) == stTypeInteger;
+}
+
+bool NodeUnaryOp::HasSideEffects()
+{
+   return arg->HasSideEffects();
+}
+
+void NodeUnaryOp::GenerateCondition(AsmCode& asmCode, AsmLabel* label, bool jumpIfTrue)
+{
+   if (IsCondition()) {
+      arg->GenerateCondition(asmCode, label, !jumpIfTrue);
+   } else {
+      NodeExpr::GenerateCondition(asmCode, label, jumpIfTrue);
+   }
+}
+
 void NodeUnaryOp::PrintNode(int d)
 {
 	arg->PrintNode(d + 1);
 	NodeExpr::PrintNode(d);
 }
 
+IrOperand NodeUnaryOp::GenerateIrValue(IrBuilder& builder)
+{
+   IrOperand value = arg->GenerateIrValue(builder);
+   if (*(arg->GetType()) == stTypeFloat) {
+      return token->tag == Tag::SUBTRACTION ? builder.Unary(irFNeg, value) : value;
+   }
+   switch (token->tag) {
+      case Tag::NEGATION:
+         return builder.Binary(irSetEq, value, IrImm(0));
+      case Tag::SUBTRACTION:
+         return builder.Unary(irNeg, value);
+   }
+   return value;
+}
+
+void NodeUnaryOp::GenerateIrCondition(IrBuilder& builder, IrBlock* trueBlock, IrBlock* falseBlock)
+{
+   if (IsCondition()) {
+      arg->GenerateIrCondition(builder, falseBlock, trueBlock);
+   } else {
+      NodeExpr::GenerateIrCondition(builder, trueBlock, falseBlock);
+   }
+}
+
 void NodeUnaryOp::GenerateForInt(AsmCode& asmCode) const
 {
    asmCode.AddCmd(POP, EAX);
@@ -225,7 +381,7 @@ NodeIntegerTypecast::NodeIntegerTypecast(NodeExpr* AArg):
    NodeTypecast(AArg, ntIntTypeCast)
 {}
 
-Symbol* NodeIntegerTypecast::GetType()
+Symbol* NodeIntegerTypecast::ComputeType()
 {
    return typeInteger;
 }
@@ -235,6 +391,11 @@ void NodeIntegerTypecast::Generate(AsmCode& asmCode)
    GenerateIntegerTypecast(asmCode);
 }
 
+IrOperand NodeIntegerTypecast::GenerateIrValue(IrBuilder& builder)
+{
+   return arg->GenerateIrValue(builder);
+}
+
 void NodeIntegerTypecast::PrintNode(int d)
 {
    arg->PrintNode(d + 1);
@@ -245,7 +406,7 @@ NodeRealTypecast::NodeRealTypecast(NodeExpr* AArg):
    NodeTypecast(AArg, ntRealTypeCast)
 {}
 
-Symbol* NodeRealTypecast::GetType()
+Symbol* NodeRealTypecast::ComputeType()
 {
    return typeFloat;
 }
@@ -258,6 +419,11 @@ void NodeRealTypecast::Generate(AsmCode& asmCode)
    GenerateRealTypecast(asmCode);
 }
 
+IrOperand NodeRealTypecast::GenerateIrValue(IrBuilder& builder)
+{
+   return builder.Unary(irIntToReal, arg->GenerateIrValue(builder));
+}
+
 void NodeRealTypecast::PrintNode(int d)
 {
 	arg->PrintNode(d + 1);
@@ -268,7 +434,7 @@ NodeOrd::NodeOrd(TokenPtr ptr, NodeExpr* AArg, unsigned ADepth):
    NodeUnaryOp(ptr, AArg, ntOrd, ADepth)
 {}
 
-Symbol* NodeOrd::GetType()
+Symbol* NodeOrd::ComputeType()
 {
 	Symbol* symbol(nullptr);
 	if (*(arg->GetType()) == stTypeChar) {
@@ -281,7 +447,7 @@ NodeChr::NodeChr(TokenPtr ptr, NodeExpr* AArg, unsigned ADepth):
    NodeUnaryOp(ptr, AArg, ntChr, ADepth)
 {}
 
-Symbol* NodeChr::GetType()
+Symbol* NodeChr::ComputeType()
 {
 	Symbol* symbol(nullptr);
 	if (*(arg->GetType()) == stTypeInteger) {
@@ -306,7 +472,7 @@ NodeExpr* NodeBinary::GetRight() const
    return right;
 }
 
-Symbol* NodeBinary::GetType()
+Symbol* NodeBinary::ComputeType()
 {
 	Symbol* result(nullptr);
 	Symbol* leftType = left->GetType();
@@ -328,6 +494,12 @@ Symbol* NodeBinary::GetType()
 	return result != nullptr ? GetReferenceType(result) : result;	
 }
 
+bool NodeBinary::HasSideEffects()
+{
+   bool isDivision = (token->tag == Tag::DIV || token->tag == Tag::MOD) && *right != ntIntegerNumber;
+   return isDivision || left->HasSideEffects() || right->HasSideEffects();
+}
+
 void NodeBinary::PrintNode(int d)
 {
 	right->PrintNode(d + 1);
@@ -339,8 +511,56 @@ NodeBinaryOp::NodeBinaryOp(TokenPtr ptr, NodeExpr* l, NodeExpr* r, unsigned ADep
    NodeBinary(ptr, l, r, ntBinaryOp, ADepth)
 {}
 
+static bool IsRelationalOp(int tag)
+{
+   return tag == Tag::EQ || tag == Tag::NE || tag == Tag::LT || tag == Tag::LE || tag == Tag::GT || tag == Tag::GE;
+}
+
+//the jump taken when the comparison holds, or does not if jumpIfTrue is false;
+//real operands are compared by the fpu in reverse order
+static OpCode GetJumpOpCode(int tag, bool isReal, bool jumpIfTrue)
+{
+   if (!jumpIfTrue) {
+      switch (tag) {
+         case Tag::EQ: tag = Tag::NE; break;
+         case Tag::NE: tag = Tag::EQ; break;
+         case Tag::LT: tag = Tag::GE; break;
+         case Tag::LE: tag = Tag::GT; break;
+         case Tag::GT: tag = Tag::LE; break;
+         default:      tag = Tag::LT; break;
+      }
+   }
+   switch (tag) {
+      case Tag::EQ: return JE;
+      case Tag::NE: return JNE;
+      case Tag::LT: return isReal ? JA : JL;
+      case Tag::LE: return isReal ? JAE : JLE;
+      case Tag::GT: return isReal ? JB : JG;
+      default:      return isReal ? JBE : JGE;
+   }
+}
+
+//a comparison is 0 or 1 whatever its operands are
+Symbol* NodeBinaryOp::ComputeType()
+{
+   Symbol* result = NodeBinary::ComputeType();
+   return result != nullptr && IsRelationalOp(token->tag) ? typeInteger : result;
+}
+
+bool NodeBinaryOp::IsCondition()
+{
+   if (token->tag == Tag::AND || token->tag == Tag::OR) {
+      return left->IsCondition() && right->IsCondition();
+   }
+   return IsRelationalOp(token->tag);
+}
+
 void NodeBinaryOp::Generate(AsmCode& asmCode)
 {
+   if (InstructionSelector::IsCovered(this)) {
+      InstructionSelector(asmCode).Generate(this);
+      return;
+   }
    left->Generate(asmCode);
    right->Generate(asmCode);
    if (*(left->GetType()) == stTypeInteger) {
@@ -350,6 +570,95 @@ void NodeBinaryOp::Generate(AsmCode& asmCode)
    }
 }
 
+IrOperand NodeBinaryOp::GenerateIrValue(IrBuilder& builder)
+{
+   GetType();
+   IrOperand l = left->GenerateIrValue(builder);
+   IrOperand r = right->GenerateIrValue(builder);
+   bool isReal = *(left->GetType()) == stTypeFloat;
+   IrOpCode op;
+   switch (token->tag) {
+      case Tag::ADDITION:       op = isReal ? irFAdd : irAdd; break;
+      case Tag::SUBTRACTION:    op = isReal ? irFSub : irSub; break;
+      case Tag::MULTIPLICATION: op = isReal ? irFMul : irMul; break;
+      case Tag::DIVISION:       op = irFDiv; break;
+      case Tag::DIV:            op = irDiv; break;
+      case Tag::MOD:            op = irMod; break;
+      case Tag::AND:            op = irAnd; break;
+      case Tag::OR:             op = irOr; break;
+      case Tag::XOR:            op = irXor; break;
+      case Tag::SHL:            op = irShl; break;
+      case Tag::SHR:            op = irShr; break;
+      case Tag::EQ:             op = isReal ? irFSetEq : irSetEq; break;
+      case Tag::NE:             op = isReal ? irFSetNe : irSetNe; break;
+      case Tag::LT:             op = isReal ? irFSetLt : irSetLt; break;
+      case Tag::LE:             op = isReal ? irFSetLe : irSetLe; break;
+      case Tag::GT:             op = isReal ? irFSetGt : irSetGt; break;
+      case Tag::GE:             op = isReal ? irFSetGe : irSetGe; break;
+      default:                  return l;
+   }
+   return builder.Binary(op, l, r);
+}
+
+//and and or of conditions skip the right operand once the left one decides the result
+void NodeBinaryOp::GenerateCondition(AsmCode& asmCode, AsmLabel* label, bool jumpIfTrue)
+{
+   if (!IsCondition()) {
+      NodeExpr::GenerateCondition(asmCode, label, jumpIfTrue);
+      return;
+   }
+   if (token->tag == Tag::AND || token->tag == Tag::OR) {
+      bool isAnd = token->tag == Tag::AND;
+      if (isAnd != jumpIfTrue) {
+         left->GenerateCondition(asmCode, label, jumpIfTrue);
+         right->GenerateCondition(asmCode, label, jumpIfTrue);
+      } else {
+         AsmLabel* skipLbl = asmCode.GenLabel(isAnd ? "and" : "or");
+         left->GenerateCondition(asmCode, skipLbl, !jumpIfTrue);
+         right->GenerateCondition(asmCode, label, jumpIfTrue);
+         asmCode.AddLabel(skipLbl);
+      }
+      return;
+   }
+   bool isReal = *(left->GetType()) == stTypeFloat;
+   if (InstructionSelector::IsCovered(this)) {
+      InstructionSelector(asmCode).GenerateCompare(this);
+      asmCode.AddCmd(GetJumpOpCode(token->tag, isReal, jumpIfTrue), label);
+      return;
+   }
+   left->Generate(asmCode);
+   right->Generate(asmCode);
+   if (isReal) {
+      asmCode.AddCmd(FLD, AsmMemory(ESP, 4, szDWORD));
+      asmCode.AddCmd(FLD, AsmMemory(ESP, 0, szDWORD));
+      asmCode.AddCmd(ADD, ESP, 8);
+      asmCode.AddCmd(FCOMPP);
+      asmCode.AddCmd(FNSTSW, AX);
+      asmCode.AddCmd(SAHF);
+   } else {
+      asmCode.AddCmd(POP, EBX);
+      asmCode.AddCmd(POP, EAX);
+      asmCode.AddCmd(CMP, EAX, EBX);
+   }
+   asmCode.AddCmd(GetJumpOpCode(token->tag, isReal, jumpIfTrue), label);
+}
+
+void NodeBinaryOp::GenerateIrCondition(IrBuilder& builder, IrBlock* trueBlock, IrBlock* falseBlock)
+{
+   if (!IsCondition() || (token->tag != Tag::AND && token->tag != Tag::OR)) {
+      NodeExpr::GenerateIrCondition(builder, trueBlock, falseBlock);
+      return;
+   }
+   IrBlock* rightBlock = builder.NewBlock();
+   if (token->tag == Tag::AND) {
+      left->GenerateIrCondition(builder, rightBlock, falseBlock);
+   } else {
+      left->GenerateIrCondition(builder, trueBlock, rightBlock);
+   }
+   builder.SetBlock(rightBlock);
+   right->GenerateIrCondition(builder, trueBlock, falseBlock);
+}
+
 void NodeBinaryOp::GenerateForInt(AsmCode& asmCode) const
 {
    asmCode.AddCmd(POP, EBX);
@@ -365,11 +674,12 @@ void NodeBinaryOp::GenerateForInt(AsmCode& asmCode) const
          asmCode.AddCmd(IMUL, EBX);
          break;
       case Tag::DIVISION:
-         asmCode.AddCmd(XOR, EDX, EDX);
+      case Tag::DIV:
+         asmCode.AddCmd(CDQ);
          asmCode.AddCmd(IDIV, EBX);
          break;
       case Tag::MOD:
-         asmCode.AddCmd(XOR, EDX, EDX);
+         asmCode.AddCmd(CDQ);
          asmCode.AddCmd(IDIV, EBX);
          asmCode.AddCmd(PUSH, EDX);
          return;
@@ -383,15 +693,12 @@ void NodeBinaryOp::GenerateForInt(AsmCode& asmCode) const
          asmCode.AddCmd(XOR, EAX, EBX);
          break;
       case Tag::SHR:
-         //asmCode.AddCmd(SAR, EAX, EBX);
-         //asmCode.AddCmd(SAR, EBX, EAX);
-         //asmCode.AddCmd(PUSH, EBX);
-         //return;
+         asmCode.AddCmd(MOV, ECX, EBX);
+         asmCode.AddCmd(SHR, EAX, CL);
          break;
       case Tag::SHL:
-         //asmCode.AddCmd(SAL, EAX, EBX);
-         //asmCode.AddCmd(PUSH, EBX);
-         //return;
+         asmCode.AddCmd(MOV, ECX, EBX);
+         asmCode.AddCmd(SHL, EAX, CL);
          break;
       case Tag::NEGATION:
          asmCode.AddCmd(NOT, EAX, EBX);
@@ -489,8 +796,21 @@ NodeAssignOp::NodeAssignOp(TokenPtr ptr, NodeExpr* l, NodeExpr* r):
    NodeBinary(ptr, l, r, ntAssignOp, 0)
 {}
 
+void NodeAssignOp::GenerateIr(IrBuilder& builder)
+{
+   IrOperand value = right->GenerateIrValue(builder);
+   IrOperand addr = left->GenerateIrLValue(builder);
+   Symbol* type = left->GetType();
+   if (IsScalarType(type)) {
+      builder.Store(addr, value);
+   } else {
+      builder.Copy(addr, value, type->GetSize());
+   }
+}
+
 void NodeAssignOp::Generate(AsmCode& asmCode)
 {
+   if (InstructionSelector(asmCode).GenerateStore(left, right)) return;
    right->Generate(asmCode);
    left->GenerateLValue(asmCode);
    asmCode.AddCmd(POP, EAX);
@@ -527,12 +847,12 @@ NodeRecordAccess::NodeRecordAccess(TokenPtr ptr, NodeExpr* l, NodeExpr* r, unsig
    NodeBinary(ptr, l, r, ntRecordAccess, ADepth)
 {}
 
-Symbol* NodeRecordAccess::GetType()
+Symbol* NodeRecordAccess::ComputeType()
 {
 	return right->GetType();
 }
 
-Symbol* NodeRecordAccess::GetSymbol()
+Symbol* NodeRecordAccess::ComputeSymbol()
 {
 	return right->GetSymbol();
 }
@@ -545,7 +865,7 @@ bool NodeRecordAccess::IsLValue()
 void NodeRecordAccess::Generate(AsmCode& asmCode)
 {
    GenerateLValue(asmCode);
-   asmCode.PushMemory(dynamic_cast<NodeVar*>(right)->symbol->GetType()->GetSize());
+   asmCode.PushMemory(right->GetType()->GetSize());
 }
 
 void NodeRecordAccess::GenerateLValue(AsmCode& asmCode) const
@@ -556,6 +876,17 @@ void NodeRecordAccess::GenerateLValue(AsmCode& asmCode) const
    asmCode.AddCmd(PUSH, EAX);
 }
 
+IrOperand NodeRecordAccess::GenerateIrValue(IrBuilder& builder)
+{
+   IrOperand addr = GenerateIrLValue(builder);
+   return IsScalarType(GetType()) ? builder.Load(addr, GetIrType(GetType())) : addr;
+}
+
+IrOperand NodeRecordAccess::GenerateIrLValue(IrBuilder& builder)
+{
+   return builder.Offset(left->GenerateIrLValue(builder), dynamic_cast<NodeVar*>(right)->symbol->GetOffset());
+}
+
 NodeArgs::NodeArgs(Args AArgs, NodeType AType, unsigned ADepth):
    args(AArgs),
    NodeExpr(nullptr, AType, ADepth)
@@ -568,27 +899,122 @@ void NodeArgs::PrintNode(int d)
 	}
 }
 
+bool NodeArgs::HasSideEffects()
+{
+   for (auto &arg : args) {
+      if (arg->HasSideEffects()) return true;
+   }
+   return false;
+}
+
 NodeWriteBase::NodeWriteBase(Args AArgs, NodeType AType, unsigned ADepth):
    NodeArgs(AArgs, AType, ADepth)
 {}
 
-void NodeWriteBase::Generate(AsmCode& asmCode)
+//adjacent constant strings are one string and writeln ends the last of them with the newline;
+//the values of a batch are computed first and written by one call, the stack code computes them
+//back to front; a value with side effects starts a new batch so that the output keeps its order
+//and the next value starts another one so that it is not computed before the side effects
+vector<WriteItems> NodeWriteBase::GetBatches()
 {
+   vector<WriteItems> batches(1);
+   bool isAfterSideEffects = false;
    for (auto &arg : args) {
-      if (arg->IsLValue()) {
-         arg->GenerateLValue(asmCode);
-         asmCode.AddCmd(POP, EAX);
-         asmCode.AddCmd(PUSH, AsmMemory(EAX, 0, szDWORD));
-      } else {
-         arg->Generate(asmCode);
+      WriteItems& batch = batches.back();
+      if (*arg == ntCharacterString) {
+         if (!batch.empty() && batch.back().arg == nullptr && batch.back().kind == 's') {
+            batch.back().text += arg->token->getValue();
+         } else {
+            batch.push_back({'s', nullptr, arg->token->getValue()});
+         }
+         continue;
+      }
+      bool hasSideEffects = arg->HasSideEffects();
+      if ((hasSideEffects || isAfterSideEffects) && !batch.empty()) {
+         batches.push_back(WriteItems());
       }
+      isAfterSideEffects = hasSideEffects;
       Symbol* type = arg->GetType();
-      if (*type == stTypeInteger) {
-         asmCode.GenCallWriteForInt();
-      } else if (*type == stTypeFloat) {
-         asmCode.GenCallWriteForReal();
+      char kind = *type == stTypeInteger ? 'i' : *type == stTypeFloat ? 'r' : 's';
+      batches.back().push_back({kind, arg, ""});
+   }
+   WriteItems& batch = batches.back();
+   if (*this == ntWriteln) {
+      if (!batch.empty() && batch.back().arg == nullptr && batch.back().kind == 's') {
+         batch.back().text += '\n';
       } else {
-         asmCode.GenCallWriteForStr();
+         batch.push_back({'n', nullptr, ""});
+      }
+   }
+   if (batch.empty()) {
+      batches.pop_back();
+   }
+   return batches;
+}
+
+static void GenerateWriteValue(AsmCode& asmCode, const WriteItem& item)
+{
+   if (item.arg == nullptr) {
+      asmCode.AddCmd(PUSH, AsmVarAddr(asmCode.AddConst(item.text)));
+   } else if (item.arg->IsLValue()) {
+      item.arg->GenerateLValue(asmCode);
+      asmCode.AddCmd(POP, EAX);
+      asmCode.AddCmd(PUSH, AsmMemory(EAX, 0, szDWORD));
+   } else {
+      item.arg->Generate(asmCode);
+   }
+}
+
+void NodeWriteBase::Generate(AsmCode& asmCode)
+{
+   for (auto &batch : GetBatches()) {
+      if (batch.size() >= WRITE_LIST_MIN) {
+         string kinds;
+         for (auto item = batch.rbegin(); item != batch.rend(); item++) {
+            if (item->kind != 'n') {
+               GenerateWriteValue(asmCode, *item);
+            }
+            kinds = item->kind + kinds;
+         }
+         asmCode.GenCallWriteList(kinds);
+         continue;
+      }
+      for (auto &item : batch) {
+         if (item.kind != 'n') {
+            GenerateWriteValue(asmCode, item);
+         }
+         switch (item.kind) {
+            case 'i': asmCode.GenCallWriteForInt(); break;
+            case 'r': asmCode.GenCallWriteForReal(); break;
+            case 's': asmCode.GenCallWriteForStr(); break;
+            default:  asmCode.GenWriteNewLine(); break;
+         }
+      }
+   }
+}
+
+//the writes of a batch stay next to each other, the lowering makes them one call
+void NodeWriteBase::GenerateIr(IrBuilder& builder)
+{
+   AsmCode& asmCode = builder.GetAsmCode();
+   for (auto &batch : GetBatches()) {
+      vector<IrOperand> values;
+      for (auto &item : batch) {
+         if (item.arg != nullptr) {
+            values.push_back(item.arg->GenerateIrValue(builder));
+         } else if (item.kind == 's') {
+            values.push_back(IrAddr(asmCode.AddConst(item.text)));
+         } else {
+            values.push_back(IrOperand());
+         }
+      }
+      for (size_t i = 0; i < batch.size(); i++) {
+         switch (batch[i].kind) {
+            case 'i': builder.Write(irWriteInt, values[i]); break;
+            case 'r': builder.Write(irWriteReal, values[i]); break;
+            case 's': builder.Write(irWriteStr, values[i]); break;
+            default:  builder.Write(irWriteLn); break;
+         }
       }
    }
 }
@@ -613,12 +1039,6 @@ void NodeWriteln::PrintNode(int d)
    SyntaxNode::PrintText(d, "writeln");
 }
 
-void NodeWriteln::Generate(AsmCode& asmCode)
-{
-   NodeWriteBase::Generate(asmCode);
-   asmCode.GenWriteNewLine();
-}
-
 NodeCall::NodeCall(NodeExpr* ACallName, Args AArgs, unsigned ADepth):
 		NodeArgs(AArgs, ntCall, ADepth),
       callName(ACallName)
@@ -636,13 +1056,18 @@ bool NodeCall::IsSubroutineCall()
 	return true;
 }
 
-Symbol* NodeCall::GetType()
+bool NodeCall::HasSideEffects()
+{
+   return true;
+}
+
+Symbol* NodeCall::ComputeType()
 {
    Symbol* symbol = GetSymbol();
    return *symbol == stFunction ? GetReferenceType(dynamic_cast<SymFunction*>(symbol)->GetResultType()) : typeDefault;
 }
 
-Symbol* NodeCall::GetSymbol()
+Symbol* NodeCall::ComputeSymbol()
 {
    return callName->GetSymbol();
 }
@@ -650,7 +1075,7 @@ Symbol* NodeCall::GetSymbol()
 void NodeCall::Generate(AsmCode& asmCode)
 {
    SymSubroutine* subroutine = dynamic_cast<SymSubroutine*>(callName->GetSymbol());
-   if (*subroutine == stFunction) {
+   if (*subroutine == stFunction && !subroutine->IsResultInRegister()) {
       asmCode.AddCmd(SUB, ESP, dynamic_cast<SymFunction*>(subroutine)->GetResultType()->GetSize());
    }
    size_t size = 0;
@@ -668,14 +1093,74 @@ void NodeCall::Generate(AsmCode& asmCode)
          size += args[i]->GetType()->GetSize();
       }
    }
-   asmCode.AddCmd(PUSH, EBP);
+   for (size_t i = 0; i < subroutine->GetRegisterParamCount(); i++) {
+      asmCode.PopRegister(SymSubroutine::GetArgRegister(i));
+      size -= 4;
+   }
+   //the link is the frame of the subroutine the callee is declared in
+   if (subroutine->IsLinkUsed()) {
+      asmCode.AddCmd(MOV, EAX, EBP);
+      for (unsigned i = subroutine->GetDepth() - 1; i < depth; i++) {
+         asmCode.AddCmd(MOV, EAX, AsmMemory(EAX, -4));
+      }
+   }
    asmCode.AddCmd(CALL, subroutine->GetLabel());
-   asmCode.AddCmd(ADD, ESP, size);
+   if (size > 0 && subroutine->GetArgsPopSize() == 0) {
+      asmCode.AddCmd(ADD, ESP, size);
+   }
+   if (subroutine->IsResultInRegister()) {
+      asmCode.AddCmd(PUSH, EAX);
+   }
+}
+
+IrOperand NodeCall::GenerateIrValue(IrBuilder& builder)
+{
+   SymSubroutine* subroutine = dynamic_cast<SymSubroutine*>(callName->GetSymbol());
+   size_t resultSize = 0;
+   if (*subroutine == stFunction) {
+      resultSize = (dynamic_cast<SymFunction*>(subroutine)->GetResultType()->GetSize() + 3) / 4 * 4;
+      builder.Alloc(resultSize);
+   }
+   size_t size = 0;
+   for (int i = args.size() - 1; i >= 0; i--) {
+      if (subroutine->GetArg(i)->IsByRef()) {
+         builder.Push(args[i]->GenerateIrLValue(builder));
+         size += 4;
+         continue;
+      }
+      Symbol* type = args[i]->GetType();
+      IrOperand value = args[i]->GenerateIrValue(builder);
+      if (IsScalarType(type)) {
+         builder.Push(value);
+         size += 4;
+      } else {
+         builder.PushBlock(value, type->GetSize());
+         size += (type->GetSize() + 3) / 4 * 4;
+         if (*type == stTypeArray) {
+            builder.Push(IrImm(type->GetSize()));
+            size += 4;
+         }
+      }
+   }
+   //the link is the frame of the subroutine the callee is declared in
+   IrOperand link = subroutine->IsLinkUsed() ? builder.GetFrame(depth + 1 - subroutine->GetDepth()) : IrFrame();
+   builder.Call(subroutine->GetLabel(), size, link);
+   if (resultSize == 0) {
+      return IrOperand();
+   }
+   Symbol* resultType = GetType();
+   if (IsScalarType(resultType)) {
+      return builder.Pop(GetIrType(resultType));
+   }
+   IrOperand result = builder.AllocTemp(resultSize);
+   builder.PopBlock(result, resultSize);
+   return result;
 }
 
-NodeArrIdx::NodeArrIdx(NodeExpr* AArrName, Args AArgs, unsigned ADepth):
+NodeArrIdx::NodeArrIdx(NodeExpr* AArrName, Args AArgs, unsigned ADepth, bool AIsRangeChecked):
    NodeArgs(AArgs, ntArrIdx, ADepth),
-   arrName(AArrName)
+   arrName(AArrName),
+   isRangeChecked(AIsRangeChecked)
 {}
 
 void NodeArrIdx::PrintNode(int d)
@@ -685,7 +1170,7 @@ void NodeArrIdx::PrintNode(int d)
 	arrName->PrintNode(d + 1);
 }
 
-Symbol* NodeArrIdx::GetType()
+Symbol* NodeArrIdx::ComputeType()
 {
 	Symbol* arrType = arrName->GetType();
    for (size_t i = 0; i < args.size() && (*(GetReferenceType(arrType)) == stTypeArray || *(GetReferenceType(arrType)) == stTypeOpenArray); i++) {
@@ -694,7 +1179,7 @@ Symbol* NodeArrIdx::GetType()
 	return GetReferenceType(arrType);
 }
 
-Symbol* NodeArrIdx::GetSymbol()
+Symbol* NodeArrIdx::ComputeSymbol()
 {
    return arrName->GetSymbol();
 }
@@ -704,8 +1189,17 @@ bool NodeArrIdx::IsLValue()
 	return arrName->IsLValue();
 }
 
+bool NodeArrIdx::HasSideEffects()
+{
+   return isRangeChecked || arrName->HasSideEffects() || NodeArgs::HasSideEffects();
+}
+
 void NodeArrIdx::Generate(AsmCode& asmCode)
 {
+   if (InstructionSelector::IsCovered(this)) {
+      InstructionSelector(asmCode).Generate(this);
+      return;
+   }
    ComputeIndexToEax(asmCode);
    size_t size = dynamic_cast<SymTypeArry*>(arrName->GetSymbol()->GetType())->elemType->GetSize();
    asmCode.PushMemory(size);
@@ -713,9 +1207,43 @@ void NodeArrIdx::Generate(AsmCode& asmCode)
 
 void NodeArrIdx::GenerateLValue(AsmCode& asmCode) const
 {
+   if (InstructionSelector::IsAddressCovered(this)) {
+      InstructionSelector(asmCode).GenerateAddress(this);
+      return;
+   }
    ComputeIndexToEax(asmCode);
 }
 
+IrOperand NodeArrIdx::GenerateIrValue(IrBuilder& builder)
+{
+   IrOperand addr = ComputeIrAddress(builder);
+   return IsScalarType(GetType()) ? builder.Load(addr, GetIrType(GetType())) : addr;
+}
+
+IrOperand NodeArrIdx::GenerateIrLValue(IrBuilder& builder)
+{
+   return ComputeIrAddress(builder);
+}
+
+IrOperand NodeArrIdx::ComputeIrAddress(IrBuilder& builder)
+{
+   IrOperand addr = arrName->GenerateIrLValue(builder);
+   SymTypeArry* type = dynamic_cast<SymTypeArry*>(arrName->GetType());
+   for (auto &arg : args) {
+      int size = type->elemType->GetSize();
+      IrOperand value = arg->GenerateIrValue(builder);
+      SymTypeArray* bounds = dynamic_cast<SymTypeArray*>(type);
+      if (isRangeChecked && bounds != nullptr) {
+         builder.Check(value, bounds->GetLow(), bounds->GetHigh());
+      }
+      IrOperand index = builder.Binary(irMul, value, IrImm(size));
+      addr = builder.Offset(builder.Binary(irAdd, addr, index), -type->GetLow() * size);
+      SymTypeArry* arry = dynamic_cast<SymTypeArry*>(GetReferenceType(type->elemType));
+      type = arry != nullptr ? arry : type;
+   }
+   return addr;
+}
+
 void NodeArrIdx::ComputeIndexToEax(AsmCode& asmCode) const
 {
    arrName->GenerateLValue(asmCode);
@@ -725,6 +1253,11 @@ void NodeArrIdx::ComputeIndexToEax(AsmCode& asmCode) const
       asmCode.AddCmd(MOV, EBX, type->elemType->GetSize());
       asmCode.AddCmd(POP, EAX);
       asmCode.AddCmd(SUB, EAX, type->GetLow());
+      SymTypeArray* bounds = dynamic_cast<SymTypeArray*>(type);
+      if (isRangeChecked && bounds != nullptr) {
+         asmCode.AddCmd(CMP, EAX, bounds->GetHigh() - bounds->GetLow());
+         asmCode.AddCmd(JA, asmCode.GetRangeErrorLabel());
+      }
       asmCode.AddCmd(IMUL, EAX, EBX);
       asmCode.AddCmd(POP, EBX);
       asmCode.AddCmd(ADD, EAX, EBX);
@@ -758,6 +1291,11 @@ void NodeExitStmt::Generate(AsmCode& asmCode)
    asmCode.AddCmd(JMP, dynamic_cast<NodeSubroutineBlock*>(block)->GetExitLabel());
 }
 
+void NodeExitStmt::GenerateIr(IrBuilder& builder)
+{
+   builder.Jump(dynamic_cast<NodeSubroutineBlock*>(block)->GetExitBlock());
+}
+
 NodeJumpStmt::NodeJumpStmt(NodeStmt* ALoop, NodeType AType):
    NodeStmt(AType, 0),
    loop(ALoop)
@@ -778,6 +1316,11 @@ void NodeBreakStmt::Generate(AsmCode& asmCode)
    asmCode.AddCmd(JMP, dynamic_cast<NodeLoopStmtBase*>(loop)->GetBreakLabel());
 }
 
+void NodeBreakStmt::GenerateIr(IrBuilder& builder)
+{
+   builder.Jump(dynamic_cast<NodeLoopStmtBase*>(loop)->GetBreakBlock());
+}
+
 NodeContinueStmt::NodeContinueStmt(NodeStmt* ALoop):
    NodeJumpStmt(ALoop, ntContinueStmt)
 {}
@@ -792,6 +1335,11 @@ void NodeContinueStmt::Generate(AsmCode& asmCode)
    asmCode.AddCmd(JMP, dynamic_cast<NodeLoopStmtBase*>(loop)->GetContinueLabel());
 }
 
+void NodeContinueStmt::GenerateIr(IrBuilder& builder)
+{
+   builder.Jump(dynamic_cast<NodeLoopStmtBase*>(loop)->GetContinueBlock());
+}
+
 NodeExprStmt::NodeExprStmt(NodeExpr* AExpr, NodeType AType, unsigned ADepth):
    NodeStmt(AType, ADepth),
    expr(AExpr)
@@ -823,14 +1371,10 @@ void NodeIfStmt::PrintNode(int d)
 
 void NodeIfStmt::Generate(AsmCode& asmCode)
 {
-   expr->Generate(asmCode);
    bool hasElse = elseStmt != nullptr;
    AsmLabel* endIfLbl = asmCode.GenLabel("endif");
    AsmLabel* elseLbl = hasElse ? asmCode.GenLabel("else") : nullptr;
-   asmCode.AddCmd(POP, EAX);
-   asmCode.AddCmd(MOV, EBX, 0);
-   asmCode.AddCmd(CMP, EAX, EBX);
-   asmCode.AddCmd(JE, hasElse ? elseLbl : endIfLbl);
+   expr->GenerateCondition(asmCode, hasElse ? elseLbl : endIfLbl, false);
    thenStmt->Generate(asmCode);
    if (hasElse) {
       asmCode.AddCmd(JMP, endIfLbl);
@@ -841,6 +1385,211 @@ void NodeIfStmt::Generate(AsmCode& asmCode)
    asmCode.AddLabel(endIfLbl);
 }
 
+void NodeIfStmt::GenerateIr(IrBuilder& builder)
+{
+   IrBlock* thenBlock = builder.NewBlock();
+   IrBlock* elseBlock = elseStmt != nullptr ? builder.NewBlock() : nullptr;
+   IrBlock* endIfBlock = builder.NewBlock();
+   expr->GenerateIrCondition(builder, thenBlock, elseBlock != nullptr ? elseBlock : endIfBlock);
+   builder.SetBlock(thenBlock);
+   thenStmt->GenerateIr(builder);
+   if (elseBlock != nullptr) {
+      builder.Jump(endIfBlock);
+      builder.SetBlock(elseBlock);
+      elseStmt->GenerateIr(builder);
+   }
+   builder.SetBlock(endIfBlock);
+}
+
+NodeCaseStmt::NodeCaseStmt(NodeExpr* AExpr, unsigned ADepth):
+   NodeExprStmt(AExpr, ntCaseStmt, ADepth),
+   elseStmt(nullptr)
+{}
+
+//labels are kept sorted, false for one overlapping another
+bool NodeCaseStmt::AddLabel(int low, int high)
+{
+   auto it = find_if(labels.begin(), labels.end(), [&](const CaseLabel& label) { return label.low > high; });
+   if (it != labels.begin() && (it - 1)->high >= low) {
+      return false;
+   }
+   CaseLabel label = { low, high, branches.size() };
+   labels.insert(it, label);
+   return true;
+}
+
+void NodeCaseStmt::AddBranch(SyntaxNode* stmt)
+{
+   branches.push_back(stmt);
+}
+
+void NodeCaseStmt::SetElse(SyntaxNode* stmt)
+{
+   elseStmt = stmt;
+}
+
+void NodeCaseStmt::PrintNode(int d)
+{
+	expr->PrintNode(d + 2);
+	SyntaxNode::PrintText(d + 1, "expr");
+	cout << endl;
+	SyntaxNode::PrintText(d, "case block");
+	cout << endl;
+	for (size_t i = 0; i < branches.size(); i++) {
+		string text;
+		for (auto &label : labels) {
+			if (label.branch == i) {
+				text += (text.empty() ? "" : ", ") + to_string(label.low) + (label.low != label.high ? ".." + to_string(label.high) : "");
+			}
+		}
+		SyntaxNode::PrintText(d + 1, text);
+		if (branches[i] != nullptr) {
+			branches[i]->PrintNode(d + 2);
+		}
+		cout << endl;
+	}
+	if (elseStmt != nullptr) {
+		SyntaxNode::PrintText(d + 1, "else");
+		cout << endl;
+		elseStmt->PrintNode(d + 2);
+	}
+}
+
+//a table pays off when there are a few labels and the holes between them are not much larger
+bool NodeCaseStmt::IsDense(size_t begin, size_t end) const
+{
+   return
+         end - begin >= CASE_TABLE_MIN
+      && (long long)labels[end - 1].high - labels[begin].low < CASE_TABLE_DENSITY * (long long)(end - begin);
+}
+
+//the selector is in EAX
+void NodeCaseStmt::GenerateCases(AsmCode& asmCode, size_t begin, size_t end, const vector<AsmLabel*>& targets, AsmLabel* elseLbl) const
+{
+   if (IsDense(begin, end)) {
+      int low = labels[begin].low;
+      vector<AsmLabel*> table(labels[end - 1].high - low + 1, elseLbl);
+      for (size_t i = begin; i < end; i++) {
+         fill(table.begin() + labels[i].low - low, table.begin() + labels[i].high - low + 1, targets[labels[i].branch]);
+      }
+      asmCode.AddCmd(SUB, EAX, low);
+      asmCode.AddCmd(CMP, EAX, int(table.size() - 1));
+      asmCode.AddCmd(JA, elseLbl);
+      asmCode.AddCmd(JMP, AsmMemory(asmCode.AddData(table), EAX, 4, 0, szDWORD));
+   } else if (end - begin < CASE_TABLE_MIN) {
+      for (size_t i = begin; i < end; i++) {
+         const CaseLabel& label = labels[i];
+         if (label.low == label.high) {
+            asmCode.AddCmd(CMP, EAX, label.low);
+            asmCode.AddCmd(JE, targets[label.branch]);
+            continue;
+         }
+         AsmLabel* nextLbl = asmCode.GenLabel("case");
+         asmCode.AddCmd(CMP, EAX, label.low);
+         asmCode.AddCmd(JL, nextLbl);
+         asmCode.AddCmd(CMP, EAX, label.high);
+         asmCode.AddCmd(JG, nextLbl);
+         asmCode.AddCmd(JMP, targets[label.branch]);
+         asmCode.AddLabel(nextLbl);
+      }
+      asmCode.AddCmd(JMP, elseLbl);
+   } else {
+      size_t middle = (begin + end) / 2;
+      AsmLabel* lowerLbl = asmCode.GenLabel("case");
+      asmCode.AddCmd(CMP, EAX, labels[middle].low);
+      asmCode.AddCmd(JL, lowerLbl);
+      GenerateCases(asmCode, middle, end, targets, elseLbl);
+      asmCode.AddLabel(lowerLbl);
+      GenerateCases(asmCode, begin, middle, targets, elseLbl);
+   }
+}
+
+void NodeCaseStmt::Generate(AsmCode& asmCode)
+{
+   expr->Generate(asmCode);
+   asmCode.AddCmd(POP, EAX);
+   AsmLabel* endCaseLbl = asmCode.GenLabel("endcase");
+   AsmLabel* elseLbl = elseStmt != nullptr ? asmCode.GenLabel("else") : endCaseLbl;
+   vector<AsmLabel*> targets;
+   for (size_t i = 0; i < branches.size(); i++) {
+      targets.push_back(asmCode.GenLabel("case"));
+   }
+   GenerateCases(asmCode, 0, labels.size(), targets, elseLbl);
+   for (size_t i = 0; i < branches.size(); i++) {
+      asmCode.AddLabel(targets[i]);
+      if (branches[i] != nullptr) {
+         branches[i]->Generate(asmCode);
+      }
+      asmCode.AddCmd(JMP, endCaseLbl);
+   }
+   if (elseStmt != nullptr) {
+      asmCode.AddLabel(elseLbl);
+      elseStmt->Generate(asmCode);
+   }
+   asmCode.AddLabel(endCaseLbl);
+}
+
+void NodeCaseStmt::GenerateIrCases(IrBuilder& builder, IrOperand value, size_t begin, size_t end, const vector<IrBlock*>& targets, IrBlock* elseBlock) const
+{
+   if (IsDense(begin, end)) {
+      int low = labels[begin].low;
+      vector<IrBlock*> cases(labels[end - 1].high - low + 1, elseBlock);
+      for (size_t i = begin; i < end; i++) {
+         fill(cases.begin() + labels[i].low - low, cases.begin() + labels[i].high - low + 1, targets[labels[i].branch]);
+      }
+      builder.Switch(value, low, elseBlock, cases);
+   } else if (end - begin < CASE_TABLE_MIN) {
+      for (size_t i = begin; i < end; i++) {
+         const CaseLabel& label = labels[i];
+         IrBlock* nextBlock = builder.NewBlock();
+         if (label.low != label.high) {
+            IrBlock* upperBlock = builder.NewBlock();
+            builder.Branch(builder.Binary(irSetLt, value, IrImm(label.low)), nextBlock, upperBlock);
+            builder.SetBlock(upperBlock);
+            builder.Branch(builder.Binary(irSetLe, value, IrImm(label.high)), targets[label.branch], nextBlock);
+         } else {
+            builder.Branch(builder.Binary(irSetEq, value, IrImm(label.low)), targets[label.branch], nextBlock);
+         }
+         builder.SetBlock(nextBlock);
+      }
+      builder.Jump(elseBlock);
+   } else {
+      size_t middle = (begin + end) / 2;
+      IrBlock* lowerBlock = builder.NewBlock();
+      IrBlock* upperBlock = builder.NewBlock();
+      builder.Branch(builder.Binary(irSetLt, value, IrImm(labels[middle].low)), lowerBlock, upperBlock);
+      builder.SetBlock(lowerBlock);
+      GenerateIrCases(builder, value, begin, middle, targets, elseBlock);
+      builder.SetBlock(upperBlock);
+      GenerateIrCases(builder, value, middle, end, targets, elseBlock);
+   }
+}
+
+void NodeCaseStmt::GenerateIr(IrBuilder& builder)
+{
+   IrOperand value = expr->GenerateIrValue(builder);
+   IrBlock* endCaseBlock = builder.NewBlock();
+   IrBlock* elseBlock = elseStmt != nullptr ? builder.NewBlock() : endCaseBlock;
+   vector<IrBlock*> targets;
+   for (size_t i = 0; i < branches.size(); i++) {
+      targets.push_back(builder.NewBlock());
+   }
+   GenerateIrCases(builder, value, 0, labels.size(), targets, elseBlock);
+   for (size_t i = 0; i < branches.size(); i++) {
+      builder.SetBlock(targets[i]);
+      if (branches[i] != nullptr) {
+         branches[i]->GenerateIr(builder);
+      }
+      builder.Jump(endCaseBlock);
+   }
+   if (elseStmt != nullptr) {
+      builder.SetBlock(elseBlock);
+      elseStmt->GenerateIr(builder);
+      builder.Jump(endCaseBlock);
+   }
+   builder.SetBlock(endCaseBlock);
+}
+
 void NodeLoopStmtBase::GenerateLoopLabels(AsmCode& asmCode)
 {
    breakLabel = asmCode.GenLabel("lend");
@@ -857,6 +1606,22 @@ AsmLabel* NodeLoopStmtBase::GetContinueLabel() const
    return continueLabel;
 }
 
+void NodeLoopStmtBase::GenerateIrLoopBlocks(IrBuilder& builder)
+{
+   breakBlock = builder.NewBlock();
+   continueBlock = builder.NewBlock();
+}
+
+IrBlock* NodeLoopStmtBase::GetBreakBlock() const
+{
+   return breakBlock;
+}
+
+IrBlock* NodeLoopStmtBase::GetContinueBlock() const
+{
+   return continueBlock;
+}
+
 NodeWhileStmt::NodeWhileStmt(NodeExpr* AExpr, unsigned ADepth):
    NodeExprStmt(AExpr, ntWhileStmt, ADepth)
 {}
@@ -883,16 +1648,24 @@ void NodeWhileStmt::Generate(AsmCode& asmCode)
 {
    GenerateLoopLabels(asmCode);
    asmCode.AddLabel(continueLabel);
-   expr->Generate(asmCode);
-   asmCode.AddCmd(POP, EAX);
-   asmCode.AddCmd(MOV, EBX, 0);
-   asmCode.AddCmd(CMP, EAX, EBX);
-   asmCode.AddCmd(JE, breakLabel);
+   expr->GenerateCondition(asmCode, breakLabel, false);
    stmt->Generate(asmCode);
    asmCode.AddCmd(JMP, continueLabel);
    asmCode.AddLabel(breakLabel);
 }
 
+void NodeWhileStmt::GenerateIr(IrBuilder& builder)
+{
+   GenerateIrLoopBlocks(builder);
+   builder.SetBlock(continueBlock);
+   IrBlock* bodyBlock = builder.NewBlock();
+   expr->GenerateIrCondition(builder, bodyBlock, breakBlock);
+   builder.SetBlock(bodyBlock);
+   stmt->GenerateIr(builder);
+   builder.Jump(continueBlock);
+   builder.SetBlock(breakBlock);
+}
+
 NodeRepeateStmt::NodeRepeateStmt(unsigned ADepth):
    NodeExprStmt(nullptr, ntRepeateStmt, ADepth)
 {}
@@ -918,15 +1691,21 @@ void NodeRepeateStmt::Generate(AsmCode& asmCode)
    GenerateLoopLabels(asmCode);
    asmCode.AddLabel(continueLabel);
    stmtSeq->Generate(asmCode);
-   expr->Generate(asmCode);
-   asmCode.AddCmd(POP, EAX);
-   asmCode.AddCmd(MOV, EBX, 0);
-   asmCode.AddCmd(CMP, EAX, EBX);
-   asmCode.AddCmd(JE, continueLabel);
-   asmCode.AddCmd(JMP, breakLabel);
+   expr->GenerateCondition(asmCode, continueLabel, false);
    asmCode.AddLabel(breakLabel);
 }
 
+void NodeRepeateStmt::GenerateIr(IrBuilder& builder)
+{
+   GenerateIrLoopBlocks(builder);
+   IrBlock* bodyBlock = builder.NewBlock();
+   builder.SetBlock(bodyBlock);
+   stmtSeq->GenerateIr(builder);
+   builder.SetBlock(continueBlock);
+   expr->GenerateIrCondition(builder, breakBlock, bodyBlock);
+   builder.SetBlock(breakBlock);
+}
+
 NodeForStmt::NodeForStmt(Symbol* AVar, NodeExpr* AInitialExpr, NodeExpr* AFinalExpr, LoopForType AType, unsigned ADepth):
 	NodeStmt(ntForStmt, ADepth),
    var(AVar),
@@ -982,6 +1761,26 @@ void NodeForStmt::Generate(AsmCode& asmCode)
    asmCode.AddLabel(breakLabel);
 }
 
+void NodeForStmt::GenerateIr(IrBuilder& builder)
+{
+   IrOperand initial = initialExpr->GenerateIrValue(builder);
+   builder.Store(var->GenerateIrLValue(builder, depth), initial);
+   GenerateIrLoopBlocks(builder);
+   IrBlock* headBlock = builder.NewBlock();
+   IrBlock* bodyBlock = builder.NewBlock();
+   builder.SetBlock(headBlock);
+   IrOperand counter = var->GenerateIrValue(builder, depth);
+   IrOperand cond = builder.Binary(loopType == loopTo ? irSetGt : irSetLt, counter, finalExpr->GenerateIrValue(builder));
+   builder.Branch(cond, breakBlock, bodyBlock);
+   builder.SetBlock(bodyBlock);
+   stmt->GenerateIr(builder);
+   builder.SetBlock(continueBlock);
+   IrOperand addr = var->GenerateIrLValue(builder, depth);
+   builder.Store(addr, builder.Offset(builder.Load(addr), loopType == loopTo ? 1 : -1));
+   builder.Jump(headBlock);
+   builder.SetBlock(breakBlock);
+}
+
 bool NodeForStmt::IsForLoop()
 {
 	return true;
@@ -6,54 +6,77 @@
 
 class NodeSubroutineBlock: public NodeBlock {
    AsmLabel* exitLabel;
+   IrBlock* exitBlock;
 public:
    NodeSubroutineBlock();
 	void AddBody(NodeBlock*);
    void Generate(AsmCode&)override;
+   void GenerateIr(IrBuilder&) override;
    AsmLabel* GetExitLabel() const;
+   IrBlock* GetExitBlock() const;
 };
 
-struct NodeExpr: public SyntaxNode {
+class NodeExpr: public SyntaxNode {
+	Symbol* _type;
+	Symbol* _symbol;
+	bool _isTypeResolved;
+	bool _isSymbolResolved;
+protected:
+	virtual Symbol* ComputeType();
+	virtual Symbol* ComputeSymbol();
+public:
 	TokenPtr token;
 	NodeExpr(TokenPtr, NodeType, unsigned);
 	void PrintNode(int) override;
-	virtual Symbol* GetType();
-	virtual Symbol* GetSymbol();
+	Symbol* GetType();
+	Symbol* GetSymbol();
 	virtual bool IsLValue();
 	virtual bool IsSubroutineCall();
+   virtual bool IsCondition();
+   virtual bool HasSideEffects();
+   virtual void GenerateCondition(AsmCode&, AsmLabel*, bool);
+   virtual IrOperand GenerateIrValue(IrBuilder&);
+   virtual IrOperand GenerateIrLValue(IrBuilder&);
+   virtual void GenerateIrCondition(IrBuilder&, IrBlock*, IrBlock*);
+   void GenerateIr(IrBuilder&) override;
 };
 
 typedef vector<NodeExpr*> Args;
 
 struct NodeIntegerNumber: public NodeExpr {
    NodeIntegerNumber(TokenPtr);
-   Symbol* GetType() override;
+   Symbol* ComputeType() override;
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
 };
 
 class NodeRealNumber: public NodeExpr {
    AsmStrImmediate* constLabel;
 public:
    NodeRealNumber(TokenPtr);
-   Symbol* GetType() override;
+   Symbol* ComputeType() override;
    void GenerateData(AsmCode&);
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
 };
 
 struct NodeCharacterString: public NodeExpr {
 	NodeCharacterString(TokenPtr, unsigned);
-	Symbol* GetType() override;
+	Symbol* ComputeType() override;
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
 };
 
 struct NodeVar: public NodeExpr {
 	Symbol* symbol;
 	NodeVar(TokenPtr, Symbol*, unsigned);
-	Symbol* GetType() override;
-	Symbol* GetSymbol();   
+	Symbol* ComputeType() override;
+	Symbol* ComputeSymbol() override;
 	bool IsLValue() override;
    void Generate(AsmCode&) override;
    void GenerateLValue(AsmCode&) const override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
+   IrOperand GenerateIrLValue(IrBuilder&) override;
 };
 
 class NodeUnaryOp: public NodeExpr {
@@ -63,8 +86,13 @@ public:
 	NodeExpr* arg;
 	NodeUnaryOp(TokenPtr, NodeExpr*, unsigned);
 	NodeUnaryOp(TokenPtr, NodeExpr*, NodeType, unsigned);
-   Symbol* GetType() override;
+   Symbol* ComputeType() override;
+   bool IsCondition() override;
+   bool HasSideEffects() override;
    void Generate(AsmCode&) override;
+   void GenerateCondition(AsmCode&, AsmLabel*, bool) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
+   void GenerateIrCondition(IrBuilder&, IrBlock*, IrBlock*) override;
 	void PrintNode(int) override;
 };
 
@@ -78,26 +106,28 @@ public:
 
 struct NodeIntegerTypecast: public NodeTypecast {
    NodeIntegerTypecast(NodeExpr*);
-   Symbol* GetType() override;
+   Symbol* ComputeType() override;
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
    void PrintNode(int) override;
 };
 
 struct NodeRealTypecast: public NodeTypecast {
    NodeRealTypecast(NodeExpr*);
-   Symbol* GetType() override;
+   Symbol* ComputeType() override;
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
    void PrintNode(int) override;
 };
 
 struct NodeOrd: public NodeUnaryOp {
    NodeOrd(TokenPtr, NodeExpr*, unsigned);
-	Symbol* GetType() override;
+	Symbol* ComputeType() override;
 };
 
 struct NodeChr: public NodeUnaryOp {
    NodeChr(TokenPtr, NodeExpr*, unsigned);
-	Symbol* GetType() override;
+	Symbol* ComputeType() override;
 };
 
 class NodeBinary: public NodeExpr {
@@ -108,7 +138,8 @@ public:
    NodeBinary(TokenPtr, NodeExpr*, NodeExpr*, NodeType, unsigned);
    NodeExpr* GetLeft() const;
    NodeExpr* GetRight() const;
-	Symbol* GetType() override;
+	Symbol* ComputeType() override;
+   bool HasSideEffects() override;
 	void PrintNode(int) override;
 };
 
@@ -119,32 +150,52 @@ class NodeBinaryOp: public NodeBinary {
    void GenerateForRealRelationalOp(AsmCode&) const;
 public:
    NodeBinaryOp(TokenPtr, NodeExpr*, NodeExpr*, unsigned);
+   Symbol* ComputeType() override;
+   bool IsCondition() override;
    void Generate(AsmCode&) override;
+   void GenerateCondition(AsmCode&, AsmLabel*, bool) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
+   void GenerateIrCondition(IrBuilder&, IrBlock*, IrBlock*) override;
 };
 
 struct NodeAssignOp: public NodeBinary {
    NodeAssignOp(TokenPtr, NodeExpr*, NodeExpr*);
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 struct NodeRecordAccess: public NodeBinary {
    NodeRecordAccess(TokenPtr, NodeExpr*, NodeExpr*, unsigned);
-	Symbol* GetType() override;
-	Symbol* GetSymbol() override;
+	Symbol* ComputeType() override;
+	Symbol* ComputeSymbol() override;
 	bool IsLValue() override;
    void Generate(AsmCode&) override;
    void GenerateLValue(AsmCode&) const override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
+   IrOperand GenerateIrLValue(IrBuilder&) override;
 };
 
 struct NodeArgs: public NodeExpr {
 	Args args;
 	NodeArgs(Args, NodeType, unsigned);
 	void PrintNode(int) override;
+   bool HasSideEffects() override;
+};
+
+//kind is i, r or s for a value and n for the end of the line, text is a constant string
+struct WriteItem {
+   char kind;
+   NodeExpr* arg;
+   string text;
 };
 
+typedef vector<WriteItem> WriteItems;
+
 struct NodeWriteBase: public NodeArgs {
    NodeWriteBase(Args, NodeType, unsigned);
+   vector<WriteItems> GetBatches();
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 struct NodeWrite: public NodeWriteBase {
@@ -155,7 +206,6 @@ struct NodeWrite: public NodeWriteBase {
 struct NodeWriteln: public NodeWriteBase {
    NodeWriteln(Args, unsigned);
    void PrintNode(int) override;
-   void Generate(AsmCode&) override;
 };
 
 class NodeCall: public NodeArgs {
@@ -164,22 +214,29 @@ public:
    NodeCall(NodeExpr*, Args, unsigned);
 	void PrintNode(int) override;
 	bool IsSubroutineCall() override;
-	Symbol* GetType() override;
-   Symbol* GetSymbol() override;
+   bool HasSideEffects() override;
+	Symbol* ComputeType() override;
+   Symbol* ComputeSymbol() override;
    void Generate(AsmCode&) override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
 };
 
 class NodeArrIdx: public NodeArgs {
    void ComputeIndexToEax(AsmCode&) const;
+   IrOperand ComputeIrAddress(IrBuilder&);
 public:
 	NodeExpr* arrName;
-   NodeArrIdx(NodeExpr*, Args, unsigned);
+   bool isRangeChecked;
+   NodeArrIdx(NodeExpr*, Args, unsigned, bool = false);
 	void PrintNode(int) override;
-	Symbol* GetType() override;
-   Symbol* GetSymbol() override;
+	Symbol* ComputeType() override;
+   Symbol* ComputeSymbol() override;
 	bool IsLValue() override;
+   bool HasSideEffects() override;
    void Generate(AsmCode&) override;
    void GenerateLValue(AsmCode&) const override;
+   IrOperand GenerateIrValue(IrBuilder&) override;
+   IrOperand GenerateIrLValue(IrBuilder&) override;
 };
 
 struct NodeStmt: public SyntaxNode {
@@ -192,6 +249,7 @@ struct NodeExitStmt: public NodeStmt {
 	NodeExitStmt(SyntaxNode*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 struct NodeJumpStmt: public NodeStmt {
@@ -203,12 +261,14 @@ struct NodeBreakStmt: public NodeJumpStmt {
 	NodeBreakStmt(NodeStmt*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 struct NodeContinueStmt: public NodeJumpStmt {
 	NodeContinueStmt(NodeStmt*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 class NodeExprStmt: public NodeStmt {
@@ -225,16 +285,46 @@ public:
    NodeIfStmt(NodeExpr*, SyntaxNode*, SyntaxNode*, unsigned);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
+};
+
+struct CaseLabel {
+   int low;
+   int high;
+   size_t branch;
+};
+
+//dense labels are dispatched through a jump table, sparse ones by a binary search over them
+class NodeCaseStmt: public NodeExprStmt {
+   vector<CaseLabel> labels;
+   Statements branches;
+   SyntaxNode* elseStmt;
+   bool IsDense(size_t, size_t) const;
+   void GenerateCases(AsmCode&, size_t, size_t, const vector<AsmLabel*>&, AsmLabel*) const;
+   void GenerateIrCases(IrBuilder&, IrOperand, size_t, size_t, const vector<IrBlock*>&, IrBlock*) const;
+public:
+   NodeCaseStmt(NodeExpr*, unsigned);
+   bool AddLabel(int, int);
+   void AddBranch(SyntaxNode*);
+   void SetElse(SyntaxNode*);
+	void PrintNode(int) override;
+   void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 class NodeLoopStmtBase {
 protected:
    AsmLabel* breakLabel;
    AsmLabel* continueLabel;
+   IrBlock* breakBlock;
+   IrBlock* continueBlock;
    void GenerateLoopLabels(AsmCode&);
+   void GenerateIrLoopBlocks(IrBuilder&);
 public:
    AsmLabel* GetBreakLabel() const;
    AsmLabel* GetContinueLabel() const;
+   IrBlock* GetBreakBlock() const;
+   IrBlock* GetContinueBlock() const;
 };
 
 class NodeWhileStmt: public NodeLoopStmtBase, public NodeExprStmt {
@@ -244,6 +334,7 @@ public:
 	void SetStatement(SyntaxNode*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 class NodeRepeateStmt: public NodeLoopStmtBase, public NodeExprStmt {
@@ -253,6 +344,7 @@ public:
 	void SetLoopInfo(NodeBlock*, NodeExpr*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 };
 
 enum LoopForType {
@@ -271,5 +363,6 @@ public:
 	void SetStatement(SyntaxNode*);
 	void PrintNode(int) override;
    void Generate(AsmCode&) override;
+   void GenerateIr(IrBuilder&) override;
 	bool IsForLoop() override;   
 };
\ No newline at end of file
@@ -56,6 +56,7 @@ namespace Tag {
 		OF,
 		OR,
 		ORD,
+		PACKED,
 		PROCEDURE,
 		PROGRAM,
 		RBRACKET,